@@ -0,0 +1,40 @@
+#version 460
+noperspective in vec4 nearPoint;
+noperspective in vec4 farPoint;
+out vec4 fragColor;
+
+const vec3 gridColor = vec3(0.6);
+const vec3 axesColor = vec3(0.0);
+const float minSpacing = 8.0; // pixels between the lines of the finest visible decade
+
+// coverage of a one pixel wide line at every multiple of spacing
+float lines(vec2 position, vec2 pixel, float spacing) {
+    vec2 distance = abs(fract(position / spacing + 0.5) - 0.5) * spacing / pixel;
+    return 1.0 - min(min(distance.x, distance.y), 1.0);
+}
+
+void main() {
+    vec3 nearWorld = nearPoint.xyz / nearPoint.w;
+    vec3 farWorld  = farPoint.xyz / farPoint.w;
+    float t = -nearWorld.z / (farWorld.z - nearWorld.z);
+    vec2 position = mix(nearWorld, farWorld, t).xy;
+
+    // world size of a pixel decides which decades are drawn: the finest one fades in
+    // as it gets sparser than minSpacing pixels, the coarser ones stay
+    vec2 pixel = max(fwidth(position), vec2(1e-30));
+    if (t < 0.0) { discard; }
+    float level = log(max(pixel.x, pixel.y) * minSpacing) / log(10.0);
+    float spacing = pow(10.0, floor(level));
+    float fade = 1.0 - fract(level);
+
+    float grid = max(lines(position, pixel, spacing) * fade * 0.5,
+                 max(lines(position, pixel, spacing * 10.0) * mix(0.5, 1.0, fade),
+                     lines(position, pixel, spacing * 100.0)));
+
+    vec2 axisDistance = abs(position) / pixel;
+    float axes = 1.0 - min(min(axisDistance.x, axisDistance.y) * 0.75, 1.0);
+
+    float alpha = max(axes, grid);
+    if (alpha <= 0.0) { discard; }
+    fragColor = vec4(mix(gridColor, axesColor, axes / alpha), alpha);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 460
+// one triangle covering the screen, every fragment finds its point of the plane z = 0
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+noperspective out vec4 nearPoint;
+noperspective out vec4 farPoint;
+
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    mat4 inverseCamera = inverse(projection * view);
+    nearPoint = inverseCamera * vec4(corner, -1.0, 1.0);
+    farPoint  = inverseCamera * vec4(corner,  1.0, 1.0);
+    gl_Position = vec4(corner, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 450
+// y = f(x) without vertex buffers: vertex i of the line strip is the i-th of the uniform samples
+// over the visible range, f is generated from the expression and appended to this source
+uniform vec2 range;
+uniform int samples;
+uniform vec4 parameters;
+
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+float f(float x);
+
+void main() {
+    float x = mix(range.x, range.y, float(gl_VertexID) / float(max(samples - 1, 1)));
+    gl_Position = projection * view * vec4(x, f(x), 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 460
+layout (location = 0) in vec2 position;
+layout (location = 1) in float centerX;
+layout (location = 2) in float centerY;
+
+uniform mat3 transform; // applied to the centers only, so the discs keep their size
+
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+void main() {
+    gl_Position = projection * view * vec4(position + (transform * vec3(centerX, centerY, 1.0)).xy, 0.0, 1.0);
+}
\ No newline at end of file
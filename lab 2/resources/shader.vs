@@ -1,8 +1,10 @@
 #version 460
 layout (location = 0) in vec2 position;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
 
 void main() {
     gl_Position = projection * view * vec4(position, 0.0, 1.0);
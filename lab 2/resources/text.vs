@@ -2,8 +2,10 @@
 layout (location = 0) in vec4 vertex;
 out vec2 TexCoords;
 
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
 
 void main() {
     gl_Position = projection * view * vec4(vertex.xy, 0.0, 1.0);
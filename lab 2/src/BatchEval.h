@@ -0,0 +1,69 @@
+#ifndef _BatchEval_h_
+#define _BatchEval_h_
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+
+// non-owning view of a contiguous array
+template <typename T>
+struct Span {
+    T* data{};
+    size_t size{};
+
+    T& operator[](size_t i) const { return data[i]; }
+};
+
+// y[i] = f(x[i]) for n values; plotted functions are stored in this form so that
+// the cost of the type erasure is paid once per block and not once per sample
+using BatchFunction = std::function<void(const float* x, float* y, size_t n)>;
+
+// number of samples evaluated at once, the blocks live on the stack of the worker
+const size_t batchBlock = 256;
+
+// turns a scalar callable into a block evaluator; the loop has no calls through pointers,
+// so the compiler can inline f and vectorize the loop when f allows it
+template <typename F>
+BatchFunction batched(F f) {
+    return [f](const float* x, float* y, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            y[i] = f(x[i]);
+        }
+    };
+}
+
+// fills out[i] = (x, f(x)) with x = x0 + i * dx, split into blocks between the threads of the pool;
+// f is either a scalar callable float(float) or a block evaluator void(const float*, float*, size_t)
+template <typename F>
+void evaluateBatch(const F& f, float x0, float dx, Span<glm::vec2> out, ThreadPool& pool) {
+    pool.parallelFor(out.size, 16 * batchBlock, [&](size_t begin, size_t end) {
+        alignas(32) float x[batchBlock];
+        alignas(32) float y[batchBlock];
+
+        for (size_t first = begin; first < end; first += batchBlock) {
+            size_t n = end - first < batchBlock ? end - first : batchBlock;
+            for (size_t i = 0; i < n; i++) {
+                x[i] = x0 + static_cast<float>(first + i) * dx;
+            }
+
+            if constexpr (std::is_invocable_v<const F&, const float*, float*, size_t>) {
+                f(x, y, n);
+            }
+            else {
+                for (size_t i = 0; i < n; i++) {
+                    y[i] = f(x[i]);
+                }
+            }
+
+            // out may be write-combined gpu memory, so it is written once and in order
+            for (size_t i = 0; i < n; i++) {
+                out[first + i] = glm::vec2(x[i], y[i]);
+            }
+        }
+    });
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "CurveSampler.h"
+
+#include <cmath>
+#include <algorithm>
+
+CurveSampler::CurveSampler(std::function<float(float)> f) : function(std::move(f)) {}
+
+void CurveSampler::setFunction(std::function<float(float)> f) {
+    function = std::move(f);
+    reset();
+}
+
+void CurveSampler::reset() {
+    levels.clear();
+    visible.clear();
+    evaluations = 0;
+}
+
+float CurveSampler::evaluate(float x) {
+    evaluations++;
+    return function(x);
+}
+
+const std::vector<glm::vec2>& CurveSampler::sample(float xMin, float xMax, float pixelSize) {
+    // zoom levels are half an octave apart, the tolerance of a level is never coarser than requested
+    int key = static_cast<int>(std::floor(std::log2(pixelSize) * 2.0f));
+    float levelPixel = std::exp2(key / 2.0f);
+    float maxError = tolerance * levelPixel;
+
+    Level& level = levels[key];
+    level.lastUse = ++useCounter;
+    level.step = gridPixels * levelPixel;
+
+    long long first = static_cast<long long>(std::floor(xMin / level.step));
+    long long last  = static_cast<long long>(std::ceil(xMax / level.step));
+
+    if (level.points.empty() || last < level.first || first > level.last) {
+        // nothing useful is cached for this part of the axis
+        level.points.clear();
+        appendSample(glm::vec2(first * level.step, evaluate(first * level.step)), level.points);
+        sampleRange(first, last, level.step, maxError, level.points);
+        level.first = first;
+        level.last = last;
+    }
+    else {
+        // panning: only the newly visible parts are sampled
+        if (first < level.first) {
+            scratch.clear();
+            appendSample(glm::vec2(first * level.step, evaluate(first * level.step)), scratch);
+            sampleRange(first, level.first, level.step, maxError, scratch);
+            if (!scratch.empty() && scratch.back().x == level.first * level.step) {
+                scratch.pop_back(); // the same sample is already the first one of the level
+            }
+            level.points.insert(level.points.begin(), scratch.begin(), scratch.end());
+            level.first = first;
+        }
+        if (last > level.last) {
+            sampleRange(level.last, last, level.step, maxError, level.points);
+            level.last = last;
+        }
+
+        // keep at most a couple of screens around the visible range
+        long long width = last - first;
+        long long keepFirst = first - 2 * width;
+        long long keepLast  = last + 2 * width;
+        if (keepLast < level.last) {
+            auto it = std::lower_bound(level.points.begin(), level.points.end(), keepLast * level.step,
+                [](const glm::vec2& point, float x) { return point.x < x; });
+            if (it != level.points.end()) {
+                ++it;
+            }
+            level.points.erase(it, level.points.end());
+            level.last = keepLast;
+        }
+        if (keepFirst > level.first) {
+            auto it = std::lower_bound(level.points.begin(), level.points.end(), keepFirst * level.step,
+                [](const glm::vec2& point, float x) { return point.x < x; });
+            level.points.erase(level.points.begin(), it);
+            level.first = keepFirst;
+        }
+    }
+
+    auto begin = std::lower_bound(level.points.begin(), level.points.end(), first * level.step,
+        [](const glm::vec2& point, float x) { return point.x < x; });
+    auto end = std::upper_bound(begin, level.points.end(), last * level.step,
+        [](float x, const glm::vec2& point) { return x < point.x; });
+    visible.assign(begin, end);
+
+    evictLevels();
+    return visible;
+}
+
+void CurveSampler::appendSample(const glm::vec2& point, std::vector<glm::vec2>& out) {
+    // a line strip cannot jump over a pole, such samples are simply left out
+    if (std::isfinite(point.y)) {
+        out.push_back(point);
+    }
+}
+
+void CurveSampler::sampleRange(long long first, long long last, float step, float maxError, std::vector<glm::vec2>& out) {
+    glm::vec2 left(first * step, evaluate(first * step));
+    for (long long i = first + 1; i <= last; i++) {
+        glm::vec2 right(i * step, evaluate(i * step));
+        refine(left, right, maxError, 0, out);
+        left = right;
+    }
+}
+
+void CurveSampler::refine(const glm::vec2& left, const glm::vec2& right, float maxError, int depth, std::vector<glm::vec2>& out) {
+    float x = 0.5f * (left.x + right.x);
+    glm::vec2 middle(x, evaluate(x));
+
+    // deviation of the midpoint from the chord ~ curvature * length^2
+    float error = std::abs(middle.y - 0.5f * (left.y + right.y));
+    bool finite = std::isfinite(error);
+
+    if (depth < maxDepth && (!finite || error > maxError)) {
+        refine(left, middle, maxError, depth + 1, out);
+        refine(middle, right, maxError, depth + 1, out);
+    }
+    else {
+        appendSample(right, out);
+    }
+}
+
+void CurveSampler::evictLevels() {
+    while (levels.size() > maxLevels) {
+        auto oldest = levels.begin();
+        for (auto it = levels.begin(); it != levels.end(); ++it) {
+            if (it->second.lastUse < oldest->second.lastUse) {
+                oldest = it;
+            }
+        }
+        levels.erase(oldest);
+    }
+}
\ No newline at end of file
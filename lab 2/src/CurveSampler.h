@@ -0,0 +1,54 @@
+#ifndef _CurveSampler_h_
+#define _CurveSampler_h_
+
+#include <map>
+#include <vector>
+#include <functional>
+#include <glm/glm.hpp>
+
+// adaptive sampling of y = f(x): intervals are split while the midpoint deviates from the chord
+// by more than a fraction of a pixel, so flat parts get few vertices and curvy parts get many.
+// Samples are cached per zoom level and extended only by the newly visible part when panning.
+class CurveSampler {
+public:
+    float tolerance = 0.25f;  // allowed deviation from the real curve, pixels
+    int gridPixels  = 8;      // distance between initial samples, pixels
+    int maxDepth    = 10;     // max number of splits of one initial interval
+
+    size_t evaluations{};     // calls of f since the last reset (statistics)
+
+    explicit CurveSampler(std::function<float(float)> f);
+
+    void setFunction(std::function<float(float)> f);
+    // drops all cached samples
+    void reset();
+
+    // samples covering at least [xMin, xMax] for a screen where one pixel is pixelSize world units;
+    // the returned reference is valid until the next call
+    const std::vector<glm::vec2>& sample(float xMin, float xMax, float pixelSize);
+
+private:
+    struct Level {
+        float step{};                   // distance between initial samples
+        long long first{}, last{};      // sampled range is [first * step, last * step]
+        std::vector<glm::vec2> points;  // sorted by x
+        unsigned int lastUse{};
+    };
+
+    static const size_t maxLevels = 16;
+
+    std::function<float(float)> function;
+    std::map<int, Level> levels;
+    std::vector<glm::vec2> visible;
+    std::vector<glm::vec2> scratch;
+    unsigned int useCounter{};
+
+    float evaluate(float x);
+    void appendSample(const glm::vec2& point, std::vector<glm::vec2>& out);
+    // appends samples of (first * step, last * step]
+    void sampleRange(long long first, long long last, float step, float maxError, std::vector<glm::vec2>& out);
+    void refine(const glm::vec2& left, const glm::vec2& right, float maxError, int depth, std::vector<glm::vec2>& out);
+    void evictLevels();
+};
+
+#endif
\ No newline at end of file
@@ -3,138 +3,136 @@
 
 #include <iostream>
 #include <vector>
-#include <map>
+#include <algorithm>
+#include <chrono>
 #include <functional>
 
 #include <glad/glad.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
+#include "CurveSampler.h"
+#include "Expression.h"
+#include "GLObjects.h"
+#include "GLState.h"
+#include "GeometryBatch.h"
+
 #define M_PI 3.14159265f
 
 // text
-GLuint textVAO, textVBO;
+VertexArray textVAO;
+Buffer textVBO;
+Texture textAtlas;
 struct Character {
-    unsigned int textureID;
+    glm::ivec2   offset;  // position of the glyph in the atlas (pixels)
+    glm::vec2    uvMin;
+    glm::vec2    uvMax;
     glm::ivec2   size;
     glm::ivec2   bearing;
     unsigned int advance;
 };
-std::map<GLchar, Character> characters;
+Character characters[128];
+
+std::vector<GLfloat> textBatch; // quads of all strings of the frame (x, y, u, v)
+
+struct TextStats {
+    int drawCalls;
+    int glyphs;
+    float cpuTime; // microseconds spent on building and submitting the batch
+};
+TextStats textStats{};
 
+// compiled reference for the expression typed in the interface
 float f(float x) {
     return cos(x);
 }
 
-void bind(GLuint& VBO, GLuint& VAO, GLsizeiptr size, const void* data) {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-}
-
-std::vector<GLfloat> graphVertex(std::function<float(float)> f) {
-    std::vector<GLfloat> vertex;
-    for (float x = -10.0f; x < 10.01f; x += 0.01f) {
-        vertex.push_back(x);
-        vertex.push_back(f(x));
-    }
-    return vertex;
-}
+// function of the graph, compiled at runtime
+Expression expression;
 
-std::vector<GLfloat> gridVertex() {
-    std::vector<GLfloat> vertex;
-    for (float x = -10.0f; x < 11.0f; x++) {
-        vertex.push_back(x);
-        vertex.push_back(-10.0f);
-        vertex.push_back(x);
-        vertex.push_back(10.0f);
-    }
-    for (float y = -10.0f; y < 11.0f; y++) {
-        vertex.push_back(-10.0f);
-        vertex.push_back(y);
-        vertex.push_back(10.0f);
-        vertex.push_back(y);
-    }
-    return vertex;
-}
+// arrows at the ends of the axes
+const GLfloat arrowOxVertex[] = {
+     9.8f, -0.05f,
+    10.0f,  0.0f,
+     9.8f,  0.05f
+};
 
-std::vector<GLfloat> axesVertex() {
-    return {
-        -10.0f,   0.0f,
-         10.0f,   0.0f,
-          0.0f, -10.0f,
-          0.0f,  10.0f
-    };
-}
+const GLfloat arrowOyVertex[] = {
+    -0.05f,  9.8f,
+     0.05f,  9.8f,
+     0.0f,  10.0f
+};
 
-std::vector<GLfloat> arrowOxVertex() {
-    return {
-         9.8f, -0.05f,
-        10.0f,  0.0f,
-         9.8f,  0.05f
-    };
-}
+// graph of f, resampled only when the visible part of the plane changes
+struct Graph {
+    Buffer VBO;
+    VertexArray VAO;
+    GLsizei count{};
+    glm::vec3 area{}; // xMin, xMax and pixel size of the uploaded samples
+};
+Graph graph;
+CurveSampler graphSampler([](float x) { return expression.evaluate(x); });
 
-std::vector<GLfloat> arrowOyVertex() {
-    return {
-        -0.05f,  9.8f,
-         0.05f,  9.8f,
-         0.0f,  10.0f
-    };
-}
+// procedural grid and axes, the triangle covering the screen has no vertex data
+VertexArray gridVAO;
 
-struct OpenGLObject {
-    GLuint VBO{};
-    GLuint VAO{};
-    std::function<std::vector<GLfloat>()> array;
-    GLenum mode;
-    GLsizei count;
+// static helper geometry (arrows), one draw call per primitive type
+GeometryBatch helpers;
 
-    OpenGLObject(std::function<std::vector<GLfloat>()> _array, GLenum _mode, GLsizei _count) : array(_array), mode(_mode), count(_count) {}
-};
+void initGraph() {
+    graph.VAO.create();
+    GLsizei stride = graph.VAO.floatAttributes(0, { 2 });
+    graph.VBO.allocate(stride * 1024, nullptr, GL_DYNAMIC_DRAW);
+    graph.VAO.vertexBuffer(0, graph.VBO, 0, stride);
+}
 
-OpenGLObject graph([&]() { return graphVertex(f); }, GL_LINE_STRIP, 2001);
+void updateGraph(float xMin, float xMax, float pixelSize) {
+    glm::vec3 area(xMin, xMax, pixelSize);
+    if (area == graph.area) { return; }
+    graph.area = area;
 
-OpenGLObject grid(gridVertex, GL_LINES, 84);
-OpenGLObject axes(axesVertex, GL_LINES, 4);
-OpenGLObject arrowOx(arrowOxVertex, GL_TRIANGLES, 3);
-OpenGLObject arrowOy(arrowOyVertex, GL_TRIANGLES, 3);
+    const std::vector<glm::vec2>& samples = graphSampler.sample(xMin, xMax, pixelSize);
+    graph.count = static_cast<GLsizei>(samples.size());
 
-void drawVertex(OpenGLObject& object) {
-    std::vector<GLfloat> vertex = object.array();
-    bind(object.VBO, object.VAO, sizeof(GLfloat) * vertex.size(), vertex.data());
+    GLsizeiptr size = sizeof(glm::vec2) * samples.size();
+    if (size > graph.VBO.size()) {
+        graph.VBO.allocate(size * 2, nullptr, GL_DYNAMIC_DRAW);
+    }
+    graph.VBO.update(0, size, samples.data());
 }
 
-void updateVertex(OpenGLObject& object) {
-    glBindVertexArray(object.VAO);
+void drawGraph() {
+    graph.VAO.bind();
+    glState.drawArrays(GL_LINE_STRIP, 0, graph.count);
+}
 
-    std::vector<GLfloat> vertex = object.array();
+void drawCartesian() {
+    gridVAO.create();
 
-    glBindBuffer(GL_ARRAY_BUFFER, object.VBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * vertex.size(), vertex.data());
-    glBindVertexArray(0);
+    helpers.init({ 2 });
+    helpers.add(arrowOxVertex, 3, GL_TRIANGLES);
+    helpers.add(arrowOyVertex, 3, GL_TRIANGLES);
+    helpers.build();
 }
 
-void drawArray(OpenGLObject& object) {
-    glBindVertexArray(object.VAO);
-    glDrawArrays(object.mode, 0, object.count);
-    glBindVertexArray(0);
+void drawHelpers() {
+    helpers.draw();
 }
 
-void drawCartesian() {
-    drawVertex(grid);
-    drawVertex(axes);
-    drawVertex(arrowOx);
-    drawVertex(arrowOy);
+// releases everything created by drawCartesian, initGraph and initFreeType
+void releaseDrawing() {
+    helpers.release();
+    gridVAO.release();
+    graph.VAO.release();
+    graph.VBO.release();
+    textVAO.release();
+    textVBO.release();
+    textAtlas.release();
 }
 
-void updateCartesian() {
-    updateVertex(grid);
-    updateVertex(axes);
+void drawGrid() {
+    gridVAO.bind();
+    glState.drawArrays(GL_TRIANGLES, 0, 3);
 }
 
 int initFreeType() {
@@ -151,144 +149,174 @@ int initFreeType() {
 
     FT_Set_Pixel_Sizes(face, 0, 48);
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // all glyphs are packed row by row into one texture
+    const int atlasWidth = 1024;
+    const int padding = 1;
+    std::vector<std::vector<unsigned char>> bitmaps(128);
+    glm::ivec2 pen(padding, padding);
+    int rowHeight = 0;
+
     for (unsigned char c = 0; c < 128; c++) {
         if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
             std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
             continue;
         }
 
-        GLuint texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            static_cast<unsigned int>(face->glyph->advance.x)
-        };
-        characters.insert(std::pair<char, Character>(c, character));
+        FT_Bitmap& bitmap = face->glyph->bitmap;
+        if (pen.x + static_cast<int>(bitmap.width) + padding > atlasWidth) {
+            pen.x = padding;
+            pen.y += rowHeight + padding;
+            rowHeight = 0;
+        }
+
+        Character& character = characters[c];
+        character.offset  = pen;
+        character.size    = glm::ivec2(bitmap.width, bitmap.rows);
+        character.bearing = glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
+        character.advance = static_cast<unsigned int>(face->glyph->advance.x);
+
+        bitmaps[c].resize(static_cast<size_t>(bitmap.width) * bitmap.rows);
+        for (unsigned int row = 0; row < bitmap.rows; row++) {
+            std::copy(bitmap.buffer + row * bitmap.pitch, bitmap.buffer + row * bitmap.pitch + bitmap.width, bitmaps[c].begin() + row * bitmap.width);
+        }
+
+        pen.x += bitmap.width + padding;
+        rowHeight = std::max(rowHeight, static_cast<int>(bitmap.rows));
+    }
+    int atlasHeight = pen.y + rowHeight + padding;
+
+    std::vector<unsigned char> atlas(static_cast<size_t>(atlasWidth) * atlasHeight, 0);
+    for (unsigned char c = 0; c < 128; c++) {
+        Character& character = characters[c];
+        for (int row = 0; row < character.size.y; row++) {
+            std::copy_n(bitmaps[c].begin() + row * character.size.x, character.size.x, atlas.begin() + (character.offset.y + row) * atlasWidth + character.offset.x);
+        }
+        character.uvMin = glm::vec2(character.offset) / glm::vec2(atlasWidth, atlasHeight);
+        character.uvMax = glm::vec2(character.offset + character.size) / glm::vec2(atlasWidth, atlasHeight);
     }
 
-    glGenVertexArrays(1, &textVAO);
-    glGenBuffers(1, &textVBO);
-    glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, nullptr, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    textAtlas.storage2D(1, GL_R8, atlasWidth, atlasHeight);
+    textAtlas.subImage2D(0, 0, 0, atlasWidth, atlasHeight, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    textAtlas.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    textAtlas.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    textAtlas.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    textAtlas.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // the buffer gets its storage with the first batch, it grows under the same name
+    textVAO.create();
+    GLsizei stride = textVAO.floatAttributes(0, { 4 });
+    textVBO.allocate(stride * 6 * 64, nullptr, GL_DYNAMIC_DRAW);
+    textVAO.vertexBuffer(0, textVBO, 0, stride);
 
     FT_Done_Face(face);
     FT_Done_FreeType(ft);
-}
 
-void renderText(ShaderProgram& shader, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::mat4 projection, glm::mat4 view) {
-    shader.use();
-    shader.setVec3("textColor", 0.0f, 0.0f, 0.0f);
-    shader.setMat4("projection", projection);
-    shader.setMat4("view", view);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
+    return 0;
+}
 
+// appends the quads of the string to the text batch, nothing is drawn until flushText
+void renderText(const std::string& text, GLfloat x, GLfloat y, GLfloat scale) {
     for (const char& c : text) {
-        Character ch = characters[c];
+        const Character& ch = characters[c & 0x7F];
 
-        glm::vec4 pos = glm::vec4(x + ch.bearing.x * scale, y - (ch.size.y - ch.bearing.y) * scale, 0.0, 1.0);
-
-        GLfloat xpos = pos.x;
-        GLfloat ypos = pos.y;
+        GLfloat xpos = x + ch.bearing.x * scale;
+        GLfloat ypos = y - (ch.size.y - ch.bearing.y) * scale;
         GLfloat w = ch.size.x * scale;
         GLfloat h = ch.size.y * scale;
 
-        float vertices[6][4] = {
-            { xpos,     ypos + h, 0.0f, 0.0f },
-            { xpos,     ypos,     0.0f, 1.0f },
-            { xpos + w, ypos,     1.0f, 1.0f },
+        const GLfloat vertices[6][4] = {
+            { xpos,     ypos + h, ch.uvMin.x, ch.uvMin.y },
+            { xpos,     ypos,     ch.uvMin.x, ch.uvMax.y },
+            { xpos + w, ypos,     ch.uvMax.x, ch.uvMax.y },
 
-            { xpos,     ypos + h, 0.0f, 0.0f },
-            { xpos + w, ypos,     1.0f, 1.0f },
-            { xpos + w, ypos + h, 1.0f, 0.0f }
+            { xpos,     ypos + h, ch.uvMin.x, ch.uvMin.y },
+            { xpos + w, ypos,     ch.uvMax.x, ch.uvMax.y },
+            { xpos + w, ypos + h, ch.uvMax.x, ch.uvMin.y }
         };
+        textBatch.insert(textBatch.end(), &vertices[0][0], &vertices[0][0] + 6 * 4);
 
-        glBindTexture(GL_TEXTURE_2D, ch.textureID);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+        x += (ch.advance >> 6) * scale;
+    }
+}
 
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+// draws everything collected by renderText with one draw call
+void flushText(ShaderProgram& shader) {
+    GLsizei count = static_cast<GLsizei>(textBatch.size() / 4);
+    textStats.glyphs = count / 6;
+    textStats.drawCalls = 0;
+    if (count == 0) { return; }
 
-        x += (ch.advance >> 6) * scale;
+    GLsizeiptr size = sizeof(GLfloat) * textBatch.size();
+    if (size > textVBO.size()) {
+        textVBO.allocate(size, nullptr, GL_DYNAMIC_DRAW);
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    textVBO.update(0, size, textBatch.data());
+
+    // textColor is set once after linking, projection and view come from the camera uniform block
+    shader.use();
+    textAtlas.bind(0);
+    textVAO.bind();
+    glState.drawArrays(GL_TRIANGLES, 0, count);
+
+    textStats.drawCalls++;
+    textBatch.clear();
 }
 
-void renderAllText(ShaderProgram& shader, glm::mat4 projection, glm::mat4 view) {
+void renderAllText(ShaderProgram& shader) {
+    auto start = std::chrono::steady_clock::now();
+
     // Ox
-    renderText(shader, "-10", -9.95f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-9", -9.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-8", -8.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-7", -7.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-6", -6.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-5", -5.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-4", -4.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-3", -3.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-2", -2.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "-1", -1.25f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "0", -0.15f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "1",  0.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "2",  1.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "3",  2.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "4",  3.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "5",  4.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "6",  5.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "7",  6.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "8",  7.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,   "9",  8.85f, -0.2f,  0.005f, projection, view);
-    renderText(shader,  "10",  9.7f,  -0.25f, 0.005f, projection, view);
+    renderText("-10", -9.95f, -0.2f,  0.005f);
+    renderText( "-9", -9.25f, -0.2f,  0.005f);
+    renderText( "-8", -8.25f, -0.2f,  0.005f);
+    renderText( "-7", -7.25f, -0.2f,  0.005f);
+    renderText( "-6", -6.25f, -0.2f,  0.005f);
+    renderText( "-5", -5.25f, -0.2f,  0.005f);
+    renderText( "-4", -4.25f, -0.2f,  0.005f);
+    renderText( "-3", -3.25f, -0.2f,  0.005f);
+    renderText( "-2", -2.25f, -0.2f,  0.005f);
+    renderText( "-1", -1.25f, -0.2f,  0.005f);
+    renderText(  "0", -0.15f, -0.2f,  0.005f);
+    renderText(  "1",  0.85f, -0.2f,  0.005f);
+    renderText(  "2",  1.85f, -0.2f,  0.005f);
+    renderText(  "3",  2.85f, -0.2f,  0.005f);
+    renderText(  "4",  3.85f, -0.2f,  0.005f);
+    renderText(  "5",  4.85f, -0.2f,  0.005f);
+    renderText(  "6",  5.85f, -0.2f,  0.005f);
+    renderText(  "7",  6.85f, -0.2f,  0.005f);
+    renderText(  "8",  7.85f, -0.2f,  0.005f);
+    renderText(  "9",  8.85f, -0.2f,  0.005f);
+    renderText( "10",  9.7f,  -0.25f, 0.005f);
 
     // Oy
-    renderText(shader, "-10", -0.4f,  -9.95f, 0.005f, projection, view);
-    renderText(shader,  "-9", -0.25f, -9.2f,  0.005f, projection, view);
-    renderText(shader,  "-8", -0.25f, -8.2f,  0.005f, projection, view);
-    renderText(shader,  "-7", -0.25f, -7.2f,  0.005f, projection, view);
-    renderText(shader,  "-6", -0.25f, -6.2f,  0.005f, projection, view);
-    renderText(shader,  "-5", -0.25f, -5.2f,  0.005f, projection, view);
-    renderText(shader,  "-4", -0.25f, -4.2f,  0.005f, projection, view);
-    renderText(shader,  "-3", -0.25f, -3.2f,  0.005f, projection, view);
-    renderText(shader,  "-2", -0.25f, -2.2f,  0.005f, projection, view);
-    renderText(shader,  "-1", -0.25f, -1.2f,  0.005f, projection, view);
-    renderText(shader,   "1", -0.15f,  0.8f,  0.005f, projection, view);
-    renderText(shader,   "2", -0.15f,  1.8f,  0.005f, projection, view);
-    renderText(shader,   "3", -0.15f,  2.8f,  0.005f, projection, view);
-    renderText(shader,   "4", -0.15f,  3.8f,  0.005f, projection, view);
-    renderText(shader,   "5", -0.15f,  4.8f,  0.005f, projection, view);
-    renderText(shader,   "6", -0.15f,  5.8f,  0.005f, projection, view);
-    renderText(shader,   "7", -0.15f,  6.8f,  0.005f, projection, view);
-    renderText(shader,   "8", -0.15f,  7.8f,  0.005f, projection, view);
-    renderText(shader,   "9", -0.15f,  8.8f,  0.005f, projection, view);
-    renderText(shader,  "10", -0.35f,  9.8f,  0.005f, projection, view);
-
-    renderText(shader, "x", 9.8f, 0.1f, 0.006f, projection, view);
-    renderText(shader, "y", 0.07f, 9.82f, 0.006f, projection, view);
+    renderText("-10", -0.4f,  -9.95f, 0.005f);
+    renderText( "-9", -0.25f, -9.2f,  0.005f);
+    renderText( "-8", -0.25f, -8.2f,  0.005f);
+    renderText( "-7", -0.25f, -7.2f,  0.005f);
+    renderText( "-6", -0.25f, -6.2f,  0.005f);
+    renderText( "-5", -0.25f, -5.2f,  0.005f);
+    renderText( "-4", -0.25f, -4.2f,  0.005f);
+    renderText( "-3", -0.25f, -3.2f,  0.005f);
+    renderText( "-2", -0.25f, -2.2f,  0.005f);
+    renderText( "-1", -0.25f, -1.2f,  0.005f);
+    renderText(  "1", -0.15f,  0.8f,  0.005f);
+    renderText(  "2", -0.15f,  1.8f,  0.005f);
+    renderText(  "3", -0.15f,  2.8f,  0.005f);
+    renderText(  "4", -0.15f,  3.8f,  0.005f);
+    renderText(  "5", -0.15f,  4.8f,  0.005f);
+    renderText(  "6", -0.15f,  5.8f,  0.005f);
+    renderText(  "7", -0.15f,  6.8f,  0.005f);
+    renderText(  "8", -0.15f,  7.8f,  0.005f);
+    renderText(  "9", -0.15f,  8.8f,  0.005f);
+    renderText( "10", -0.35f,  9.8f,  0.005f);
+
+    renderText("x", 9.8f, 0.1f, 0.006f);
+    renderText("y", 0.07f, 9.82f, 0.006f);
+
+    flushText(shader);
+
+    textStats.cpuTime = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
 }
 
 #endif
\ No newline at end of file
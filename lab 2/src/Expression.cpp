@@ -0,0 +1,577 @@
+#include "Expression.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// branch-free float approximations (cephes) so that the loops over blocks are vectorized;
+// the error is a few ulp for |x| < 10^4 which is far below a pixel
+const float roundMagic = 12582912.0f; // 1.5 * 2^23: (v + magic) - magic rounds v to an integer
+
+inline float sinPolynomial(float r) {
+    float z = r * r;
+    return r + r * z * (-1.6666654611e-1f + z * (8.3321608736e-3f + z * -1.9515295891e-4f));
+}
+
+inline float cosPolynomial(float r) {
+    float z = r * r;
+    return 1.0f - 0.5f * z + z * z * (4.166664568298827e-2f + z * (-1.388731625493765e-3f + z * 2.443315711809948e-5f));
+}
+
+// sin(x + quarter * pi / 2)
+inline float sinQuadrant(float x, int quarter) {
+    float j = (x * 0.63661977236758134f + roundMagic) - roundMagic;
+    float r = ((x - j * 1.5703125f) - j * 4.837512969970703125e-4f) - j * 7.54978995489188216e-8f;
+    int q = static_cast<int>(j) + quarter;
+    float s = sinPolynomial(r);
+    float c = cosPolynomial(r);
+    float v = (q & 1) ? c : s;
+    return (q & 2) ? -v : v;
+}
+
+inline float fastSin(float x) {
+    return sinQuadrant(x, 0);
+}
+
+inline float fastCos(float x) {
+    return sinQuadrant(x, 1);
+}
+
+inline float fastExp(float x) {
+    float clamped = x < -87.3f ? -87.3f : (x > 88.7f ? 88.7f : x);
+    float n = (clamped * 1.44269504088896341f + roundMagic) - roundMagic;
+    float r = (clamped - n * 0.693359375f) + n * 2.12194440e-4f;
+    float p = ((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r + 4.1665795894e-2f) * r + 1.6666665459e-1f) * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+
+    int32_t bits = (static_cast<int32_t>(n) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+
+    float result = p * scale;
+    result = x > 88.72f ? std::numeric_limits<float>::infinity() : result;
+    result = x < -87.33f ? 0.0f : result;
+    return x != x ? x : result;
+}
+
+float powInt(float x, int exponent) {
+    float result = 1.0f;
+    float base = exponent < 0 ? 1.0f / x : x;
+    for (int e = exponent < 0 ? -exponent : exponent; e > 0; e >>= 1) {
+        if (e & 1) {
+            result *= base;
+        }
+        base *= base;
+    }
+    return result;
+}
+
+template <typename F>
+void unary(float* out, const float* a, size_t n, F f) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = f(a[i]);
+    }
+}
+
+template <typename F>
+void binary(float* out, const float* a, float scalarA, const float* b, float scalarB, size_t n, F f) {
+    if (a && b) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = f(a[i], b[i]);
+        }
+    }
+    else if (b) {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = f(scalarA, b[i]);
+        }
+    }
+    else {
+        for (size_t i = 0; i < n; i++) {
+            out[i] = f(a[i], scalarB);
+        }
+    }
+}
+
+}
+
+Expression::Expression() {
+    std::string error;
+    compile("cos(x)", error);
+}
+
+bool Expression::compile(const std::string& source, std::string& error) {
+    Expression previous = *this;
+
+    text = source;
+    nodes.clear();
+    program.clear();
+    scalars.clear();
+    uniform.clear();
+    parseError.clear();
+    cursor = text.c_str();
+
+    root = parseExpr();
+    skipSpaces();
+    if (parseError.empty() && *cursor != '\0') {
+        parseError = std::string("unexpected '") + *cursor + "' at " + std::to_string(cursor - text.c_str() + 1);
+    }
+
+    std::vector<bool> used(maxRegisters, false);
+    used[0] = true; // x
+    if (parseError.empty() && !generate(root, result, used)) {
+        parseError = "expression is too complex";
+    }
+
+    if (!parseError.empty()) {
+        error = parseError;
+        float kept[parameterCount];
+        std::memcpy(kept, parameters, sizeof(parameters));
+        *this = previous;
+        std::memcpy(parameters, kept, sizeof(parameters));
+        return false;
+    }
+
+    registerCount = 0;
+    for (int i = 0; i < maxRegisters; i++) {
+        if (used[i]) {
+            registerCount = i + 1;
+        }
+    }
+    for (const Instruction& instruction : program) {
+        if (instruction.target + 1 > registerCount) {
+            registerCount = instruction.target + 1;
+        }
+    }
+
+    updateParameters();
+    error.clear();
+    return true;
+}
+
+void Expression::updateParameters() {
+    for (const auto& [slot, node] : uniform) {
+        scalars[slot] = evaluateNode(node, 0.0f);
+    }
+}
+
+// parser
+
+void Expression::skipSpaces() {
+    while (*cursor && std::isspace(static_cast<unsigned char>(*cursor))) {
+        cursor++;
+    }
+}
+
+bool Expression::startsPrimary() const {
+    unsigned char c = static_cast<unsigned char>(*cursor);
+    return std::isalpha(c) || std::isdigit(c) || c == '.' || c == '(';
+}
+
+int Expression::addNode(Op op, int left, int right, float value, int index) {
+    bool varying = op == Op::Variable || (left >= 0 && nodes[left].varying) || (right >= 0 && nodes[right].varying);
+    nodes.push_back(Node{ op, value, index, left, right, varying });
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+int Expression::parseExpr() {
+    int left = parseTerm();
+    while (parseError.empty()) {
+        skipSpaces();
+        if (*cursor == '+' || *cursor == '-') {
+            Op op = *cursor == '+' ? Op::Add : Op::Sub;
+            cursor++;
+            int right = parseTerm();
+            left = addNode(op, left, right);
+        }
+        else {
+            break;
+        }
+    }
+    return left;
+}
+
+int Expression::parseTerm() {
+    int left = parseUnary();
+    while (parseError.empty()) {
+        skipSpaces();
+        if (*cursor == '*' || *cursor == '/') {
+            Op op = *cursor == '*' ? Op::Mul : Op::Div;
+            cursor++;
+            int right = parseUnary();
+            left = addNode(op, left, right);
+        }
+        else if (startsPrimary()) {
+            int right = parsePower();
+            left = addNode(Op::Mul, left, right);
+        }
+        else {
+            break;
+        }
+    }
+    return left;
+}
+
+int Expression::parseUnary() {
+    skipSpaces();
+    if (*cursor == '-') {
+        cursor++;
+        int operand = parseUnary();
+        return addNode(Op::Neg, operand);
+    }
+    if (*cursor == '+') {
+        cursor++;
+        return parseUnary();
+    }
+    return parsePower();
+}
+
+int Expression::parsePower() {
+    int base = parsePrimary();
+    skipSpaces();
+    if (parseError.empty() && *cursor == '^') {
+        cursor++;
+        int exponent = parseUnary();
+        return addNode(Op::Pow, base, exponent);
+    }
+    return base;
+}
+
+int Expression::parsePrimary() {
+    skipSpaces();
+    if (!parseError.empty()) { return -1; }
+
+    const char* start = cursor;
+    unsigned char c = static_cast<unsigned char>(*cursor);
+
+    if (std::isdigit(c) || c == '.') {
+        char* end = nullptr;
+        float value = std::strtof(cursor, &end);
+        if (end == cursor) {
+            parseError = "bad number at " + std::to_string(cursor - text.c_str() + 1);
+            return -1;
+        }
+        cursor = end;
+        return addNode(Op::Number, -1, -1, value);
+    }
+
+    if (c == '(') {
+        cursor++;
+        int inner = parseExpr();
+        // after an error the cursor may be on the terminating zero, it must not move past it
+        if (!parseError.empty()) { return -1; }
+        skipSpaces();
+        if (*cursor != ')') {
+            parseError = "missing ')' at " + std::to_string(cursor - text.c_str() + 1);
+            return -1;
+        }
+        cursor++;
+        return inner;
+    }
+
+    if (std::isalpha(c)) {
+        while (std::isalpha(static_cast<unsigned char>(*cursor))) {
+            cursor++;
+        }
+        std::string name(start, cursor);
+
+        if (name == "x") { return addNode(Op::Variable); }
+        if (name == "pi") { return addNode(Op::Number, -1, -1, 3.14159265358979f); }
+        if (name == "e") { return addNode(Op::Number, -1, -1, 2.71828182845905f); }
+        if (name.size() == 1 && name[0] >= 'a' && name[0] < 'a' + parameterCount) {
+            return addNode(Op::Parameter, -1, -1, 0.0f, name[0] - 'a');
+        }
+
+        struct Function { const char* name; Op op; int arguments; };
+        static const Function functions[] = {
+            { "sin", Op::Sin, 1 }, { "cos", Op::Cos, 1 }, { "tan", Op::Tan, 1 },
+            { "exp", Op::Exp, 1 }, { "log", Op::Log, 1 }, { "sqrt", Op::Sqrt, 1 },
+            { "abs", Op::Abs, 1 }, { "pow", Op::Pow, 2 }, { "min", Op::Min, 2 }, { "max", Op::Max, 2 }
+        };
+        for (const Function& function : functions) {
+            if (name != function.name) { continue; }
+
+            skipSpaces();
+            if (*cursor != '(') {
+                parseError = "'(' expected after " + name;
+                return -1;
+            }
+            cursor++;
+            int first = parseExpr();
+            if (!parseError.empty()) { return -1; }
+            int second = -1;
+            if (function.arguments == 2) {
+                skipSpaces();
+                if (*cursor != ',') {
+                    parseError = name + " takes two arguments";
+                    return -1;
+                }
+                cursor++;
+                second = parseExpr();
+                if (!parseError.empty()) { return -1; }
+            }
+            skipSpaces();
+            if (*cursor != ')') {
+                parseError = "missing ')' after the arguments of " + name;
+                return -1;
+            }
+            cursor++;
+            return addNode(function.op, first, second);
+        }
+
+        parseError = "unknown name '" + name + "'";
+        return -1;
+    }
+
+    if (c == '\0') {
+        parseError = "unexpected end of expression";
+    }
+    else {
+        parseError = std::string("unexpected '") + *cursor + "' at " + std::to_string(cursor - text.c_str() + 1);
+    }
+    return -1;
+}
+
+// evaluation
+
+float Expression::evaluateNode(int index, float x) const {
+    const Node& node = nodes[index];
+    switch (node.op) {
+        case Op::Number:    return node.value;
+        case Op::Variable:  return x;
+        case Op::Parameter: return parameters[node.index];
+        case Op::Neg:  return -evaluateNode(node.left, x);
+        case Op::Sin:  return std::sin(evaluateNode(node.left, x));
+        case Op::Cos:  return std::cos(evaluateNode(node.left, x));
+        case Op::Tan:  return std::tan(evaluateNode(node.left, x));
+        case Op::Exp:  return std::exp(evaluateNode(node.left, x));
+        case Op::Log:  return std::log(evaluateNode(node.left, x));
+        case Op::Sqrt: return std::sqrt(evaluateNode(node.left, x));
+        case Op::Abs:  return std::abs(evaluateNode(node.left, x));
+        case Op::Add:  return evaluateNode(node.left, x) + evaluateNode(node.right, x);
+        case Op::Sub:  return evaluateNode(node.left, x) - evaluateNode(node.right, x);
+        case Op::Mul:  return evaluateNode(node.left, x) * evaluateNode(node.right, x);
+        case Op::Div:  return evaluateNode(node.left, x) / evaluateNode(node.right, x);
+        case Op::Pow:  return std::pow(evaluateNode(node.left, x), evaluateNode(node.right, x));
+        case Op::Min:  return std::fmin(evaluateNode(node.left, x), evaluateNode(node.right, x));
+        case Op::Max:  return std::fmax(evaluateNode(node.left, x), evaluateNode(node.right, x));
+        default: return 0.0f;
+    }
+}
+
+float Expression::evaluate(float x) const {
+    return evaluateNode(root, x);
+}
+
+// glsl
+
+void Expression::glslNode(int index, const std::string& name, std::string& out) const {
+    const Node& node = nodes[index];
+
+    auto call = [&](const char* function) {
+        out += function;
+        out += '(';
+        glslNode(node.left, name, out);
+        if (node.right >= 0) {
+            out += ", ";
+            glslNode(node.right, name, out);
+        }
+        out += ')';
+    };
+    auto infix = [&](const char* op) {
+        out += '(';
+        glslNode(node.left, name, out);
+        out += op;
+        glslNode(node.right, name, out);
+        out += ')';
+    };
+
+    switch (node.op) {
+        case Op::Number: {
+            if (!std::isfinite(node.value)) {
+                out += "uintBitsToFloat(0x7f800000u)";
+                break;
+            }
+            char number[32];
+            std::snprintf(number, sizeof(number), "%.9g", node.value);
+            out += number;
+            if (!std::strpbrk(number, ".e")) {
+                out += ".0";
+            }
+            break;
+        }
+        case Op::Variable:  out += 'x'; break;
+        case Op::Parameter: out += "parameters."; out += "xyzw"[node.index]; break;
+        case Op::Neg:  out += "(-"; glslNode(node.left, name, out); out += ')'; break;
+        case Op::Sin:  call("sin"); break;
+        case Op::Cos:  call("cos"); break;
+        case Op::Tan:  call("tan"); break;
+        case Op::Exp:  call("exp"); break;
+        case Op::Log:  call("log"); break;
+        case Op::Sqrt: call("sqrt"); break;
+        case Op::Abs:  call("abs"); break;
+        case Op::Add:  infix(" + "); break;
+        case Op::Sub:  infix(" - "); break;
+        case Op::Mul:  infix(" * "); break;
+        case Op::Div:  infix(" / "); break;
+        case Op::Min:  call("min"); break;
+        case Op::Max:  call("max"); break;
+        case Op::Pow: {
+            // glsl pow is undefined for a negative base, integer powers go through a helper like on the cpu
+            const Node& exponent = nodes[node.right];
+            if (exponent.op == Op::Number && exponent.value == std::floor(exponent.value) && std::abs(exponent.value) <= 64.0f) {
+                out += name + "PowInt(";
+                glslNode(node.left, name, out);
+                out += ", " + std::to_string(static_cast<int>(exponent.value)) + ")";
+            }
+            else {
+                call("pow");
+            }
+            break;
+        }
+        default: break;
+    }
+}
+
+std::string Expression::glsl(const std::string& name) const {
+    std::string out;
+    out += "float " + name + "PowInt(float x, int n) {\n";
+    out += "    float base = n < 0 ? 1.0 / x : x;\n";
+    out += "    float result = 1.0;\n";
+    out += "    for (int e = abs(n); e > 0; e >>= 1) {\n";
+    out += "        if ((e & 1) != 0) { result *= base; }\n";
+    out += "        base *= base;\n";
+    out += "    }\n";
+    out += "    return result;\n";
+    out += "}\n\n";
+    out += "float " + name + "(float x) {\n    return ";
+    glslNode(root, name, out);
+    out += ";\n}\n";
+    return out;
+}
+
+// code generation
+
+int Expression::allocateRegister(std::vector<bool>& used) {
+    for (int i = 1; i < maxRegisters; i++) {
+        if (!used[i]) {
+            used[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool Expression::generate(int index, Operand& out, std::vector<bool>& used) {
+    const Node& node = nodes[index];
+
+    if (!node.varying) {
+        // the same for every sample: one scalar slot, recomputed only when the parameters change
+        out = Operand{ true, static_cast<uint16_t>(scalars.size()) };
+        scalars.push_back(node.value);
+        if (node.op != Op::Number) {
+            uniform.emplace_back(out.index, index);
+        }
+        return true;
+    }
+
+    if (node.op == Op::Variable) {
+        out = Operand{ false, 0 };
+        return true;
+    }
+
+    Operand a{}, b{};
+    Instruction instruction{ node.op, 0, {}, {}, 0 };
+
+    if (!generate(node.left, a, used)) { return false; }
+
+    const Node* right = node.right >= 0 ? &nodes[node.right] : nullptr;
+    if (node.op == Op::Pow && right && right->op == Op::Number &&
+        right->value == std::floor(right->value) && std::abs(right->value) <= 64.0f) {
+        // x^2, pow(x, 3): a few multiplications instead of exp(log)
+        instruction.op = Op::PowInt;
+        instruction.exponent = static_cast<int>(right->value);
+    }
+    else if (right && !generate(node.right, b, used)) {
+        return false;
+    }
+
+    // operands are dead after this instruction, so the target can reuse their registers
+    if (!a.scalar && a.index != 0) { used[a.index] = false; }
+    if (right && !b.scalar && b.index != 0) { used[b.index] = false; }
+
+    int target = allocateRegister(used);
+    if (target < 0) { return false; }
+
+    instruction.target = static_cast<uint16_t>(target);
+    instruction.a = a;
+    instruction.b = b;
+    program.push_back(instruction);
+
+    out = Operand{ false, static_cast<uint16_t>(target) };
+    return true;
+}
+
+void Expression::evaluate(const float* x, float* y, size_t n) const {
+    alignas(32) float registers[maxRegisters][blockSize];
+
+    for (size_t first = 0; first < n; first += blockSize) {
+        size_t count = n - first < blockSize ? n - first : blockSize;
+        const float* input = x + first;
+
+        auto vector = [&](const Operand& operand) -> const float* {
+            if (operand.scalar) { return nullptr; }
+            return operand.index == 0 ? input : registers[operand.index];
+        };
+        auto scalar = [&](const Operand& operand) -> float {
+            return operand.scalar ? scalars[operand.index] : 0.0f;
+        };
+
+        for (const Instruction& instruction : program) {
+            float* out = registers[instruction.target];
+            const float* a = vector(instruction.a);
+            const float* b = vector(instruction.b);
+            float sa = scalar(instruction.a);
+            float sb = scalar(instruction.b);
+
+            switch (instruction.op) {
+                case Op::Neg:  unary(out, a, count, [](float v) { return -v; }); break;
+                case Op::Sin:  unary(out, a, count, [](float v) { return fastSin(v); }); break;
+                case Op::Cos:  unary(out, a, count, [](float v) { return fastCos(v); }); break;
+                case Op::Exp:  unary(out, a, count, [](float v) { return fastExp(v); }); break;
+                case Op::Sqrt: unary(out, a, count, [](float v) { return std::sqrt(v); }); break;
+                case Op::Abs:  unary(out, a, count, [](float v) { return std::abs(v); }); break;
+                case Op::Tan:  unary(out, a, count, [](float v) { return std::tan(v); }); break;
+                case Op::Log:  unary(out, a, count, [](float v) { return std::log(v); }); break;
+                case Op::PowInt: {
+                    int exponent = instruction.exponent;
+                    unary(out, a, count, [exponent](float v) { return powInt(v, exponent); });
+                    break;
+                }
+                case Op::Add: binary(out, a, sa, b, sb, count, [](float l, float r) { return l + r; }); break;
+                case Op::Sub: binary(out, a, sa, b, sb, count, [](float l, float r) { return l - r; }); break;
+                case Op::Mul: binary(out, a, sa, b, sb, count, [](float l, float r) { return l * r; }); break;
+                case Op::Div: binary(out, a, sa, b, sb, count, [](float l, float r) { return l / r; }); break;
+                case Op::Min: binary(out, a, sa, b, sb, count, [](float l, float r) { return l < r ? l : r; }); break;
+                case Op::Max: binary(out, a, sa, b, sb, count, [](float l, float r) { return l > r ? l : r; }); break;
+                case Op::Pow: binary(out, a, sa, b, sb, count, [](float l, float r) { return std::pow(l, r); }); break;
+                default: break;
+            }
+        }
+
+        if (result.scalar) {
+            float value = scalars[result.index];
+            for (size_t i = 0; i < count; i++) {
+                y[first + i] = value;
+            }
+        }
+        else {
+            const float* values = result.index == 0 ? input : registers[result.index];
+            std::memcpy(y + first, values, count * sizeof(float));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#ifndef _Expression_h_
+#define _Expression_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// y = f(x) typed by the user, e.g. "a * sin(b * x) + pow(x, 2) / 4".
+// The text is parsed into a tree and compiled to a register bytecode whose every instruction
+// processes a whole block of samples, so the loops of the virtual machine are vectorized.
+//
+// grammar:
+//   expr    = term { ("+" | "-") term }
+//   term    = unary { ("*" | "/") unary | primary }     (implicit multiplication: 2x, 3(x + 1))
+//   unary   = ("-" | "+") unary | power
+//   power   = primary [ "^" unary ]
+//   primary = number | "x" | "a" | "b" | "c" | "d" | "pi" | "e" | function "(" expr [ "," expr ] ")" | "(" expr ")"
+//   function: sin cos tan exp log sqrt abs pow min max
+class Expression {
+public:
+    static const int parameterCount = 4;
+    static const size_t blockSize = 256;
+
+    float parameters[parameterCount]{ 1.0f, 1.0f, 1.0f, 1.0f }; // a, b, c, d
+
+    Expression();
+
+    // on failure the previous program is kept and error describes the problem
+    bool compile(const std::string& source, std::string& error);
+    // recomputes everything that depends only on the parameters, call after changing them
+    void updateParameters();
+
+    const std::string& source() const { return text; }
+    size_t instructionCount() const { return program.size(); }
+
+    // tree-walking evaluation of one value
+    float evaluate(float x) const;
+    // bytecode evaluation of n values, thread-safe
+    void evaluate(const float* x, float* y, size_t n) const;
+
+    // GLSL definition of "float name(float x)" for evaluation on the gpu;
+    // the parameters are read from "uniform vec4 parameters" which has to be declared before it
+    std::string glsl(const std::string& name) const;
+
+private:
+    enum class Op : uint8_t {
+        Number, Variable, Parameter,
+        Neg, Sin, Cos, Tan, Exp, Log, Sqrt, Abs,
+        Add, Sub, Mul, Div, Pow, Min, Max,
+        PowInt // only in bytecode: integer power by repeated multiplication
+    };
+
+    struct Node {
+        Op op;
+        float value;      // Number
+        int index;        // Parameter
+        int left, right;  // children, -1 if not used
+        bool varying;     // depends on x
+    };
+
+    // bytecode operand: a block register or a scalar slot (constant or parameter-only subexpression)
+    struct Operand {
+        bool scalar;
+        uint16_t index;
+    };
+
+    struct Instruction {
+        Op op;
+        uint16_t target;
+        Operand a, b;
+        int exponent; // PowInt
+    };
+
+    static const int maxRegisters = 16;
+
+    std::string text;
+    std::vector<Node> nodes;
+    int root{ -1 };
+
+    std::vector<Instruction> program;
+    Operand result{};
+    int registerCount{};
+    std::vector<float> scalars;              // values of scalar slots
+    std::vector<std::pair<int, int>> uniform; // (slot, node) recomputed by updateParameters
+
+    // parser state
+    const char* cursor{};
+    std::string parseError;
+
+    int parseExpr();
+    int parseTerm();
+    int parseUnary();
+    int parsePower();
+    int parsePrimary();
+    int addNode(Op op, int left = -1, int right = -1, float value = 0.0f, int index = 0);
+    void skipSpaces();
+    bool startsPrimary() const;
+
+    float evaluateNode(int node, float x) const;
+    void glslNode(int node, const std::string& name, std::string& out) const;
+
+    // code generation, returns false if there are not enough registers
+    bool generate(int node, Operand& out, std::vector<bool>& used);
+    int allocateRegister(std::vector<bool>& used);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "FunctionPlot.h"
+#include "GLState.h"
+
+#include <utility>
+
+FunctionPlot::~FunctionPlot() {
+    release();
+}
+
+FunctionPlot::FunctionPlot(FunctionPlot&& other) noexcept {
+    *this = std::move(other);
+}
+
+FunctionPlot& FunctionPlot::operator=(FunctionPlot&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::swap(VBO, other.VBO);
+        std::swap(VAO, other.VAO);
+        std::swap(count, other.count);
+        std::swap(color, other.color);
+        std::swap(function, other.function);
+        std::swap(mapped, other.mapped);
+        std::swap(capacity, other.capacity);
+        std::swap(fences, other.fences);
+        std::swap(frame, other.frame);
+    }
+    return *this;
+}
+
+void FunctionPlot::init(size_t _capacity) {
+    VAO.create();
+    VAO.floatAttributes(0, { 2 });
+    allocate(_capacity);
+}
+
+void FunctionPlot::release() {
+    deleteFences();
+    VBO.release();
+    VAO.release();
+    mapped = nullptr;
+    capacity = 0;
+    count = 0;
+}
+
+void FunctionPlot::deleteFences() {
+    for (int i = 0; i < frameCount; i++) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+}
+
+void FunctionPlot::allocate(size_t size) {
+    capacity = size > 0 ? size : 1;
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(sizeof(glm::vec2) * capacity * frameCount);
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    // the previous buffer is unmapped and deleted by the replacement; draws that were already
+    // issued keep its storage alive, so the fences of its regions are not needed any more
+    deleteFences();
+    frame = 0;
+    VBO.storage(bytes, nullptr, flags);
+    mapped = static_cast<glm::vec2*>(VBO.map(0, bytes, flags));
+    VAO.vertexBuffer(0, VBO, 0, sizeof(glm::vec2));
+}
+
+void FunctionPlot::evaluate(float xMin, float xMax, size_t samples, ThreadPool& pool) {
+    if (!function || samples < 2) {
+        count = 0;
+        return;
+    }
+
+    if (samples > capacity) {
+        allocate(samples);
+    }
+    if (fences[frame]) {
+        GLenum result = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(fences[frame]);
+        fences[frame] = nullptr;
+    }
+
+    float dx = (xMax - xMin) / static_cast<float>(samples - 1);
+    evaluateBatch(function, xMin, dx, Span<glm::vec2>{ mapped + frame * capacity, samples }, pool);
+    count = static_cast<GLsizei>(samples);
+    glState.countUpload(sizeof(glm::vec2) * samples);
+}
+
+void FunctionPlot::draw() {
+    if (count == 0) { return; }
+
+    VAO.bind();
+    glState.drawArrays(GL_LINE_STRIP, static_cast<GLint>(frame * capacity), count);
+
+    // the next evaluate writes the next region while the gpu reads this one
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % frameCount;
+}
\ No newline at end of file
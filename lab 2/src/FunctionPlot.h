@@ -0,0 +1,50 @@
+#ifndef _FunctionPlot_h_
+#define _FunctionPlot_h_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "BatchEval.h"
+#include "GLObjects.h"
+#include "ThreadPool.h"
+
+// densely and uniformly sampled curve that is re-evaluated in place:
+// the workers write the samples straight into a persistently mapped vertex buffer, which is split
+// into regions of capacity samples for the frames in flight, as in StreamBuffer
+class FunctionPlot {
+public:
+    Buffer VBO;
+    VertexArray VAO;
+    GLsizei count{};
+    glm::vec3 color{ 0.0f };
+    BatchFunction function;
+
+    FunctionPlot() = default;
+    ~FunctionPlot();
+
+    FunctionPlot(const FunctionPlot&) = delete;
+    FunctionPlot& operator=(const FunctionPlot&) = delete;
+    FunctionPlot(FunctionPlot&& other) noexcept;
+    FunctionPlot& operator=(FunctionPlot&& other) noexcept;
+
+    void init(size_t capacity);
+    void release();
+
+    // samples the function over [xMin, xMax] into the region of this frame; waits only while the gpu
+    // still reads the samples that were drawn from it frameCount draws ago
+    void evaluate(float xMin, float xMax, size_t samples, ThreadPool& pool);
+    void draw();
+
+private:
+    static const int frameCount = 3;
+
+    glm::vec2* mapped{};
+    size_t capacity{}; // samples per region
+    GLsync fences[frameCount]{};
+    int frame{};
+
+    void allocate(size_t size);
+    void deleteFences();
+};
+
+#endif
\ No newline at end of file
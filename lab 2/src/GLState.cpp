@@ -0,0 +1,134 @@
+#include "GLState.h"
+
+#include <fstream>
+
+GLState glState;
+
+void GLState::beginFrame() {
+    auto now = std::chrono::steady_clock::now();
+    if (started) {
+        frame.frameTime = std::chrono::duration<float, std::milli>(now - frameStart).count();
+        last = frame;
+        if (history.size() < historySize) {
+            history.push_back(frame);
+        } else {
+            history[finished % historySize] = frame;
+        }
+        finished++;
+    }
+    started = true;
+    frameStart = now;
+    frame = Counters();
+
+    invalidate();
+}
+
+void GLState::invalidate() {
+    program = unknown;
+    vertexArray = unknown;
+    framebuffer = unknown;
+    for (GLuint& texture : textures) {
+        texture = unknown;
+    }
+}
+
+void GLState::useProgram(GLuint _program) {
+    if (program == _program) {
+        frame.redundantChanges++;
+        return;
+    }
+    glUseProgram(_program);
+    program = _program;
+    frame.stateChanges++;
+}
+
+void GLState::bindVertexArray(GLuint _vertexArray) {
+    if (vertexArray == _vertexArray) {
+        frame.redundantChanges++;
+        return;
+    }
+    glBindVertexArray(_vertexArray);
+    vertexArray = _vertexArray;
+    frame.stateChanges++;
+}
+
+void GLState::bindFramebuffer(GLuint _framebuffer) {
+    if (framebuffer == _framebuffer) {
+        frame.redundantChanges++;
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    framebuffer = _framebuffer;
+    frame.stateChanges++;
+}
+
+void GLState::bindTexture(GLuint unit, GLuint texture) {
+    if (unit < maxTextureUnits) {
+        if (textures[unit] == texture) {
+            frame.redundantChanges++;
+            return;
+        }
+        textures[unit] = texture;
+    }
+    glBindTextureUnit(unit, texture);
+    frame.stateChanges++;
+}
+
+void GLState::forgetProgram(GLuint _program) {
+    if (program == _program) { program = unknown; }
+}
+
+void GLState::forgetVertexArray(GLuint _vertexArray) {
+    if (vertexArray == _vertexArray) { vertexArray = unknown; }
+}
+
+void GLState::forgetFramebuffer(GLuint _framebuffer) {
+    if (framebuffer == _framebuffer) { framebuffer = unknown; }
+}
+
+void GLState::forgetTexture(GLuint texture) {
+    for (GLuint& bound : textures) {
+        if (bound == texture) { bound = unknown; }
+    }
+}
+
+void GLState::drawArrays(GLenum mode, GLint first, GLsizei count) {
+    glDrawArrays(mode, first, count);
+    frame.drawCalls++;
+}
+
+void GLState::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+    glDrawArraysInstanced(mode, first, count, instances);
+    frame.drawCalls++;
+}
+
+void GLState::drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    glDrawElements(mode, count, type, indices);
+    frame.drawCalls++;
+}
+
+void GLState::multiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawCount) {
+    glMultiDrawArrays(mode, first, count, drawCount);
+    frame.drawCalls++;
+}
+
+void GLState::multiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride) {
+    glMultiDrawElementsIndirect(mode, type, indirect, drawCount, stride);
+    frame.drawCalls++;
+}
+
+bool GLState::exportCsv(const std::string& path) const {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    file << "frame,time_ms,draw_calls,state_changes,redundant_changes,buffer_uploads,uploaded_bytes\n";
+    size_t first = finished - history.size();
+    for (size_t i = first; i < finished; i++) {
+        const Counters& c = history[i % historySize];
+        file << i << ',' << c.frameTime << ',' << c.drawCalls << ',' << c.stateChanges << ',' << c.redundantChanges << ','
+            << c.bufferUploads << ',' << c.uploadedBytes << '\n';
+    }
+    return static_cast<bool>(file);
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#ifndef _GeometryBatch_h_
+#define _GeometryBatch_h_
+
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+#include <glad/glad.h>
+
+#include "GLObjects.h"
+
+// static helper geometry (axes, arrows, ...) of one vertex format merged into one immutable buffer.
+// Parts are grouped by primitive type when the batch is built, so draw() issues one call per type:
+// glDrawArrays over the whole group for independent primitives (points, lines, triangles) and
+// glMultiDrawArrays for strips, loops and fans, which must not run into each other
+class GeometryBatch {
+public:
+    Buffer VBO;
+    VertexArray VAO;
+
+    GeometryBatch() = default;
+    ~GeometryBatch();
+
+    GeometryBatch(const GeometryBatch&) = delete;
+    GeometryBatch& operator=(const GeometryBatch&) = delete;
+
+    // attributes - number of float components of every vertex attribute (location 0, 1, ...);
+    // drops the parts and the buffer of a previous batch
+    void init(std::initializer_list<GLint> attributes);
+    void release();
+
+    // copies count vertices and returns the index of the part; only between init() and build(),
+    // -1 otherwise
+    int add(const GLfloat* data, GLsizei count, GLenum mode);
+    // uploads all parts, the vertices are kept on the cpu only until then
+    void build();
+
+    void draw() const;
+
+    // index of the first vertex of the part in the buffer, valid after build()
+    GLint first(int part) const { return parts[part].first; }
+    GLsizei count(int part) const { return parts[part].count; }
+    int partCount() const { return static_cast<int>(parts.size()); }
+    // calls issued by draw()
+    int drawCalls() const { return static_cast<int>(groups.size()); }
+
+private:
+    struct Part {
+        GLenum mode;
+        GLint first;    // in vertices, into the staged data before build() and into the buffer after it
+        GLsizei count;
+    };
+
+    // consecutive parts of one primitive type in the buffer
+    struct Group {
+        GLenum mode;
+        bool merged;       // one glDrawArrays over [first, first + count)
+        GLint first;
+        GLsizei count;
+        size_t part;       // first entry of firsts/counts for glMultiDrawArrays
+        GLsizei drawCount;
+    };
+
+    GLsizei stride{};          // in floats
+
+    std::vector<GLfloat> staged;
+    std::vector<Part> parts;
+    std::vector<Group> groups;
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+
+    static bool independent(GLenum mode);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+#include "GpuPlot.h"
+#include "GLState.h"
+
+GpuPlot::~GpuPlot() {
+    release();
+}
+
+void GpuPlot::init(const char* _vertexPath, const char* _fragmentPath) {
+    vertexPath = _vertexPath;
+    fragmentPath = _fragmentPath;
+    // the core profile does not draw without a vertex array even if it has no attributes
+    VAO.create();
+}
+
+void GpuPlot::release() {
+    program.reset();
+    VAO.release();
+}
+
+bool GpuPlot::build(const Expression& expression) {
+    auto built = std::make_unique<ShaderProgram>(vertexPath.c_str(), fragmentPath.c_str(), expression.glsl("f"));
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(built->ID, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        return false;
+    }
+
+    program = std::move(built);
+    rangeLocation = program->location("range");
+    samplesLocation = program->location("samples");
+    parametersLocation = program->location("parameters");
+    colorLocation = program->location("color");
+    return true;
+}
+
+void GpuPlot::draw(float xMin, float xMax, GLsizei samples, const float* parameters) {
+    if (!program || samples < 2) { return; }
+
+    program->use();
+    program->setVec2(rangeLocation, xMin, xMax);
+    program->setInt(samplesLocation, samples);
+    program->setVec4(parametersLocation, parameters[0], parameters[1], parameters[2], parameters[3]);
+    program->setVec3(colorLocation, color);
+
+    VAO.bind();
+    glState.drawArrays(GL_LINE_STRIP, 0, samples);
+}
\ No newline at end of file
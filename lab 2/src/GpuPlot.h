@@ -0,0 +1,45 @@
+#ifndef _GpuPlot_h_
+#define _GpuPlot_h_
+
+#include <memory>
+#include <string>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Expression.h"
+#include "GLObjects.h"
+#include "ShaderProgram.h"
+
+// plot of an expression evaluated in the vertex shader: nothing is uploaded,
+// zooming, panning and moving a parameter only change uniforms
+class GpuPlot {
+public:
+    glm::vec3 color{ 0.0f };
+
+    GpuPlot() = default;
+    ~GpuPlot();
+
+    GpuPlot(const GpuPlot&) = delete;
+    GpuPlot& operator=(const GpuPlot&) = delete;
+
+    void init(const char* vertexPath, const char* fragmentPath);
+    void release();
+
+    // generates and links the shader of the expression, on failure the previous one is kept
+    bool build(const Expression& expression);
+    // changes the program and the bound vertex array
+    void draw(float xMin, float xMax, GLsizei samples, const float* parameters);
+
+private:
+    std::string vertexPath;
+    std::string fragmentPath;
+
+    VertexArray VAO;
+    std::unique_ptr<ShaderProgram> program;
+    GLint rangeLocation{ -1 };
+    GLint samplesLocation{ -1 };
+    GLint parametersLocation{ -1 };
+    GLint colorLocation{ -1 };
+};
+
+#endif
\ No newline at end of file
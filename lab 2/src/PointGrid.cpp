@@ -0,0 +1,242 @@
+#include "PointGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const size_t grain = 64 * 1024;
+
+template <typename F>
+void forRange(ThreadPool* pool, size_t count, F&& f) {
+    if (pool && count > grain) {
+        pool->parallelFor(count, grain, f);
+    }
+    else {
+        f(0, count);
+    }
+}
+
+}
+
+int PointGrid::column(float x) const {
+    int c = static_cast<int>(std::floor((x - originX) / cellSize));
+    return std::clamp(c, 0, columns - 1);
+}
+
+int PointGrid::row(float y) const {
+    int r = static_cast<int>(std::floor((y - originY) / cellSize));
+    return std::clamp(r, 0, rows - 1);
+}
+
+void PointGrid::build(const PointSet& points, ThreadPool* pool) {
+    const size_t count = points.size();
+    pending.clear();
+    builtCount = count;
+    built = true;
+
+    // bounds, one partial result per chunk
+    const float infinity = std::numeric_limits<float>::infinity();
+    const size_t chunks = (count + grain - 1) / grain;
+    std::vector<float> bounds(4 * std::max<size_t>(chunks, 1), infinity);
+    forRange(pool, count, [&](size_t begin, size_t end) {
+        float* b = &bounds[4 * (begin / grain)];
+        float minX = infinity, minY = infinity, maxX = -infinity, maxY = -infinity;
+        for (size_t i = begin; i < end; i++) {
+            minX = std::min(minX, points.x(i));
+            maxX = std::max(maxX, points.x(i));
+            minY = std::min(minY, points.y(i));
+            maxY = std::max(maxY, points.y(i));
+        }
+        b[0] = minX; b[1] = minY; b[2] = -maxX; b[3] = -maxY;
+    });
+    float minX = infinity, minY = infinity, maxX = -infinity, maxY = -infinity;
+    for (size_t c = 0; c < bounds.size() / 4; c++) {
+        minX = std::min(minX, bounds[4 * c]);
+        minY = std::min(minY, bounds[4 * c + 1]);
+        maxX = std::max(maxX, -bounds[4 * c + 2]);
+        maxY = std::max(maxY, -bounds[4 * c + 3]);
+    }
+    if (count == 0 || !std::isfinite(minX) || !std::isfinite(maxX) || !std::isfinite(minY) || !std::isfinite(maxY)) {
+        minX = minY = 0.0f;
+        maxX = maxY = 1.0f;
+    }
+
+    // about two points per cell
+    float width = std::max(maxX - minX, 1e-6f);
+    float height = std::max(maxY - minY, 1e-6f);
+    double cells = std::max<double>(static_cast<double>(count) / 2.0, 1.0);
+    cellSize = static_cast<float>(std::sqrt(static_cast<double>(width) * height / cells));
+    cellSize = std::max({ cellSize, width / 65536.0f, height / 65536.0f });
+    columns = std::max(1, static_cast<int>(std::ceil(width / cellSize)));
+    rows = std::max(1, static_cast<int>(std::ceil(height / cellSize)));
+    originX = minX;
+    originY = minY;
+    const size_t cellCount = static_cast<size_t>(columns) * rows;
+
+    // radix sort of the points by cell, 8 bits per pass (few enough output streams for the tlb);
+    // every chunk of the pool has its own histogram
+    entries.resize(count);
+    scratch.resize(count);
+    forRange(pool, count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            float x = points.x(i);
+            float y = points.y(i);
+            entries[i] = Entry{ x, y, static_cast<uint32_t>(i), static_cast<uint32_t>(row(y) * columns + column(x)) };
+        }
+    });
+
+    const int radixBits = 8;
+    const size_t buckets = size_t(1) << radixBits;
+    std::vector<uint32_t> histograms(std::max<size_t>(chunks, 1) * buckets);
+    for (int shift = 0; (cellCount - 1) >> shift; shift += radixBits) {
+        std::fill(histograms.begin(), histograms.end(), 0);
+        forRange(pool, count, [&](size_t begin, size_t end) {
+            uint32_t* histogram = &histograms[begin / grain * buckets];
+            for (size_t i = begin; i < end; i++) {
+                histogram[(entries[i].cell >> shift) & (buckets - 1)]++;
+            }
+        });
+        // offsets: bucket by bucket, chunk by chunk inside a bucket, so the sort is stable
+        uint32_t offset = 0;
+        for (size_t b = 0; b < buckets; b++) {
+            for (size_t c = 0; c < std::max<size_t>(chunks, 1); c++) {
+                uint32_t n = histograms[c * buckets + b];
+                histograms[c * buckets + b] = offset;
+                offset += n;
+            }
+        }
+        forRange(pool, count, [&](size_t begin, size_t end) {
+            uint32_t* histogram = &histograms[begin / grain * buckets];
+            for (size_t i = begin; i < end; i++) {
+                scratch[histogram[(entries[i].cell >> shift) & (buckets - 1)]++] = entries[i];
+            }
+        });
+        entries.swap(scratch);
+    }
+
+    cellStart.assign(cellCount + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        cellStart[entries[i].cell + 1]++;
+    }
+    for (size_t c = 0; c < cellCount; c++) {
+        cellStart[c + 1] += cellStart[c];
+    }
+}
+
+void PointGrid::insert(size_t index) {
+    if (!built) { return; }
+    pending.push_back(static_cast<uint32_t>(index));
+    if (pending.size() > maxPending) {
+        built = false;
+    }
+}
+
+void PointGrid::removeLast(size_t size) {
+    if (!pending.empty() && pending.back() >= size) {
+        pending.pop_back();
+    }
+    builtCount = std::min(builtCount, size);
+}
+
+long long PointGrid::nearest(const PointSet& points, float x, float y, float maxDistance) const {
+    long long best = -1;
+    float bestSquared = maxDistance * maxDistance;
+
+    auto test = [&](uint32_t i) {
+        float dx = points.x(i) - x;
+        float dy = points.y(i) - y;
+        float squared = dx * dx + dy * dy;
+        if (squared <= bestSquared) {
+            bestSquared = squared;
+            best = i;
+        }
+    };
+
+    for (uint32_t i : pending) {
+        test(i);
+    }
+
+    auto scanRow = [&](int r, int c0, int c1) {
+        // the cells of one row are contiguous in entries
+        uint32_t first = cellStart[static_cast<size_t>(r) * columns + c0];
+        uint32_t last = cellStart[static_cast<size_t>(r) * columns + c1 + 1];
+        for (uint32_t k = first; k < last; k++) {
+            const Entry& entry = entries[k];
+            float dx = entry.x - x;
+            float dy = entry.y - y;
+            float squared = dx * dx + dy * dy;
+            if (squared <= bestSquared && entry.index < builtCount) {
+                bestSquared = squared;
+                best = entry.index;
+            }
+        }
+    };
+
+    // a small search radius (picking) covers a few cells: one pass over their rows
+    if (maxDistance < 4.0f * cellSize) {
+        int c0 = column(x - maxDistance), c1 = column(x + maxDistance);
+        for (int r = row(y - maxDistance); r <= row(y + maxDistance); r++) {
+            scanRow(r, c0, c1);
+        }
+        return best;
+    }
+
+    // rings of cells around the cell of (x, y); cells of ring r are at least (r - 1) cells away
+    const int centerColumn = column(x);
+    const int centerRow = row(y);
+    const int maxRing = std::max(columns, rows);
+    for (int ring = 0; ring <= maxRing; ring++) {
+        float gap = (ring - 1) * cellSize;
+        if (gap > 0.0f && gap * gap > bestSquared) { break; }
+
+        int r0 = centerRow - ring, r1 = centerRow + ring;
+        int c0 = centerColumn - ring, c1 = centerColumn + ring;
+        for (int r = std::max(r0, 0); r <= std::min(r1, rows - 1); r++) {
+            if (r == r0 || r == r1) {
+                scanRow(r, std::max(c0, 0), std::min(c1, columns - 1));
+                continue;
+            }
+            // inner rows only have the two cells at the ends of the ring
+            if (c0 >= 0) {
+                scanRow(r, c0, c0);
+            }
+            if (c1 < columns) {
+                scanRow(r, c1, c1);
+            }
+        }
+    }
+    return best;
+}
+
+void PointGrid::query(const PointSet& points, float xMin, float yMin, float xMax, float yMax, std::vector<uint32_t>& out) const {
+    out.clear();
+
+    auto inside = [&](uint32_t i) {
+        float px = points.x(i);
+        float py = points.y(i);
+        return px >= xMin && px <= xMax && py >= yMin && py <= yMax;
+    };
+
+    if (columns > 0) {
+        int c0 = column(xMin), c1 = column(xMax);
+        int r0 = row(yMin), r1 = row(yMax);
+        for (int r = r0; r <= r1; r++) {
+            uint32_t first = cellStart[static_cast<size_t>(r) * columns + c0];
+            uint32_t last = cellStart[static_cast<size_t>(r) * columns + c1 + 1];
+            // the cells of one row are contiguous in entries
+            for (uint32_t k = first; k < last; k++) {
+                const Entry& entry = entries[k];
+                if (entry.index < builtCount && entry.x >= xMin && entry.x <= xMax && entry.y >= yMin && entry.y <= yMax) {
+                    out.push_back(entry.index);
+                }
+            }
+        }
+    }
+    for (uint32_t i : pending) {
+        if (inside(i)) {
+            out.push_back(i);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef _PointGrid_h_
+#define _PointGrid_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "PointSet.h"
+#include "ThreadPool.h"
+
+// uniform grid over the points of a PointSet for nearest point and rectangle queries.
+// The cells are stored compactly (start of every cell + copies of the points sorted by cell, built with
+// a parallel radix sort); points appended later go to a short list that is searched linearly until the next build.
+class PointGrid {
+public:
+    // when more points than this were appended since the build, the grid asks to be rebuilt
+    static const size_t maxPending = 4096;
+
+    void build(const PointSet& points, ThreadPool* pool = nullptr);
+    // the point with this index was appended to the set
+    void insert(size_t index);
+    // the last point of the set was removed, size is the new size of the set
+    void removeLast(size_t size);
+    void invalidate() { built = false; }
+    bool valid() const { return built; }
+
+    // index of the nearest point not farther than maxDistance, -1 if there is none
+    long long nearest(const PointSet& points, float x, float y, float maxDistance) const;
+    // indices of the points inside [xMin, xMax] x [yMin, yMax]
+    void query(const PointSet& points, float xMin, float yMin, float xMax, float yMax, std::vector<uint32_t>& out) const;
+
+private:
+    float originX{}, originY{};
+    float cellSize{ 1.0f };
+    int columns{}, rows{};
+    // copy of a point, so the queries read the cells sequentially
+    struct Entry {
+        float x, y;
+        uint32_t index;
+        uint32_t cell;
+    };
+
+    std::vector<uint32_t> cellStart; // columns * rows + 1 offsets into entries
+    std::vector<Entry> entries;      // points sorted by cell
+    std::vector<Entry> scratch;      // second buffer of the sort, kept for the next build
+    std::vector<uint32_t> pending;   // appended after the build
+    size_t builtCount{};             // entries with an index from here on were removed
+    bool built{ false };
+
+    int column(float x) const;
+    int row(float y) const;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "PointSet.h"
+
+#include <cmath>
+#include <cstring>
+#include <new>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define POINT_SET_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace {
+
+const size_t alignment = 32;   // one AVX register
+const size_t grain = 16 * 1024; // points per task of the pool, a multiple of the vector width
+
+void transformScalar(const Affine2& m, float* x, float* y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float px = x[i];
+        float py = y[i];
+        x[i] = m.xx * px + m.xy * py + m.tx;
+        y[i] = m.yx * px + m.yy * py + m.ty;
+    }
+}
+
+#ifdef POINT_SET_X86
+void transformSSE(const Affine2& m, float* x, float* y, size_t n) {
+    const __m128 xx = _mm_set1_ps(m.xx), xy = _mm_set1_ps(m.xy), tx = _mm_set1_ps(m.tx);
+    const __m128 yx = _mm_set1_ps(m.yx), yy = _mm_set1_ps(m.yy), ty = _mm_set1_ps(m.ty);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        _mm_storeu_ps(x + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, px), _mm_mul_ps(xy, py)), tx));
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(yx, px), _mm_mul_ps(yy, py)), ty));
+    }
+    transformScalar(m, x + i, y + i, n - i);
+}
+
+TARGET_AVX2 void transformAVX2(const Affine2& m, float* x, float* y, size_t n) {
+    const __m256 xx = _mm256_set1_ps(m.xx), xy = _mm256_set1_ps(m.xy), tx = _mm256_set1_ps(m.tx);
+    const __m256 yx = _mm256_set1_ps(m.yx), yy = _mm256_set1_ps(m.yy), ty = _mm256_set1_ps(m.ty);
+
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        _mm256_storeu_ps(x + i, _mm256_fmadd_ps(xx, px, _mm256_fmadd_ps(xy, py, tx)));
+        _mm256_storeu_ps(y + i, _mm256_fmadd_ps(yx, px, _mm256_fmadd_ps(yy, py, ty)));
+    }
+    transformScalar(m, x + i, y + i, n - i);
+}
+
+bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSaves = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osSaves || !avx || !fma || (_xgetbv(0) & 6) != 6) { return false; }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+#endif
+
+}
+
+Affine2 Affine2::translation(float x, float y) {
+    Affine2 m;
+    m.tx = x;
+    m.ty = y;
+    return m;
+}
+
+Affine2 Affine2::scaling(float x, float y) {
+    Affine2 m;
+    m.xx = x;
+    m.yy = y;
+    return m;
+}
+
+Affine2 Affine2::pointReflection(float x, float y) {
+    Affine2 m;
+    m.xx = -1.0f;
+    m.yy = -1.0f;
+    m.tx = 2.0f * x;
+    m.ty = 2.0f * y;
+    return m;
+}
+
+Affine2 Affine2::rotation(float x, float y, float angle) {
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    Affine2 m;
+    m.xx = c; m.xy = -s;
+    m.yx = s; m.yy = c;
+    // the pivot stays in place: p - R * p
+    m.tx = x - (c * x - s * y);
+    m.ty = y - (s * x + c * y);
+    return m;
+}
+
+Affine2 Affine2::operator*(const Affine2& o) const {
+    Affine2 m;
+    m.xx = xx * o.xx + xy * o.yx;
+    m.xy = xx * o.xy + xy * o.yy;
+    m.yx = yx * o.xx + yy * o.yx;
+    m.yy = yx * o.xy + yy * o.yy;
+    m.tx = xx * o.tx + xy * o.ty + tx;
+    m.ty = yx * o.tx + yy * o.ty + ty;
+    return m;
+}
+
+Affine2 Affine2::inverse() const {
+    float d = 1.0f / determinant();
+    Affine2 m;
+    m.xx =  yy * d; m.xy = -xy * d;
+    m.yx = -yx * d; m.yy =  xx * d;
+    m.tx = -(m.xx * tx + m.xy * ty);
+    m.ty = -(m.yx * tx + m.yy * ty);
+    return m;
+}
+
+PointSet::~PointSet() {
+    if (data) {
+        ::operator delete[](data, std::align_val_t(alignment));
+    }
+}
+
+void PointSet::reserve(size_t size) {
+    if (size <= allocated) { return; }
+
+    // a multiple of 8 keeps the y block aligned as well
+    size_t grown = allocated ? allocated * 2 : 64;
+    while (grown < size) {
+        grown *= 2;
+    }
+
+    float* moved = static_cast<float*>(::operator new[](2 * grown * sizeof(float), std::align_val_t(alignment)));
+    if (data) {
+        std::memcpy(moved, data, count * sizeof(float));
+        std::memcpy(moved + grown, data + allocated, count * sizeof(float));
+        ::operator delete[](data, std::align_val_t(alignment));
+    }
+    data = moved;
+    allocated = grown;
+}
+
+void PointSet::push(float x, float y) {
+    reserve(count + 1);
+    data[count] = x;
+    data[allocated + count] = y;
+    count++;
+}
+
+void PointSet::pop() {
+    if (count > 0) {
+        count--;
+    }
+}
+
+void PointSet::set(size_t i, float x, float y) {
+    data[i] = x;
+    data[allocated + i] = y;
+}
+
+void PointSet::resize(size_t size) {
+    reserve(size);
+    count = size;
+}
+
+void PointSet::assign(const PointSet& other) {
+    if (this == &other) { return; }
+    reserve(other.count);
+    count = other.count;
+    std::memcpy(data, other.data, count * sizeof(float));
+    std::memcpy(data + allocated, other.data + other.allocated, count * sizeof(float));
+}
+
+void PointSet::transform(const Affine2& m, ThreadPool* pool, PointKernel kernel) {
+    void (*function)(const Affine2&, float*, float*, size_t) = transformScalar;
+#ifdef POINT_SET_X86
+    if (kernel == PointKernel::SSE) {
+        function = transformSSE;
+    }
+    else if (kernel == PointKernel::AVX2) {
+        function = transformAVX2;
+    }
+#endif
+
+    float* x = data;
+    float* y = data + allocated;
+    if (!pool || count < parallelThreshold) {
+        function(m, x, y, count);
+        return;
+    }
+    pool->parallelFor(count, grain, [&](size_t begin, size_t end) {
+        function(m, x + begin, y + begin, end - begin);
+    });
+}
+
+PointKernel PointSet::bestKernel() {
+#ifdef POINT_SET_X86
+    static const PointKernel best = cpuHasAVX2() ? PointKernel::AVX2 : PointKernel::SSE;
+    return best;
+#else
+    return PointKernel::Scalar;
+#endif
+}
+
+const char* PointSet::kernelName(PointKernel kernel) {
+    switch (kernel) {
+        case PointKernel::SSE:  return "SSE";
+        case PointKernel::AVX2: return "AVX2";
+        default:                return "scalar";
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef _PointSet_h_
+#define _PointSet_h_
+
+#include <cstddef>
+
+#include "ThreadPool.h"
+
+// 2d affine map (x, y) -> (xx * x + xy * y + tx, yx * x + yy * y + ty)
+struct Affine2 {
+    float xx{ 1.0f }, xy{ 0.0f };
+    float yx{ 0.0f }, yy{ 1.0f };
+    float tx{ 0.0f }, ty{ 0.0f };
+
+    static Affine2 translation(float x, float y);
+    static Affine2 scaling(float x, float y);
+    // reflection through the point (x, y)
+    static Affine2 pointReflection(float x, float y);
+    // counterclockwise rotation about the point (x, y), angle in radians
+    static Affine2 rotation(float x, float y, float angle);
+
+    // applies other first, then this
+    Affine2 operator*(const Affine2& other) const;
+
+    float x(float px, float py) const { return xx * px + xy * py + tx; }
+    float y(float px, float py) const { return yx * px + yy * py + ty; }
+
+    float determinant() const { return xx * yy - xy * yx; }
+    // only meaningful if the determinant is not 0
+    Affine2 inverse() const;
+};
+
+enum class PointKernel { Scalar, SSE, AVX2 };
+
+// points stored as structure of arrays in one aligned allocation: capacity x coordinates
+// followed by capacity y coordinates, so the whole set goes to the gpu with one buffer update
+class PointSet {
+public:
+    // below this number of points the transforms run on the calling thread only
+    static const size_t parallelThreshold = 64 * 1024;
+
+    PointSet() = default;
+    ~PointSet();
+
+    PointSet(const PointSet&) = delete;
+    PointSet& operator=(const PointSet&) = delete;
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return allocated; }
+
+    float x(size_t i) const { return data[i]; }
+    float y(size_t i) const { return data[allocated + i]; }
+    const float* xs() const { return data; }
+    const float* ys() const { return data + allocated; }
+    // the x block and the y block as one array of 2 * capacity() floats
+    const float* storage() const { return data; }
+
+    void push(float x, float y);
+    void pop();
+    void set(size_t i, float x, float y);
+    void resize(size_t size);
+    void assign(const PointSet& other);
+    void clear() { count = 0; }
+
+    // applies m to every point, with the pool above parallelThreshold
+    void transform(const Affine2& m, ThreadPool* pool = nullptr, PointKernel kernel = bestKernel());
+
+    // widest kernel supported by the processor
+    static PointKernel bestKernel();
+    static const char* kernelName(PointKernel kernel);
+
+private:
+    float* data{};
+    size_t count{};
+    size_t allocated{};
+
+    void reserve(size_t size);
+};
+
+#endif
\ No newline at end of file
@@ -2,35 +2,71 @@
 #define _ShaderProgram_h_
 
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 class ShaderProgram {
 public:
-    GLuint ID;
+    GLuint ID{};
 
-    ShaderProgram(const char* vertexPath, const char* fragmentPath);
+    // vertexFunctions is compiled as a second source string of the vertex shader, after the file,
+    // so the file can declare a prototype and call a function that is generated at runtime
+    ShaderProgram(const char* vertexPath, const char* fragmentPath, const std::string& vertexFunctions = std::string());
+    ~ShaderProgram();
+
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // deletes the program, has to run while the context is alive
+    void release();
 
     // activate the shader
-    void use();
-    // utility uniform functions
-    void setBool(const std::string& name, bool value) const;
-    void setInt(const std::string& name, int value) const;
-    void setFloat(const std::string& name, float value) const;
-
-    void setVec2(const std::string& name, glm::vec2& value) const;
-    void setVec2(const std::string& name, float x, float y) const;
-    void setVec3(const std::string& name, glm::vec3& value) const;
-    void setVec3(const std::string& name, float x, float y, float z) const;
-    void setVec4(const std::string& name, glm::vec4& value) const;
-    void setVec4(const std::string& name, float x, float y, float z, float w) const;
-
-    void setMat2(const std::string& name, const glm::mat2& mat) const;
-    void setMat3(const std::string& name, const glm::mat3& mat) const;
-    void setMat4(const std::string& name, const glm::mat4& mat) const;
+    void use() const;
+    // location of an active uniform, resolved once at link time (-1 if there is no such uniform);
+    // meant to be called outside of the render loop, the result is passed to the setters below
+    GLint location(std::string_view name) const;
+
+    // utility uniform functions; they write to this program whether it is in use or not
+    void setBool(GLint location, bool value) const;
+    void setInt(GLint location, int value) const;
+    void setFloat(GLint location, float value) const;
+
+    void setVec2(GLint location, const glm::vec2& value) const;
+    void setVec2(GLint location, float x, float y) const;
+    void setVec3(GLint location, const glm::vec3& value) const;
+    void setVec3(GLint location, float x, float y, float z) const;
+    void setVec4(GLint location, const glm::vec4& value) const;
+    void setVec4(GLint location, float x, float y, float z, float w) const;
+
+    void setMat2(GLint location, const glm::mat2& mat) const;
+    void setMat3(GLint location, const glm::mat3& mat) const;
+    void setMat4(GLint location, const glm::mat4& mat) const;
+
+    // same as above with a lookup in the location cache
+    void setBool(std::string_view name, bool value) const { setBool(location(name), value); }
+    void setInt(std::string_view name, int value) const { setInt(location(name), value); }
+    void setFloat(std::string_view name, float value) const { setFloat(location(name), value); }
+
+    void setVec2(std::string_view name, const glm::vec2& value) const { setVec2(location(name), value); }
+    void setVec2(std::string_view name, float x, float y) const { setVec2(location(name), x, y); }
+    void setVec3(std::string_view name, const glm::vec3& value) const { setVec3(location(name), value); }
+    void setVec3(std::string_view name, float x, float y, float z) const { setVec3(location(name), x, y, z); }
+    void setVec4(std::string_view name, const glm::vec4& value) const { setVec4(location(name), value); }
+    void setVec4(std::string_view name, float x, float y, float z, float w) const { setVec4(location(name), x, y, z, w); }
+
+    void setMat2(std::string_view name, const glm::mat2& mat) const { setMat2(location(name), mat); }
+    void setMat3(std::string_view name, const glm::mat3& mat) const { setMat3(location(name), mat); }
+    void setMat4(std::string_view name, const glm::mat4& mat) const { setMat4(location(name), mat); }
 
 private:
+    // active uniforms sorted by name
+    std::vector<std::pair<std::string, GLint>> uniforms;
+
     void checkCompileErrors(GLuint shader, std::string type);
+    void cacheUniforms();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef _StreamBuffer_h_
+#define _StreamBuffer_h_
+
+#include <initializer_list>
+#include <glad/glad.h>
+
+#include "GLObjects.h"
+
+// persistently mapped ring buffer for geometry that changes every frame;
+// each in-flight frame owns its own region which is guarded by a fence
+class StreamBuffer {
+public:
+    Buffer VBO;
+    VertexArray VAO;
+
+    StreamBuffer() = default;
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // attributes - number of float components of every vertex attribute (location 0, 1, ...)
+    void init(GLsizeiptr frameSize, std::initializer_list<GLint> attributes, int frameCount = 3);
+    void release();
+
+    // waits until the gpu has finished reading the region of the current frame
+    void beginFrame();
+    // fences the region of the current frame and moves to the next one
+    void endFrame();
+
+    // copies count vertices into the current region and returns the index of the first one
+    // (for glDrawArrays with VAO, e.g. from a render queue); -1 if the region is full, the next
+    // beginFrame() then grows the ring to what this frame asked for
+    GLint push(const void* data, GLsizei count);
+    // as push() and draws the vertices at once; vertices that do not fit are drawn from a
+    // separate buffer, so nothing is lost in the frame that overflows
+    void draw(const void* data, GLenum mode, GLsizei count);
+
+    GLsizeiptr capacity() const { return frameSize; }
+    GLsizeiptr highWaterMark() const { return highWater; }
+    unsigned int reallocations() const { return growCount; }
+
+private:
+    static const int maxFrames = 4;
+
+    GLsizei stride{};
+    Buffer spill; // draw() calls that do not fit into the region
+
+    char* mapped{};
+    GLsync fences[maxFrames]{};
+    int frameCount{};
+    int frame{};
+    GLsizeiptr frameSize{};
+    GLsizeiptr offset{};
+    GLsizeiptr requested{}; // bytes pushed in this frame, including those that did not fit
+    GLsizeiptr highWater{};
+    unsigned int growCount{};
+
+    void allocate(GLsizeiptr size);
+    void waitFence(int index);
+};
+
+#endif
\ No newline at end of file
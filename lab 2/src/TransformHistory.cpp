@@ -0,0 +1,30 @@
+#include "TransformHistory.h"
+
+const Affine2 TransformHistory::identity{};
+
+void TransformHistory::push(const Affine2& step) {
+    steps.resize(applied);
+    composites.resize(applied);
+
+    composites.push_back(step * current());
+    steps.push_back(step);
+    applied++;
+}
+
+bool TransformHistory::undo() {
+    if (!canUndo()) { return false; }
+    applied--;
+    return true;
+}
+
+bool TransformHistory::redo() {
+    if (!canRedo()) { return false; }
+    applied++;
+    return true;
+}
+
+void TransformHistory::clear() {
+    steps.clear();
+    composites.clear();
+    applied = 0;
+}
\ No newline at end of file
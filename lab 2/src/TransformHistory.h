@@ -0,0 +1,35 @@
+#ifndef _TransformHistory_h_
+#define _TransformHistory_h_
+
+#include <cstddef>
+#include <vector>
+
+#include "PointSet.h"
+
+// list of applied transforms with the composite of every prefix, so undo and redo
+// only move a cursor and the current composite is one lookup
+class TransformHistory {
+public:
+    // drops everything that could be redone
+    void push(const Affine2& step);
+    bool undo();
+    bool redo();
+    void clear();
+
+    bool canUndo() const { return applied > 0; }
+    bool canRedo() const { return applied < steps.size(); }
+    size_t position() const { return applied; }
+    size_t size() const { return steps.size(); }
+
+    // all applied steps in order
+    const Affine2& current() const { return applied ? composites[applied - 1] : identity; }
+
+private:
+    static const Affine2 identity;
+
+    std::vector<Affine2> steps;
+    std::vector<Affine2> composites; // composites[i] = steps[i] * ... * steps[0]
+    size_t applied{};
+};
+
+#endif
\ No newline at end of file
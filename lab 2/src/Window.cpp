@@ -1,6 +1,11 @@
 #include "Window.h"
+#include "GLState.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <glm/gtc/matrix_transform.hpp>
 #include <imgui/backends/imgui_impl_glfw.h>
 #include <imgui/backends/imgui_impl_opengl3.h>
@@ -34,6 +39,9 @@ Window::Window(GLsizei _width, GLsizei _height, const std::string& _title) {
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    stream.init(256 * 1024, { 2 });
+    initPoints();
+
     std::cout << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
     std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
     std::cout << "Resolution: " << width << "x" << height << std::endl;
@@ -70,6 +78,13 @@ void Window::renderBackgroundColor() {
     glClear(GL_COLOR_BUFFER_BIT);
 }
 
+glm::vec4 Window::visibleArea() const {
+    // the camera looks along -z at the plane z = 0 with the same field of view as the projection in main
+    float halfHeight = camera.pos.z * tan(glm::radians(camera.worldScale * 45.0f) / 2.0f);
+    float halfWidth  = halfHeight * static_cast<float>(width) / static_cast<float>(height);
+    return glm::vec4(camera.pos.x - halfWidth, camera.pos.y - halfHeight, camera.pos.x + halfWidth, camera.pos.y + halfHeight);
+}
+
 std::vector<GLfloat> Window::pointVertex(float x, float y) {
     std::vector<GLfloat> vertex;
 
@@ -83,80 +98,271 @@ std::vector<GLfloat> Window::pointVertex(float x, float y) {
     return vertex;
 }
 
-void Window::render(GLsizeiptr size, const void* data, GLenum mode, GLsizei count) {
-    GLuint VBO, VAO;
-    glGenBuffers(1, &VBO);
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-    glDrawArrays(mode, 0, count);
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+void Window::render(const void* data, GLenum mode, GLsizei count) {
+    stream.draw(data, mode, count);
 }
 
-void Window::translate() {
-    for (size_t i = 0, j = 0; i < points.size(); i++, j += 2) {
-        points.at(i) = pointVertex(pointArray.at(j) + vectorVertex[0], pointArray.at(j + 1) + vectorVertex[1]);
+void Window::initPoints() {
+    // the circle is built around (0, 0), the vertex shader moves it to the center of the point
+    std::vector<GLfloat> disc = pointVertex(0.0f, 0.0f);
+    discCount = static_cast<GLsizei>(disc.size() / 2);
+    discVBO.storage(sizeof(GLfloat) * disc.size(), disc.data());
+
+    // binding 0 is the disc, bindings 1 and 2 are the x and y blocks of the centers (locations 1
+    // and 2), attached by uploadCenters
+    pointVAO.create();
+    pointVAO.vertexBuffer(0, discVBO, 0, 2 * sizeof(GLfloat));
+    pointVAO.attribute(0, 0, 2, GL_FLOAT, GL_FALSE, 0);
+    pointVAO.attribute(1, 1, 1, GL_FLOAT, GL_FALSE, 0);
+    pointVAO.attribute(2, 2, 1, GL_FLOAT, GL_FALSE, 0);
+    pointVAO.divisor(1, 1);
+    pointVAO.divisor(2, 1);
+
+    // the same centers are the vertices of the polygon, the disabled location 0 reads as (0, 0)
+    polygonVAO.create();
+    polygonVAO.attribute(1, 1, 1, GL_FLOAT, GL_FALSE, 0);
+    polygonVAO.attribute(2, 2, 1, GL_FLOAT, GL_FALSE, 0);
+
+    // the same disc for the points that passed culling
+    visibleVAO.create();
+    visibleVAO.vertexBuffer(0, discVBO, 0, 2 * sizeof(GLfloat));
+    visibleVAO.attribute(0, 0, 2, GL_FLOAT, GL_FALSE, 0);
+    visibleVAO.attribute(1, 1, 1, GL_FLOAT, GL_FALSE, 0);
+    visibleVAO.attribute(2, 2, 1, GL_FLOAT, GL_FALSE, 0);
+    visibleVAO.divisor(1, 1);
+    visibleVAO.divisor(2, 1);
+}
 
-        pointArray.at(j)     += vectorVertex[0];
-        pointArray.at(j + 1) += vectorVertex[1];
+void Window::releasePoints() {
+    discVBO.release();
+    pointVBO.release();
+    pointVAO.release();
+    polygonVAO.release();
+    visibleVBO.release();
+    visibleVAO.release();
+    pointCapacity = 0;
+    visibleCapacity = 0;
+}
+
+void Window::uploadCenters(Buffer& VBO, const PointSet& centers, size_t& capacity, std::initializer_list<const VertexArray*> VAOs) {
+    if (centers.capacity() != capacity) {
+        // the y block starts at the capacity, so its binding point moves with it
+        capacity = centers.capacity();
+        VBO.allocate(2 * sizeof(GLfloat) * capacity, nullptr, GL_DYNAMIC_DRAW);
+        for (const VertexArray* VAO : VAOs) {
+            VAO->vertexBuffer(1, VBO, 0, sizeof(GLfloat));
+            VAO->vertexBuffer(2, VBO, sizeof(GLfloat) * capacity, sizeof(GLfloat));
+        }
     }
+    // x block with the unused tail + used part of the y block in one update
+    VBO.update(0, sizeof(GLfloat) * (capacity + centers.size()), centers.storage());
 }
 
-void Window::scale(float scale) {
-    glm::vec2 normalizedVector(glm::normalize(glm::vec2(vectorVertex[0], vectorVertex[1])));
-    glm::mat2 transformationMatrix = {
-        scale * normalizedVector.x, 0.0f,
-        0.0f, scale * normalizedVector.y
-    };
+void Window::uploadPoints() {
+    if (!pointsChanged) { return; }
+    pointsChanged = false;
 
-    for (size_t i = 0, j = 0; i < points.size(); i++, j += 2) {
-        glm::vec2 vector(pointArray.at(j), pointArray.at(j + 1));
-        glm::vec2 result = transformationMatrix * vector;
+    if (points.empty()) { return; }
+    uploadCenters(pointVBO, points, pointCapacity, { &pointVAO, &polygonVAO });
+}
 
-        points.at(i) = pointVertex(result.x, result.y);
+void Window::cullPoints(const glm::vec4& area) {
+    if (!culling || points.size() < cullThreshold) {
+        drawCulled = false;
+        visibleCount = points.size();
+        return;
+    }
+    if (cullValid && area == culledArea) { return; }
+
+    // discs whose center is just outside the screen are still partly visible
+    const float radius = 0.025f;
+    const glm::vec4 grown(area.x - radius, area.y - radius, area.z + radius, area.w + radius);
+    glm::vec4 stored;
+    if (!storedArea(grown, stored)) {
+        // everything lies on a line, no culling until the history changes
+        drawCulled = false;
+        visibleCount = points.size();
+        return;
+    }
+    indexedPoints().query(points, stored.x, stored.y, stored.z, stored.w, visibleIndices);
+    if (history.position() > 0) {
+        // the box around a rotated area holds more than it, only the points that land inside are kept
+        const Affine2& m = history.current();
+        size_t kept = 0;
+        for (uint32_t i : visibleIndices) {
+            float x = m.x(points.x(i), points.y(i));
+            float y = m.y(points.x(i), points.y(i));
+            if (x >= grown.x && x <= grown.z && y >= grown.y && y <= grown.w) {
+                visibleIndices[kept++] = i;
+            }
+        }
+        visibleIndices.resize(kept);
+    }
 
-        pointArray.at(j)     = result.x;
-        pointArray.at(j + 1) = result.y;
+    visiblePoints.resize(visibleIndices.size());
+    for (size_t i = 0; i < visibleIndices.size(); i++) {
+        visiblePoints.set(i, points.x(visibleIndices[i]), points.y(visibleIndices[i]));
     }
+    if (!visiblePoints.empty()) {
+        uploadCenters(visibleVBO, visiblePoints, visibleCapacity, { &visibleVAO });
+    }
+
+    culledArea = area;
+    cullValid = true;
+    drawCulled = true;
+    visibleCount = visiblePoints.size();
 }
 
-void Window::reflection(float(&point)[2]) {
-    glm::mat2 reflectionMatrix(-1.0f);
+void Window::renderPoints() {
+    (drawCulled ? visibleVAO : pointVAO).bind();
+    glState.drawArraysInstanced(GL_TRIANGLE_FAN, 0, discCount, static_cast<GLsizei>(drawCulled ? visiblePoints.size() : points.size()));
+}
 
-    for (size_t i = 0, j = 0; i < points.size(); i++, j += 2) {
-        if (pointArray.at(j) != point[0] && pointArray.at(j + 1) != point[1]) {
-            glm::vec2 vector(pointArray.at(j) - point[0], pointArray.at(j + 1) - point[1]);
-            glm::vec2 result = reflectionMatrix * vector;
+void Window::renderPolygon() {
+    polygonVAO.bind();
+    glState.drawArrays(GL_LINE_LOOP, 0, static_cast<GLsizei>(points.size()));
+}
 
-            points.at(i) = pointVertex(result.x + point[0], result.y + point[1]);
+const PointGrid& Window::indexedPoints() {
+    if (!pointGrid.valid()) {
+        pointGrid.build(points, &pool);
+    }
+    return pointGrid;
+}
 
-            pointArray.at(j) = result.x + point[0];
-            pointArray.at(j + 1) = result.y + point[1];
-        }
+bool Window::storedArea(const glm::vec4& area, glm::vec4& stored) const {
+    const Affine2& m = history.current();
+    if (std::abs(m.determinant()) < 1e-12f) { return false; }
+
+    Affine2 inverse = m.inverse();
+    const float corners[4][2] = { { area.x, area.y }, { area.z, area.y }, { area.x, area.w }, { area.z, area.w } };
+    stored = glm::vec4(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+        -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max());
+    for (const auto& corner : corners) {
+        float x = inverse.x(corner[0], corner[1]);
+        float y = inverse.y(corner[0], corner[1]);
+        stored = glm::vec4(std::min(stored.x, x), std::min(stored.y, y), std::max(stored.z, x), std::max(stored.w, y));
     }
+    return true;
 }
 
-void Window::rotation(float(&point)[2], float angle) {
-    glm::mat2 rotationMatrix = {
-        cos(glm::radians(angle)), -sin(glm::radians(angle)),
-        sin(glm::radians(angle)),  cos(glm::radians(angle))
-    };
+long long Window::nearestPoint(float x, float y, float maxDistance) {
+    if (history.position() == 0) {
+        return indexedPoints().nearest(points, x, y, maxDistance);
+    }
 
-    for (size_t i = 0, j = 0; i < points.size(); i++, j += 2) {
-        if (pointArray.at(j) != point[0] && pointArray.at(j + 1) != point[1]) {
-            glm::vec2 vector(pointArray.at(j) - point[0], pointArray.at(j + 1) - point[1]);
-            glm::vec2 result = rotationMatrix * vector;
+    // candidates from the box around the pick square, the distance is measured on the plane
+    const Affine2& m = history.current();
+    long long best = -1;
+    float bestSquared = maxDistance * maxDistance;
+    auto test = [&](size_t i) {
+        float dx = m.x(points.x(i), points.y(i)) - x;
+        float dy = m.y(points.x(i), points.y(i)) - y;
+        float squared = dx * dx + dy * dy;
+        if (squared <= bestSquared) {
+            bestSquared = squared;
+            best = static_cast<long long>(i);
+        }
+    };
 
-            points.at(i) = pointVertex(result.x + point[0], result.y + point[1]);
-            
-            pointArray.at(j)     = result.x + point[0];
-            pointArray.at(j + 1) = result.y + point[1];
+    glm::vec4 stored;
+    if (storedArea(glm::vec4(x - maxDistance, y - maxDistance, x + maxDistance, y + maxDistance), stored)) {
+        indexedPoints().query(points, stored.x, stored.y, stored.z, stored.w, pickCandidates);
+        for (uint32_t i : pickCandidates) {
+            test(i);
         }
     }
+    else {
+        // a degenerate history maps whole lines to one point, only a scan finds them
+        for (size_t i = 0; i < points.size(); i++) {
+            test(i);
+        }
+    }
+    return best;
+}
+
+void Window::pointsMoved() {
+    cullValid = false;
+}
+
+glm::mat3 Window::transform() const {
+    const Affine2& m = history.current();
+    return glm::mat3(
+        m.xx, m.yx, 0.0f,
+        m.xy, m.yy, 0.0f,
+        m.tx, m.ty, 1.0f
+    );
+}
+
+void Window::addPoint(float x, float y) {
+    const Affine2& m = history.current();
+    if (std::abs(m.determinant()) < 1e-12f) {
+        // a degenerate scale can not be undone for a new point, so the history is applied first
+        bake();
+    }
+    Affine2 inverse = history.current().inverse();
+    points.push(inverse.xx * x + inverse.xy * y + inverse.tx, inverse.yx * x + inverse.yy * y + inverse.ty);
+    pointsChanged = true;
+
+    if (pointGrid.valid()) {
+        pointGrid.insert(points.size() - 1);
+    }
+    cullValid = false;
+}
+
+void Window::removePoint() {
+    if (points.empty()) { return; }
+
+    points.pop();
+    pointsChanged = true;
+
+    pointGrid.removeLast(points.size());
+    cullValid = false;
+}
+
+void Window::bake() {
+    if (history.position() > 0) {
+        // the stored points move, so the index has to be built again
+        points.transform(history.current(), &pool);
+        pointsChanged = true;
+        pointGrid.invalidate();
+        cullValid = false;
+    }
+    history.clear();
+}
+
+void Window::undo() {
+    if (history.undo()) {
+        pointsMoved();
+    }
+}
+
+void Window::redo() {
+    if (history.redo()) {
+        pointsMoved();
+    }
+}
+
+void Window::translate() {
+    history.push(Affine2::translation(vectorVertex[0], vectorVertex[1]));
+    pointsMoved();
+}
+
+void Window::scale(float scale) {
+    glm::vec2 normalizedVector(glm::normalize(glm::vec2(vectorVertex[0], vectorVertex[1])));
+    history.push(Affine2::scaling(scale * normalizedVector.x, scale * normalizedVector.y));
+    pointsMoved();
+}
+
+void Window::reflection(float(&point)[2]) {
+    history.push(Affine2::pointReflection(point[0], point[1]));
+    pointsMoved();
+}
+
+void Window::rotation(float(&point)[2], float angle) {
+    // clockwise for a positive angle
+    history.push(Affine2::rotation(point[0], point[1], -glm::radians(angle)));
+    pointsMoved();
 }
 
 void Window::frameBuffersizeCallback(int width, int height) {
@@ -190,30 +396,28 @@ void Window::mouseButtonCallback(int button, int action, int mods) {
         camera.cursor.x = ((xpos / width) * 2.0f - 1.0f)  * 10.0f * camera.worldScale * (static_cast<float>(width) / static_cast<float>(height)) + camera.pos.x;
         camera.cursor.y = (1.0f - (ypos / height) * 2.0f) * 10.0f * camera.worldScale + camera.pos.y;
         if (pointMode) {
-            pointArray.push_back(camera.cursor.x);
-            pointArray.push_back(camera.cursor.y);
-            points.push_back(pointVertex(camera.cursor.x, camera.cursor.y));
+            addPoint(camera.cursor.x, camera.cursor.y);
         }
         else if (vectorMode) {
             vectorVertex = pointVertex(camera.cursor.x, camera.cursor.y);
         }
         else {
-            for (size_t i = 0; i < pointArray.size(); i += 2) {
-                if (camera.cursor.x - 0.075f < pointArray.at(i)     && camera.cursor.x + 0.075f > pointArray.at(i) &&
-                    camera.cursor.y - 0.075f < pointArray.at(i + 1) && camera.cursor.y + 0.075f > pointArray.at(i + 1)) {
-                    selectedPoint[0] = pointArray.at(i);
-                    selectedPoint[1] = pointArray.at(i + 1);
-                    break;
-                }
+            // nearest point within the pick radius
+            indexedPoints();
+            auto start = std::chrono::steady_clock::now();
+            long long nearest = nearestPoint(camera.cursor.x, camera.cursor.y, 0.075f);
+            pickTime = std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (nearest >= 0) {
+                const Affine2& m = history.current();
+                selectedPoint[0] = m.x(points.x(nearest), points.y(nearest));
+                selectedPoint[1] = m.y(points.x(nearest), points.y(nearest));
             }
         }
 
     }
-    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_RELEASE && pointArray.size() > 0) {
+    if (button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_RELEASE && !points.empty()) {
         if (pointMode) {
-            pointArray.pop_back();
-            pointArray.pop_back();
-            points.pop_back();
+            removePoint();
         }
     }
 }
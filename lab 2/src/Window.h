@@ -1,6 +1,7 @@
 #ifndef _Window_h_
 #define _Window_h_
 
+#include <initializer_list>
 #include <string>
 #include <vector>
 #include <functional>
@@ -8,6 +9,13 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "GLObjects.h"
+#include "PointGrid.h"
+#include "PointSet.h"
+#include "StreamBuffer.h"
+#include "ThreadPool.h"
+#include "TransformHistory.h"
+
 struct Camera {
     glm::vec3 pos   { 0.0f, 0.0f, 24.2f };
     glm::vec3 front { 0.0f, 0.0f, -1.0f };
@@ -35,19 +43,71 @@ public:
 
     bool pointMode{ true };
     bool vectorMode{ false };
-    std::vector<GLfloat> pointArray{}; // array points (x, y)
-    std::vector<std::vector<GLfloat>> points{}; // array for drawing points
+    // points are kept as they were before the transforms of the history, the vertex shader applies
+    // the composite; positions on the plane are computed only for the few points that need them
+    PointSet points{};
+    bool pointsChanged{ false }; // points have to be uploaded to pointVBO
+    TransformHistory history{};
+    // spatial index over the stored points for picking and culling; the history does not move them,
+    // so the queries map the screen area and the cursor back through its inverse instead
+    PointGrid pointGrid{};
+    bool culling{ true };
+    size_t visibleCount{}; // points drawn in the last frame
+    float pickTime{};      // nanoseconds of the last picking query
     std::vector<GLfloat> vectorVertex{}; // array for drawing vector point (vectorVertex[0] and vectorVertex[1] - center of point)
     GLfloat selectedPoint[2]{ 0.0f, 0.0f };
 
+    StreamBuffer stream{}; // transient geometry (x, y) that is rebuilt every frame
+    ThreadPool pool{}; // workers for transforms of many points and other data-parallel loops
+
+    // one circle mesh shared by all points + centers of points as per-instance data;
+    // pointVBO mirrors the layout of points: all x coordinates, then all y coordinates
+    Buffer discVBO, pointVBO;
+    VertexArray pointVAO, polygonVAO;
+    GLsizei discCount{};
+    size_t pointCapacity{};
+    // points inside the visible area (as stored, the history is applied by the shader)
+    Buffer visibleVBO;
+    VertexArray visibleVAO;
+    size_t visibleCapacity{};
+    PointSet visiblePoints{};
+    std::vector<uint32_t> visibleIndices{};
+    std::vector<uint32_t> pickCandidates{};
+    glm::vec4 culledArea{};
+    bool cullValid{ false };
+    bool drawCulled{ false };
+
     Window(GLsizei _width, GLsizei _height, const std::string& title);
 
     void timing();
     void keyCallback(GLFWwindow* window);
     void renderBackgroundColor();
+    // part of the plane z = 0 that is on the screen: (xMin, yMin, xMax, yMax)
+    glm::vec4 visibleArea() const;
     void drawPoint(float x, float y) {}
     std::vector<GLfloat> pointVertex(float x, float y);
-    void render(GLsizeiptr size, const void* data, GLenum mode, GLsizei count);
+    void render(const void* data, GLenum mode, GLsizei count);
+    void initPoints();
+    void releasePoints();
+    void uploadPoints();
+    // below this number of points everything is drawn without asking the index
+    static const size_t cullThreshold = 16 * 1024;
+    // selects the points in area (xMin, yMin, xMax, yMax) for renderPoints
+    void cullPoints(const glm::vec4& area);
+    void renderPoints();
+    void renderPolygon();
+    const PointGrid& indexedPoints();
+    // index of the point nearest to (x, y) on the plane within maxDistance, -1 if there is none
+    long long nearestPoint(float x, float y, float maxDistance);
+    // composite of the history for the point shader
+    glm::mat3 transform() const;
+    // adds a point given on the plane
+    void addPoint(float x, float y);
+    void removePoint();
+    // applies the history to the stored points and clears it
+    void bake();
+    void undo();
+    void redo();
     void translate();
     void scale(float scale);
     void reflection(float(&point)[2]);
@@ -60,6 +120,14 @@ public:
     static void staticFrameBuffersizeCallback(GLFWwindow* window, int width, int height);
     static void staticScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
     static void staticMouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+
+private:
+    void uploadCenters(Buffer& VBO, const PointSet& centers, size_t& capacity, std::initializer_list<const VertexArray*> VAOs);
+    // bounding box (xMin, yMin, xMax, yMax) of the stored points that the history moves into area;
+    // false if the history is degenerate and has no inverse
+    bool storedArea(const glm::vec4& area, glm::vec4& stored) const;
+    // positions on the plane changed, the culled set is dropped
+    void pointsMoved();
 };
 
 #endif
\ No newline at end of file
@@ -13,7 +13,13 @@
 #include <imgui/backends/imgui_impl_opengl3.h>
 
 #include "ShaderProgram.h"
+#include "CameraBuffer.h"
+#include "GLObjects.h"
+#include "GLState.h"
 #include "DrawFuntions.h"
+#include "FunctionPlot.h"
+#include "GpuPlot.h"
+#include "ThreadPool.h"
 #include "Window.h"
 
 int main() {
@@ -37,17 +43,55 @@ int main() {
 
     // shaders
     ShaderProgram pen("resources\\shader.vs", "resources\\shader.fs");
-    pen.use();
+    const GLint penColor = pen.location("color");
     drawCartesian();
+    initGraph();
+
+    ShaderProgram gridShader("resources\\grid.vs", "resources\\grid.fs");
+
+    ShaderProgram pointShader("resources\\point.vs", "resources\\shader.fs");
+    const GLint pointShaderColor = pointShader.location("color");
+    const GLint pointShaderTransform = pointShader.location("transform");
 
     ShaderProgram text("resources\\text.vs", "resources\\text.fs");
-    text.use();
+    text.setVec3("textColor", 0.0f, 0.0f, 0.0f);
     initFreeType();
 
+    // the same expression evaluated in the vertex shader
+    GpuPlot gpuPlot;
+    gpuPlot.init("resources\\plot.vs", "resources\\shader.fs");
+    gpuPlot.color = glm::vec3(0.0f, 0.35f, 0.9f);
+    gpuPlot.build(expression);
+
+    // projection and view for all programs
+    CameraBuffer cameraBuffer;
+    cameraBuffer.init();
+
     std::stringstream ss;
     float scaleFactor = 0.0f;
     float angle = 0.0f;
     float pointColor[] = { 0.1f, 0.69f, 0.28f };
+    bool showGraph = false;
+    bool gpuGraph = false;
+    char expressionText[256] = "cos(x)";
+    std::string expressionError;
+    float nativeTime = 0.0f;
+    float expressionTime = 0.0f;
+
+    // many densely sampled curves re-evaluated every frame
+    ThreadPool& pool = Window1.pool;
+    std::vector<FunctionPlot> plots;
+    float curvePhase = 0.0f;
+    int curveCount = 0;
+    int curveSamples = 100000;
+    bool animateCurves = true;
+    float curveTime = 0.0f;
+
+    // affine kernels over big point sets
+    int benchmarkSize = 0;
+    float benchmarkTimes[3][2]{}; // kernel x (one thread, pool)
+    float uploadTime = 0.0f;
+    std::string frameStatsExport;
 
     //glPolygonMode(GL_FRONT_AND_BACK , GL_LINE);
 
@@ -55,6 +99,8 @@ int main() {
     while (!glfwWindowShouldClose(Window1.window)) {
         // per-frame time logic
         Window1.timing();
+        glState.beginFrame();
+        Window1.stream.beginFrame();
 
         // input
         Window1.keyCallback(Window1.window);
@@ -65,38 +111,87 @@ int main() {
         glm::mat4 projection = glm::perspective(glm::radians(Window1.camera.worldScale * 45.0f), static_cast<float>(Window1.width) / static_cast<float>(Window1.height), 0.1f, 100.0f);
         glm::mat4 view       = glm::lookAt(Window1.camera.pos, Window1.camera.pos + Window1.camera.front, Window1.camera.up);
 
+        cameraBuffer.update(projection, view);
+
+        gridShader.use();
+        drawGrid();
+
         pen.use();
-        pen.setMat4("projection", projection);
-        pen.setMat4("view", view);
-        pen.setVec3("color", 0.6f, 0.6f, 0.6f);
-        drawArray(grid);
+        pen.setVec3(penColor, 0.0f, 0.0f, 0.0f);
+        drawHelpers();
 
-        pen.setVec3("color", 0.0f, 0.0f, 0.0f);
-        drawArray(axes);
-        drawArray(arrowOx);
-        drawArray(arrowOy);
+        if (showGraph && gpuGraph) {
+            glm::vec4 area = Window1.visibleArea();
+            gpuPlot.draw(area.x, area.z, 4 * Window1.width, expression.parameters);
+            pen.use();
+        }
+        else if (showGraph) {
+            glm::vec4 area = Window1.visibleArea();
+            updateGraph(area.x, area.z, (area.w - area.y) / Window1.height);
+            pen.setVec3(penColor, 0.0f, 0.35f, 0.9f);
+            drawGraph();
+        }
 
-        // polygon
-        pen.setVec3("color", glm::vec3(0.4f));
-        for (const auto& i : Window1.points) {
-            Window1.render(sizeof(GLfloat) * Window1.pointArray.size(), Window1.pointArray.data(), GL_LINE_LOOP, Window1.points.size());
+        if (static_cast<int>(plots.size()) != curveCount) {
+            plots.resize(curveCount);
+            for (int i = 0; i < curveCount; i++) {
+                if (plots[i].VAO) { continue; }
+                plots[i].init(curveSamples);
+                plots[i].color = glm::vec3(0.9f * i / curveCount, 0.3f, 0.9f * (curveCount - i) / curveCount);
+                plots[i].function = [i, &curvePhase](const float* x, float* y, size_t n) {
+                    alignas(32) float shifted[Expression::blockSize];
+                    for (size_t first = 0; first < n; first += Expression::blockSize) {
+                        size_t count = std::min(n - first, Expression::blockSize);
+                        for (size_t j = 0; j < count; j++) {
+                            shifted[j] = x[first + j] + curvePhase;
+                        }
+                        expression.evaluate(shifted, y + first, count);
+                        for (size_t j = 0; j < count; j++) {
+                            y[first + j] += 0.1f * i;
+                        }
+                    }
+                };
+            }
         }
-        // points
-        pen.setVec3("color", pointColor[0], pointColor[1], pointColor[2]);
-        for (size_t i = 0; i < Window1.points.size(); i++) {
-            Window1.render(sizeof(GLfloat) * Window1.points.at(i).size(), Window1.points.at(i).data(), GL_TRIANGLE_FAN, Window1.points.at(i).size() / 2);
+        if (!plots.empty()) {
+            if (animateCurves) {
+                curvePhase += Window1.deltaTime;
+            }
+            glm::vec4 area = Window1.visibleArea();
+            auto start = std::chrono::steady_clock::now();
+            for (FunctionPlot& plot : plots) {
+                plot.evaluate(area.x, area.z, curveSamples, pool);
+            }
+            curveTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            for (FunctionPlot& plot : plots) {
+                pen.setVec3(penColor, plot.color);
+                plot.draw();
+            }
         }
 
+        Window1.uploadPoints();
+
+        // polygon
+        pointShader.use();
+        pointShader.setMat3(pointShaderTransform, Window1.transform());
+        pointShader.setVec3(pointShaderColor, 0.4f, 0.4f, 0.4f);
+        Window1.renderPolygon();
+        // points
+        pointShader.setVec3(pointShaderColor, pointColor[0], pointColor[1], pointColor[2]);
+        Window1.cullPoints(Window1.visibleArea());
+        Window1.renderPoints();
+
         // point P and line
         if (Window1.vectorVertex.size() > 0) {
-            pen.setVec3("color", 1.0f, 0.0f, 0.77f);
-            Window1.render(sizeof(GLfloat) * Window1.vectorVertex.size(), Window1.vectorVertex.data(), GL_TRIANGLE_FAN, Window1.vectorVertex.size() / 2);
+            pen.use();
+            pen.setVec3(penColor, 1.0f, 0.0f, 0.77f);
+            Window1.render(Window1.vectorVertex.data(), GL_TRIANGLE_FAN, Window1.vectorVertex.size() / 2);
 
             GLfloat line[4] = { 0.0f, 0.0f, Window1.vectorVertex.at(0), Window1.vectorVertex.at(1) };
-            Window1.render(sizeof(line), line, GL_LINES, 2);
+            Window1.render(line, GL_LINES, 2);
         }
 
-        renderAllText(text, projection, view);
+        renderAllText(text);
         /*        */
 
         /* Interface */
@@ -108,6 +203,75 @@ int main() {
         ImGui::ColorEdit3("Background Color", Window1.backgroundColor);
         ImGui::ColorEdit3("Point Color", pointColor);
         ImGui::SliderFloat("World Scale", &Window1.camera.worldScale, 0.001f, 1.4f);
+        ImGui::Checkbox("Graph f(x)", &showGraph);
+        ImGui::SameLine();
+        ImGui::Checkbox("On GPU", &gpuGraph);
+        if (showGraph && !gpuGraph) {
+            ImGui::SameLine();
+            ss.str(std::string());
+            ss << graph.count << " vertices, " << graphSampler.evaluations << " evaluations";
+            ImGui::Text(ss.str().c_str());
+        }
+        if (ImGui::CollapsingHeader("Function")) {
+            bool changed = false;
+            bool parameterChanged = false;
+            if (ImGui::InputText("f(x)", expressionText, sizeof(expressionText), ImGuiInputTextFlags_EnterReturnsTrue)) {
+                changed = expression.compile(expressionText, expressionError);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Compile")) {
+                changed = expression.compile(expressionText, expressionError);
+            }
+            if (!expressionError.empty()) {
+                ImGui::TextColored(ImVec4(0.9f, 0.2f, 0.2f, 1.0f), expressionError.c_str());
+            }
+            const char* names[Expression::parameterCount] = { "a", "b", "c", "d" };
+            for (int i = 0; i < Expression::parameterCount; i++) {
+                if (ImGui::SliderFloat(names[i], &expression.parameters[i], -10.0f, 10.0f)) {
+                    expression.updateParameters();
+                    parameterChanged = true;
+                }
+            }
+            if (changed || parameterChanged) {
+                graphSampler.reset();
+                graph.area = glm::vec3(0.0f);
+            }
+            if (changed && !gpuPlot.build(expression)) {
+                expressionError = "the shader of the expression failed to compile";
+            }
+
+            ss.str(std::string());
+            ss << expression.instructionCount() << " instructions";
+            ImGui::Text(ss.str().c_str());
+
+            // one million samples on one thread: the compiled f against the bytecode
+            if (ImGui::Button("Benchmark")) {
+                const size_t samples = 1000000;
+                std::vector<float> x(samples), y(samples);
+                for (size_t i = 0; i < samples; i++) {
+                    x[i] = -10.0f + 20.0f * i / samples;
+                }
+                auto start = std::chrono::steady_clock::now();
+                batched(f)(x.data(), y.data(), samples);
+                auto middle = std::chrono::steady_clock::now();
+                expression.evaluate(x.data(), y.data(), samples);
+                auto end = std::chrono::steady_clock::now();
+                nativeTime = std::chrono::duration<float, std::nano>(middle - start).count() / samples;
+                expressionTime = std::chrono::duration<float, std::nano>(end - middle).count() / samples;
+            }
+            ImGui::SameLine();
+            ss.str(std::string());
+            ss << "native f: " << nativeTime << " ns, expression: " << expressionTime << " ns per sample";
+            ImGui::Text(ss.str().c_str());
+        }
+        if (ImGui::CollapsingHeader("Curves")) {
+            ImGui::SliderInt("Count", &curveCount, 0, 128);
+            ImGui::SliderInt("Samples", &curveSamples, 2, 1000000);
+            ImGui::Checkbox("Animate", &animateCurves);
+            ss.str(std::string());
+            ss << "Evaluation: " << curveTime << " ms on " << pool.size() << " threads";
+            ImGui::Text(ss.str().c_str());
+        }
         ImGui::Separator();
         ImGui::Checkbox("Point Mode", &Window1.pointMode);
         ImGui::Checkbox("Vector Mode", &Window1.vectorMode);
@@ -141,14 +305,107 @@ int main() {
             Window1.rotation(Window1.selectedPoint, angle);
         }
         ImGui::Separator();
-        for (size_t i = 0; i < Window1.pointArray.size(); i += 2) {
-            float arr[] = { Window1.pointArray.at(i), Window1.pointArray.at(i + 1) };
-            ImGui::InputFloat2("point", arr);
+        ImGui::Checkbox("Cull points", &Window1.culling);
+        ImGui::SameLine();
+        ss.str(std::string());
+        ss << Window1.visibleCount << " / " << Window1.points.size() << " drawn, pick " << Window1.pickTime << " ns";
+        ImGui::Text(ss.str().c_str());
+        ss.str(std::string());
+        ss << "History: " << Window1.history.position() << " / " << Window1.history.size();
+        ImGui::Text(ss.str().c_str()); ImGui::SameLine();
+        if (ImGui::Button("Undo")) {
+            Window1.undo();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Redo")) {
+            Window1.redo();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Bake")) {
+            Window1.bake();
+        }
+        ImGui::Separator();
+        if (ImGui::CollapsingHeader("Transform benchmark")) {
+            const char* sizes[] = { "10^6 points", "10^7 points", "10^8 points" };
+            ImGui::Combo("Size", &benchmarkSize, sizes, IM_ARRAYSIZE(sizes));
+            // the same rotation with every kernel, on one thread and on the pool, and the upload of the result
+            if (ImGui::Button("Run")) {
+                size_t count = 1000000;
+                for (int i = 0; i < benchmarkSize; i++) {
+                    count *= 10;
+                }
+                PointSet benchmark;
+                benchmark.resize(count);
+                for (size_t i = 0; i < count; i++) {
+                    benchmark.set(i, static_cast<float>(i % 1000), static_cast<float>(i / 1000));
+                }
+                Affine2 rotation = Affine2::rotation(1.0f, 2.0f, 0.1f);
+                const PointKernel kernels[] = { PointKernel::Scalar, PointKernel::SSE, PointKernel::AVX2 };
+                for (int k = 0; k < 3; k++) {
+                    if (kernels[k] > PointSet::bestKernel()) {
+                        benchmarkTimes[k][0] = benchmarkTimes[k][1] = 0.0f;
+                        continue;
+                    }
+                    auto start = std::chrono::steady_clock::now();
+                    benchmark.transform(rotation, nullptr, kernels[k]);
+                    auto middle = std::chrono::steady_clock::now();
+                    benchmark.transform(rotation, &pool, kernels[k]);
+                    auto end = std::chrono::steady_clock::now();
+                    benchmarkTimes[k][0] = std::chrono::duration<float, std::milli>(middle - start).count();
+                    benchmarkTimes[k][1] = std::chrono::duration<float, std::milli>(end - middle).count();
+                }
+
+                Buffer buffer;
+                buffer.allocate(2 * sizeof(GLfloat) * benchmark.capacity(), nullptr, GL_DYNAMIC_DRAW);
+                auto start = std::chrono::steady_clock::now();
+                buffer.update(0, sizeof(GLfloat) * (benchmark.capacity() + benchmark.size()), benchmark.storage());
+                glFinish();
+                uploadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+            for (int k = 0; k < 3; k++) {
+                ss.str(std::string());
+                ss << PointSet::kernelName(static_cast<PointKernel>(k)) << ": " << benchmarkTimes[k][0] << " ms, "
+                   << benchmarkTimes[k][1] << " ms on " << pool.size() << " threads";
+                ImGui::Text(ss.str().c_str());
+            }
+            ss.str(std::string());
+            ss << "Upload: " << uploadTime << " ms";
+            ImGui::Text(ss.str().c_str());
+        }
+        ImGui::Separator();
+        // only the visible rows of a long list are submitted, and only they get the history applied
+        ImGuiListClipper clipper;
+        const PointSet& stored = Window1.points;
+        const Affine2& placement = Window1.history.current();
+        clipper.Begin(static_cast<int>(stored.size()));
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                float arr[] = { placement.x(stored.x(i), stored.y(i)), placement.y(stored.x(i), stored.y(i)) };
+                ImGui::InputFloat2("point", arr);
+            }
         }
         ImGui::Separator();
         ss.str(std::string());
         ss << "Resolution: " << Window1.width << "x" << Window1.height;
         ImGui::Text(ss.str().c_str());
+        ss.str(std::string());
+        ss << "Text: " << textStats.drawCalls << " draw call(s), " << textStats.glyphs << " glyphs, " << textStats.cpuTime << " us";
+        ImGui::Text(ss.str().c_str());
+        ss.str(std::string());
+        ss << "Stream buffer: " << Window1.stream.highWaterMark() / 1024 << " / " << Window1.stream.capacity() / 1024 << " KB";
+        ImGui::Text(ss.str().c_str());
+        const GLState::Counters& frameStats = glState.lastFrame();
+        ss.str(std::string());
+        ss << "Frame: " << frameStats.drawCalls << " draw call(s), " << frameStats.stateChanges << " state change(s) ("
+            << frameStats.redundantChanges << " skipped), " << frameStats.bufferUploads << " upload(s), " << frameStats.uploadedBytes / 1024 << " KB";
+        ImGui::Text(ss.str().c_str());
+        if (ImGui::Button("Export Frame Stats")) {
+            frameStatsExport = glState.exportCsv("frame_stats.csv") ? "frame_stats.csv" : "cannot write frame_stats.csv";
+        }
+        if (!frameStatsExport.empty()) {
+            ImGui::SameLine();
+            ImGui::Text(frameStatsExport.c_str());
+        }
         ImGui::End();
 
         ImGui::Render();
@@ -161,10 +418,24 @@ int main() {
         }
         /* --------- */
 
+        Window1.stream.endFrame();
+
         glfwSwapBuffers(Window1.window);
         glfwPollEvents();
     }
 
+    plots.clear();
+    gpuPlot.release();
+    releaseDrawing();
+    Window1.stream.release();
+    Window1.releasePoints();
+    cameraBuffer.release();
+    pen.release();
+    gridShader.release();
+    pointShader.release();
+    text.release();
+    reportLeakedObjects();
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -2,9 +2,12 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 color;
 
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 out vec3 ourColor;
 
@@ -1,12 +1,14 @@
 #version 460
-layout (location = 0) in vec4 vertex;
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec2 texCoords;
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 projection;
-uniform mat4 view;
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
 
 void main() {
-    gl_Position = projection * view * model * vec4(vertex.xy, 0.0, 1.0);
-    TexCoords = vertex.zw;
+    gl_Position = projection * view * vec4(position, 1.0);
+    TexCoords = texCoords;
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef _CameraBuffer_h_
+#define _CameraBuffer_h_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLObjects.h"
+
+// projection and view matrices shared by all shader programs through one uniform buffer:
+// layout (std140, binding = 0) uniform Camera { mat4 projection; mat4 view; };
+class CameraBuffer {
+public:
+    static const GLuint binding = 0;
+
+    Buffer buffer;
+
+    void init();
+    void release();
+    // called once per frame, before anything is drawn
+    void update(const glm::mat4& projection, const glm::mat4& view);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include "GLObjects.h"
+#include "GLState.h"
+
+#include <iostream>
+#include <utility>
+
+#ifndef NDEBUG
+namespace {
+    int liveObjects[static_cast<int>(GLObjectType::Count)]{};
+    const char* objectNames[static_cast<int>(GLObjectType::Count)] = { "buffer", "vertex array", "texture", "program" };
+}
+
+void trackObject(GLObjectType type, int delta) {
+    liveObjects[static_cast<int>(type)] += delta;
+}
+
+int reportLeakedObjects() {
+    int leaked = 0;
+    for (int i = 0; i < static_cast<int>(GLObjectType::Count); i++) {
+        if (liveObjects[i] == 0) { continue; }
+        std::cout << "ERROR::GL_OBJECTS: " << liveObjects[i] << " " << objectNames[i] << "(s) not released" << std::endl;
+        leaked += liveObjects[i];
+    }
+    return leaked;
+}
+#endif
+
+// Buffer
+
+Buffer::~Buffer() {
+    release();
+}
+
+Buffer::Buffer(Buffer&& other) noexcept {
+    *this = std::move(other);
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::swap(ID, other.ID);
+        std::swap(bytes, other.bytes);
+    }
+    return *this;
+}
+
+void Buffer::create() {
+    glCreateBuffers(1, &ID);
+    trackObject(GLObjectType::Buffer, 1);
+}
+
+void Buffer::storage(GLsizeiptr size, const void* data, GLbitfield flags) {
+    release();
+    create();
+    glNamedBufferStorage(ID, size, data, flags);
+    bytes = size;
+    if (data) {
+        glState.countUpload(static_cast<size_t>(size));
+    }
+}
+
+void Buffer::allocate(GLsizeiptr size, const void* data, GLenum usage) {
+    if (!ID) {
+        create();
+    }
+    glNamedBufferData(ID, size, data, usage);
+    bytes = size;
+    if (data) {
+        glState.countUpload(static_cast<size_t>(size));
+    }
+}
+
+void Buffer::release() {
+    // a mapped buffer is unmapped by deleting it
+    if (ID) {
+        glDeleteBuffers(1, &ID);
+        trackObject(GLObjectType::Buffer, -1);
+        ID = 0;
+    }
+    bytes = 0;
+}
+
+void Buffer::update(GLintptr offset, GLsizeiptr size, const void* data) const {
+    glNamedBufferSubData(ID, offset, size, data);
+    glState.countUpload(static_cast<size_t>(size));
+}
+
+void Buffer::read(GLintptr offset, GLsizeiptr size, void* data) const {
+    glGetNamedBufferSubData(ID, offset, size, data);
+}
+
+void* Buffer::map(GLintptr offset, GLsizeiptr length, GLbitfield access) const {
+    return glMapNamedBufferRange(ID, offset, length, access);
+}
+
+void Buffer::unmap() const {
+    glUnmapNamedBuffer(ID);
+}
+
+void Buffer::bindBase(GLenum target, GLuint index) const {
+    glBindBufferBase(target, index, ID);
+}
+
+void Buffer::bindRange(GLenum target, GLuint index, GLintptr offset, GLsizeiptr size) const {
+    glBindBufferRange(target, index, ID, offset, size);
+}
+
+void Buffer::bind(GLenum target) const {
+    glBindBuffer(target, ID);
+}
+
+// VertexArray
+
+VertexArray::~VertexArray() {
+    release();
+}
+
+VertexArray::VertexArray(VertexArray&& other) noexcept {
+    *this = std::move(other);
+}
+
+VertexArray& VertexArray::operator=(VertexArray&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::swap(ID, other.ID);
+    }
+    return *this;
+}
+
+void VertexArray::create() {
+    release();
+    glCreateVertexArrays(1, &ID);
+    trackObject(GLObjectType::VertexArray, 1);
+}
+
+void VertexArray::release() {
+    if (ID) {
+        glState.forgetVertexArray(ID);
+        glDeleteVertexArrays(1, &ID);
+        trackObject(GLObjectType::VertexArray, -1);
+        ID = 0;
+    }
+}
+
+void VertexArray::vertexBuffer(GLuint binding, const Buffer& buffer, GLintptr offset, GLsizei stride) const {
+    glVertexArrayVertexBuffer(ID, binding, buffer.ID, offset, stride);
+}
+
+void VertexArray::elementBuffer(const Buffer& buffer) const {
+    glVertexArrayElementBuffer(ID, buffer.ID);
+}
+
+void VertexArray::attribute(GLuint location, GLuint binding, GLint size, GLenum type, GLboolean normalized, GLuint relativeOffset) const {
+    glEnableVertexArrayAttrib(ID, location);
+    glVertexArrayAttribFormat(ID, location, size, type, normalized, relativeOffset);
+    glVertexArrayAttribBinding(ID, location, binding);
+}
+
+GLsizei VertexArray::floatAttributes(GLuint binding, std::initializer_list<GLint> components, GLuint firstLocation) const {
+    GLuint location = firstLocation;
+    GLuint offset = 0;
+    for (GLint size : components) {
+        attribute(location++, binding, size, GL_FLOAT, GL_FALSE, offset);
+        offset += size * sizeof(GLfloat);
+    }
+    return static_cast<GLsizei>(offset);
+}
+
+void VertexArray::divisor(GLuint binding, GLuint divisor) const {
+    glVertexArrayBindingDivisor(ID, binding, divisor);
+}
+
+void VertexArray::bind() const {
+    glState.bindVertexArray(ID);
+}
+
+// Texture
+
+Texture::~Texture() {
+    release();
+}
+
+Texture::Texture(Texture&& other) noexcept {
+    *this = std::move(other);
+}
+
+Texture& Texture::operator=(Texture&& other) noexcept {
+    if (this != &other) {
+        release();
+        std::swap(ID, other.ID);
+    }
+    return *this;
+}
+
+void Texture::storage2D(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height) {
+    release();
+    glCreateTextures(GL_TEXTURE_2D, 1, &ID);
+    trackObject(GLObjectType::Texture, 1);
+    glTextureStorage2D(ID, levels, internalFormat, width, height);
+}
+
+void Texture::release() {
+    if (ID) {
+        glState.forgetTexture(ID);
+        glDeleteTextures(1, &ID);
+        trackObject(GLObjectType::Texture, -1);
+        ID = 0;
+    }
+}
+
+void Texture::subImage2D(GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) const {
+    glTextureSubImage2D(ID, level, x, y, width, height, format, type, pixels);
+}
+
+void Texture::parameter(GLenum name, GLint value) const {
+    glTextureParameteri(ID, name, value);
+}
+
+void Texture::bind(GLuint unit) const {
+    glState.bindTexture(unit, ID);
+}
\ No newline at end of file
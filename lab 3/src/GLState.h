@@ -0,0 +1,86 @@
+#ifndef _GLState_h_
+#define _GLState_h_
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+// thin layer over the bind points that the render loop switches: the bound program, vertex
+// array, framebuffer and textures are remembered, and a bind of the object that is already
+// bound does not reach the driver. Every draw call, state change and buffer upload of the
+// frame is counted, the totals of past frames are kept for the menu and for benchmarks.
+//
+// The cache only knows about the binds that go through it: code that binds behind its back
+// (ImGui's renderer) has to be followed by invalidate(), beginFrame() does that as well.
+class GLState {
+public:
+    static const int maxTextureUnits = 16;
+    static const size_t historySize = 1024;
+
+    struct Counters {
+        unsigned int drawCalls{};
+        unsigned int stateChanges{};      // binds that reached the driver
+        unsigned int redundantChanges{};  // binds that were skipped
+        unsigned int bufferUploads{};
+        size_t uploadedBytes{};
+        float frameTime{};                // ms from this beginFrame() to the next one
+    };
+
+    GLState() { invalidate(); }
+
+    // closes the counters of the previous frame and forgets the bindings
+    void beginFrame();
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void bindFramebuffer(GLuint framebuffer);
+    // texture unit, not GL_TEXTURE0 + unit
+    void bindTexture(GLuint unit, GLuint texture);
+
+    // called before an object is deleted, so that a new object with the same name is bound again
+    void forgetProgram(GLuint program);
+    void forgetVertexArray(GLuint vertexArray);
+    void forgetFramebuffer(GLuint framebuffer);
+    void forgetTexture(GLuint texture);
+
+    void drawArrays(GLenum mode, GLint first, GLsizei count);
+    void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+    void multiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawCount);
+    // commands read from the bound GL_DRAW_INDIRECT_BUFFER, counted as one draw call
+    void multiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+    // bytes written to buffer storage, by glBufferSubData-like calls or into mapped memory
+    void countUpload(size_t bytes) { frame.bufferUploads++; frame.uploadedBytes += bytes; }
+
+    // totals of the last finished frame and of the frame in progress
+    const Counters& lastFrame() const { return last; }
+    const Counters& current() const { return frame; }
+    size_t frameCount() const { return finished; }
+
+    // one line per finished frame that is still in the history (oldest first), returns false if
+    // the file can not be written
+    bool exportCsv(const std::string& path) const;
+
+private:
+    static const GLuint unknown = ~0u;
+
+    GLuint program{ unknown };
+    GLuint vertexArray{ unknown };
+    GLuint framebuffer{ unknown };
+    GLuint textures[maxTextureUnits];
+
+    Counters frame, last;
+    std::vector<Counters> history;
+    size_t finished{};
+    std::chrono::steady_clock::time_point frameStart;
+    bool started{};
+};
+
+// the context is current on one thread only, so there is one state for the whole program
+extern GLState glState;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "GeometryBatch.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+GeometryBatch::~GeometryBatch() {
+    release();
+}
+
+void GeometryBatch::init(std::initializer_list<GLint> attributes) {
+    release();
+
+    VAO.create();
+    stride = VAO.floatAttributes(0, attributes) / static_cast<GLsizei>(sizeof(GLfloat));
+}
+
+void GeometryBatch::release() {
+    VBO.release();
+    VAO.release();
+    staged.clear();
+    parts.clear();
+    groups.clear();
+    firsts.clear();
+    counts.clear();
+}
+
+bool GeometryBatch::independent(GLenum mode) {
+    return mode == GL_POINTS || mode == GL_LINES || mode == GL_TRIANGLES;
+}
+
+int GeometryBatch::add(const GLfloat* data, GLsizei count, GLenum mode) {
+    // the stride comes from the vertex format that init() sets up
+    if (!VAO) {
+        std::cout << "ERROR::GEOMETRY_BATCH: init() has to be called before add()" << std::endl;
+        return -1;
+    }
+    if (VBO) {
+        std::cout << "ERROR::GEOMETRY_BATCH: the batch is already built" << std::endl;
+        return -1;
+    }
+
+    parts.push_back({ mode, static_cast<GLint>(staged.size() / stride), count });
+    staged.insert(staged.end(), data, data + static_cast<size_t>(count) * stride);
+    return static_cast<int>(parts.size()) - 1;
+}
+
+void GeometryBatch::build() {
+    if (VBO || parts.empty()) { return; }
+
+    // parts of one primitive type become neighbours, in the order they were added
+    std::vector<size_t> order(parts.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return parts[a].mode < parts[b].mode; });
+
+    std::vector<GLfloat> vertices;
+    vertices.reserve(staged.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        Part& part = parts[order[i]];
+        const GLfloat* source = staged.data() + static_cast<size_t>(part.first) * stride;
+        part.first = static_cast<GLint>(vertices.size() / stride);
+        vertices.insert(vertices.end(), source, source + static_cast<size_t>(part.count) * stride);
+
+        if (groups.empty() || groups.back().mode != part.mode) {
+            groups.push_back({ part.mode, independent(part.mode), part.first, 0, firsts.size(), 0 });
+        }
+        Group& group = groups.back();
+        group.count += part.count;
+        group.drawCount++;
+        firsts.push_back(part.first);
+        counts.push_back(part.count);
+    }
+    staged.clear();
+    staged.shrink_to_fit();
+
+    VBO.storage(sizeof(GLfloat) * vertices.size(), vertices.data());
+    VAO.vertexBuffer(0, VBO, 0, stride * sizeof(GLfloat));
+}
+
+void GeometryBatch::draw() const {
+    if (!VBO) { return; }
+
+    VAO.bind();
+    for (const Group& group : groups) {
+        if (group.merged || group.drawCount == 1) {
+            glState.drawArrays(group.mode, group.first, group.count);
+        }
+        else {
+            glState.multiDrawArrays(group.mode, firsts.data() + group.part, counts.data() + group.part, group.drawCount);
+        }
+    }
+}
\ No newline at end of file
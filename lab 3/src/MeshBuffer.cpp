@@ -0,0 +1,61 @@
+#include "MeshBuffer.h"
+#include "GLState.h"
+
+MeshBuffer::~MeshBuffer() {
+    release();
+}
+
+void MeshBuffer::init(const MeshCache& cache) {
+    release();
+    const MeshCache::Header& header = cache.header();
+    if (header.indexCount == 0) { return; }
+
+    indices = static_cast<GLsizei>(header.indexCount);
+    decode = cache.decoding();
+
+    // positions, colors and normals follow each other in the file and share one buffer
+    const MeshCache::Section& last = header.normals.size ? header.normals : header.colors;
+    const GLsizeiptr vertexSize = static_cast<GLsizeiptr>(last.offset + last.size - header.positions.offset);
+    const GLsizeiptr indexSize = static_cast<GLsizeiptr>(header.indices.size);
+    bytes = vertexSize + indexSize;
+    auto offset = [&](const MeshCache::Section& section) {
+        return static_cast<GLuint>(section.offset - header.positions.offset);
+    };
+
+    VBO.storage(vertexSize, cache.data() + header.positions.offset);
+    EBO.storage(indexSize, cache.data() + header.indices.offset);
+
+    // one binding point per section since their strides differ
+    VAO.create();
+    VAO.elementBuffer(EBO);
+    if (header.flags & MeshCache::QuantizedPositions) {
+        VAO.vertexBuffer(0, VBO, offset(header.positions), 4 * sizeof(GLushort));
+        VAO.attribute(0, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0);
+    }
+    else {
+        VAO.vertexBuffer(0, VBO, offset(header.positions), 3 * sizeof(GLfloat));
+        VAO.attribute(0, 0, 3, GL_FLOAT, GL_FALSE, 0);
+    }
+    VAO.vertexBuffer(1, VBO, offset(header.colors), 4 * sizeof(GLubyte));
+    VAO.attribute(1, 1, 3, GL_UNSIGNED_BYTE, GL_TRUE, 0);
+    if (header.flags & MeshCache::Normals) {
+        VAO.vertexBuffer(2, VBO, offset(header.normals), 2 * sizeof(GLshort));
+        VAO.attribute(2, 2, 2, GL_SHORT, GL_TRUE, 0);
+    }
+}
+
+void MeshBuffer::release() {
+    EBO.release();
+    VBO.release();
+    VAO.release();
+    indices = 0;
+    bytes = 0;
+    decode = glm::mat4(1.0f);
+}
+
+void MeshBuffer::draw() const {
+    if (indices <= 0) { return; }
+
+    VAO.bind();
+    glState.drawElements(GL_TRIANGLES, indices, GL_UNSIGNED_INT, nullptr);
+}
\ No newline at end of file
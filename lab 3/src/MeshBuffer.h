@@ -0,0 +1,44 @@
+#ifndef _MeshBuffer_h_
+#define _MeshBuffer_h_
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLObjects.h"
+#include "MeshCache.h"
+
+// immutable indexed mesh on the gpu in the layout of a mesh cache: positions (location 0, float or
+// normalized uint16), colors (location 1, normalized uint8), optional octahedral normals
+// (location 2, normalized int16 x 2) and 32-bit indices
+class MeshBuffer {
+public:
+    VertexArray VAO;
+    Buffer VBO;
+    Buffer EBO;
+
+    MeshBuffer() = default;
+    ~MeshBuffer();
+
+    MeshBuffer(const MeshBuffer&) = delete;
+    MeshBuffer& operator=(const MeshBuffer&) = delete;
+
+    // replaces the previous mesh; the sections are handed to glBufferStorage straight from the
+    // mapping of the cache, which can be closed afterwards
+    void init(const MeshCache& cache);
+    void release();
+
+    // gl_PrimitiveID of the draw is the index of the triangle in the mesh
+    void draw() const;
+
+    // has to be the innermost factor of the model matrix, see MeshCache::decoding
+    const glm::mat4& decoding() const { return decode; }
+    GLsizei indexCount() const { return indices; }
+    GLsizeiptr size() const { return bytes; }
+
+private:
+    GLsizei indices{};
+    GLsizeiptr bytes{};
+    glm::mat4 decode{ 1.0f };
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef _MeshCache_h_
+#define _MeshCache_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <glm/glm.hpp>
+
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+
+// binary container of a mesh in the vertex layout of MeshBuffer. It is written next to a text mesh
+// after its first import and memory mapped on later loads, so the sections go to the gpu without
+// being parsed or copied on the way.
+//
+// file layout (little endian), every section starts on a multiple of sectionAlignment:
+//   Header
+//   positions  float x, y, z or, quantized, uint16 x, y, z, 0 inside the bounds
+//   colors     uint8 r, g, b, 255 (derived from the position if the source has no colors)
+//   normals    octahedral int16 x, y, only with the Normals flag
+//   indices    uint32, 3 per triangle
+class MeshCache {
+public:
+    static const uint32_t version = 1;
+    static const size_t sectionAlignment = 64;
+
+    enum Flags : uint32_t {
+        QuantizedPositions = 1,
+        Normals            = 2,
+        SourceColors       = 4, // colors come from the source file
+        Optimized          = 8  // written after MeshOptimizer, which keeps the order if it cannot improve it
+    };
+
+    struct Section {
+        uint64_t offset; // from the start of the file
+        uint64_t size;   // bytes
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t flags;
+        uint64_t vertexCount;
+        uint64_t indexCount;
+        float min[3];        // bounds of the positions
+        float max[3];
+        uint64_t sourceSize; // the source file the cache was written from
+        int64_t sourceTime;
+        Section positions;
+        Section colors;
+        Section normals;
+        Section indices;
+    };
+
+    struct Options {
+        bool quantizePositions{ true };
+        bool normals{ false };
+        bool optimize{ true };
+    };
+
+    struct Statistics {
+        bool fromCache;      // false if the source was imported and the cache written
+        float importTime;    // ms
+        float writeTime;     // ms
+        float mapTime;       // ms, opening and checking the cache
+        size_t sourceBytes;
+        size_t cacheBytes;
+        MeshOptimizer::Statistics optimization; // only if the cache was written with optimize
+    };
+
+    Statistics statistics{};
+
+    // the cache of source is written next to it with this suffix
+    static std::string cachePath(const std::string& source) { return source + ".meshcache"; }
+
+    // maps the cache of source; if it is missing, older than source or was written with other options,
+    // source is imported and the cache is written first
+    bool load(const std::string& source, MeshImporter& importer, const Options& options, std::string& error);
+
+    // writes through a temporary file that replaces path when it is complete
+    static bool write(const std::string& path, const Mesh& mesh, const Options& options, uint64_t sourceSize, int64_t sourceTime, std::string& error);
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    bool isOpen() const { return head != nullptr; }
+    const Header& header() const { return *head; }
+    const char* data() const { return file.data(); }
+
+    // stored positions -> object space of the source (scale and offset of quantized positions)
+    glm::mat4 decoding() const;
+    // positions in object space and indices, for use on the cpu
+    void decode(Mesh& mesh) const;
+
+private:
+    MappedFile file;
+    const Header* head{};
+};
+
+#endif
\ No newline at end of file
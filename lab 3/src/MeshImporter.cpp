@@ -0,0 +1,821 @@
+#include "MeshImporter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+
+#include "MappedFile.h"
+
+namespace {
+
+const int64_t relativeBias = int64_t(1) << 40; // marks obj indices relative to the start of their chunk
+
+inline const char* lineEnd(const char* p, const char* end) {
+    const char* q = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return q ? q : end;
+}
+
+inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+inline bool parseFloat(const char*& p, const char* end, float& value) {
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') {
+        p++;
+    }
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) { return false; }
+    p = result.ptr;
+    return true;
+}
+
+inline bool parseInteger(const char*& p, const char* end, long long& value) {
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') {
+        p++;
+    }
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) { return false; }
+    p = result.ptr;
+    return true;
+}
+
+// starts of chunks of about chunkSize bytes that begin at lines, plus the end
+std::vector<size_t> splitLines(const char* data, size_t size, size_t chunkSize) {
+    std::vector<size_t> starts{ 0 };
+    for (size_t position = chunkSize; position < size; position += chunkSize) {
+        if (position <= starts.back()) { continue; }
+        const char* newline = static_cast<const char*>(std::memchr(data + position, '\n', size - position));
+        if (!newline) { break; }
+        starts.push_back(newline + 1 - data);
+    }
+    if (starts.back() != size) {
+        starts.push_back(size);
+    }
+    return starts;
+}
+
+struct ObjChunk {
+    std::vector<float> vertices;  // x y z r g b
+    std::vector<int64_t> corners; // 3 per triangle, 0-based, or relative to the chunk + relativeBias
+    bool colors{};
+    std::string error;
+};
+
+void parseObj(const char* p, const char* end, ObjChunk& chunk) {
+    std::vector<int64_t> polygon;
+    while (p < end) {
+        const char* next = lineEnd(p, end);
+        const char* q = skipSpaces(p, next);
+
+        if (next - q > 1 && q[0] == 'v' && (q[1] == ' ' || q[1] == '\t')) {
+            q += 2;
+            float values[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+            int count = 0;
+            while (count < 6 && parseFloat(q, next, values[count])) {
+                count++;
+            }
+            if (count < 3) {
+                chunk.error = "vertex with less than 3 coordinates";
+                return;
+            }
+            chunk.colors |= count == 6;
+            chunk.vertices.insert(chunk.vertices.end(), values, values + 6);
+        }
+        else if (next - q > 1 && q[0] == 'f' && (q[1] == ' ' || q[1] == '\t')) {
+            q += 2;
+            long long local = static_cast<long long>(chunk.vertices.size() / 6);
+            polygon.clear();
+            long long index;
+            while (parseInteger(q, next, index)) {
+                if (index > 0) {
+                    polygon.push_back(index - 1);
+                }
+                else if (index < 0) {
+                    polygon.push_back(local + index + relativeBias);
+                }
+                else {
+                    chunk.error = "face with index 0";
+                    return;
+                }
+                // texture coordinate and normal indices
+                while (q < next && *q != ' ' && *q != '\t' && *q != '\r') {
+                    q++;
+                }
+            }
+            if (polygon.size() < 3) {
+                chunk.error = "face with less than 3 vertices";
+                return;
+            }
+            for (size_t i = 2; i < polygon.size(); i++) {
+                chunk.corners.insert(chunk.corners.end(), { polygon[0], polygon[i - 1], polygon[i] });
+            }
+        }
+
+        p = next + 1;
+    }
+}
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+struct PlyProperty {
+    std::string name;
+    PlyType type{ PlyType::Invalid };
+    PlyType countType{ PlyType::Invalid }; // list properties only
+    bool list{};
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count{};
+    std::vector<PlyProperty> properties;
+};
+
+PlyType plyType(const std::string& name) {
+    if (name == "char" || name == "int8") { return PlyType::Int8; }
+    if (name == "uchar" || name == "uint8") { return PlyType::UInt8; }
+    if (name == "short" || name == "int16") { return PlyType::Int16; }
+    if (name == "ushort" || name == "uint16") { return PlyType::UInt16; }
+    if (name == "int" || name == "int32") { return PlyType::Int32; }
+    if (name == "uint" || name == "uint32") { return PlyType::UInt32; }
+    if (name == "float" || name == "float32") { return PlyType::Float32; }
+    if (name == "double" || name == "float64") { return PlyType::Float64; }
+    return PlyType::Invalid;
+}
+
+size_t plySize(PlyType type) {
+    switch (type) {
+        case PlyType::Int8:
+        case PlyType::UInt8:   return 1;
+        case PlyType::Int16:
+        case PlyType::UInt16:  return 2;
+        case PlyType::Int32:
+        case PlyType::UInt32:
+        case PlyType::Float32: return 4;
+        case PlyType::Float64: return 8;
+        default:               return 0;
+    }
+}
+
+template <typename T>
+inline T readRaw(const char* p, bool swap) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if (swap) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+inline double readBinary(const char* p, PlyType type, bool swap) {
+    switch (type) {
+        case PlyType::Int8:    return static_cast<int8_t>(*p);
+        case PlyType::UInt8:   return static_cast<uint8_t>(*p);
+        case PlyType::Int16:   return readRaw<int16_t>(p, swap);
+        case PlyType::UInt16:  return readRaw<uint16_t>(p, swap);
+        case PlyType::Int32:   return readRaw<int32_t>(p, swap);
+        case PlyType::UInt32:  return readRaw<uint32_t>(p, swap);
+        case PlyType::Float32: return readRaw<float>(p, swap);
+        case PlyType::Float64: return readRaw<double>(p, swap);
+        default:               return 0.0;
+    }
+}
+
+// index of the property, -1 if there is none
+int findProperty(const PlyElement& element, const char* name, const char* other = nullptr) {
+    for (size_t i = 0; i < element.properties.size(); i++) {
+        if (element.properties[i].name == name || (other && element.properties[i].name == other)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// colors are stored as 0..1, integer channels are scaled from their range
+inline float plyColor(double value, PlyType type) {
+    switch (type) {
+        case PlyType::UInt8:  return static_cast<float>(value / 255.0);
+        case PlyType::UInt16: return static_cast<float>(value / 65535.0);
+        default:              return static_cast<float>(value);
+    }
+}
+
+// what the ply parsers need to know about the vertex and face elements
+struct PlyLayout {
+    int x{ -1 }, y{ -1 }, z{ -1 };
+    int red{ -1 }, green{ -1 }, blue{ -1 };
+    int indices{ -1 };
+};
+
+void fan(const std::vector<int64_t>& polygon, std::vector<int64_t>& corners) {
+    for (size_t i = 2; i < polygon.size(); i++) {
+        corners.insert(corners.end(), { polygon[0], polygon[i - 1], polygon[i] });
+    }
+}
+
+}
+
+MeshImporter::MeshImporter(ThreadPool* _pool) : pool(_pool) {}
+
+bool MeshImporter::load(const std::string& path, Mesh& mesh, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    bool loaded;
+    if (extension == "obj") {
+        loaded = loadObj(file.data(), file.size(), mesh, error);
+    }
+    else if (extension == "ply") {
+        loaded = loadPly(file.data(), file.size(), mesh, error);
+    }
+    else {
+        error = "unknown mesh format ." + extension;
+        return false;
+    }
+
+    statistics.totalTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return loaded;
+}
+
+bool MeshImporter::loadObj(const char* data, size_t size, Mesh& mesh, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+    statistics = Statistics{};
+    statistics.bytes = size;
+
+    std::vector<size_t> starts = splitLines(data, size, chunkSize);
+    std::vector<ObjChunk> chunks(starts.size() - 1);
+    parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            parseObj(data + starts[c], data + starts[c + 1], chunks[c]);
+        }
+    });
+
+    // offsets of every chunk in the whole mesh
+    std::vector<size_t> vertexBase(chunks.size() + 1, 0);
+    std::vector<size_t> cornerBase(chunks.size() + 1, 0);
+    bool colors = false;
+    for (size_t c = 0; c < chunks.size(); c++) {
+        if (!chunks[c].error.empty()) {
+            error = chunks[c].error;
+            return false;
+        }
+        vertexBase[c + 1] = vertexBase[c] + chunks[c].vertices.size() / 6;
+        cornerBase[c + 1] = cornerBase[c] + chunks[c].corners.size();
+        colors |= chunks[c].colors;
+    }
+    const size_t vertexCount = vertexBase.back();
+    if (vertexCount > 0xFFFFFFFFu) {
+        error = "too many vertices";
+        return false;
+    }
+
+    Mesh raw;
+    raw.positions.resize(vertexCount);
+    if (colors) {
+        raw.colors.resize(vertexCount);
+    }
+    raw.indices.resize(cornerBase.back());
+    std::vector<char> invalid(chunks.size(), 0);
+    parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            const ObjChunk& chunk = chunks[c];
+            for (size_t i = 0, n = chunk.vertices.size() / 6; i < n; i++) {
+                const float* v = &chunk.vertices[6 * i];
+                raw.positions[vertexBase[c] + i] = glm::vec3(v[0], v[1], v[2]);
+                if (colors) {
+                    raw.colors[vertexBase[c] + i] = glm::vec3(v[3], v[4], v[5]);
+                }
+            }
+            for (size_t i = 0; i < chunk.corners.size(); i++) {
+                int64_t index = chunk.corners[i];
+                if (index >= relativeBias / 2) {
+                    index += static_cast<int64_t>(vertexBase[c]) - relativeBias;
+                }
+                if (index < 0 || index >= static_cast<int64_t>(vertexCount)) {
+                    invalid[c] = 1;
+                    break;
+                }
+                raw.indices[cornerBase[c] + i] = static_cast<uint32_t>(index);
+            }
+        }
+    });
+    if (std::find(invalid.begin(), invalid.end(), 1) != invalid.end()) {
+        error = "face index out of range";
+        return false;
+    }
+    chunks.clear();
+
+    statistics.parseTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    bool welded = weld(raw, mesh, error);
+    statistics.totalTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return welded;
+}
+
+bool MeshImporter::loadPly(const char* data, size_t size, Mesh& mesh, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+    statistics = Statistics{};
+    statistics.bytes = size;
+
+    // header
+    const char* p = data;
+    const char* end = data + size;
+    enum class Format { Ascii, Little, Big } format = Format::Ascii;
+    std::vector<PlyElement> elements;
+    bool header = true;
+    bool first = true;
+    while (header) {
+        if (p >= end) {
+            error = "ply header without end_header";
+            return false;
+        }
+        const char* next = lineEnd(p, end);
+        std::string line(p, next);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        // end_header may be the last line of the file without a newline
+        p = next < end ? next + 1 : end;
+
+        std::vector<std::string> words;
+        for (size_t i = 0; i < line.size();) {
+            size_t j = line.find_first_of(" \t", i);
+            if (j == std::string::npos) { j = line.size(); }
+            if (j > i) { words.push_back(line.substr(i, j - i)); }
+            i = j + 1;
+        }
+
+        if (first) {
+            if (line != "ply") {
+                error = "not a ply file";
+                return false;
+            }
+            first = false;
+        }
+        else if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+            continue;
+        }
+        else if (words[0] == "format" && words.size() >= 2) {
+            if (words[1] == "ascii") { format = Format::Ascii; }
+            else if (words[1] == "binary_little_endian") { format = Format::Little; }
+            else if (words[1] == "binary_big_endian") { format = Format::Big; }
+            else {
+                error = "unknown ply format " + words[1];
+                return false;
+            }
+        }
+        else if (words[0] == "element" && words.size() >= 3) {
+            PlyElement element;
+            element.name = words[1];
+            element.count = std::strtoull(words[2].c_str(), nullptr, 10);
+            elements.push_back(element);
+        }
+        else if (words[0] == "property" && !elements.empty()) {
+            PlyProperty property;
+            if (words.size() >= 5 && words[1] == "list") {
+                property.list = true;
+                property.countType = plyType(words[2]);
+                property.type = plyType(words[3]);
+                property.name = words[4];
+            }
+            else if (words.size() >= 3) {
+                property.type = plyType(words[1]);
+                property.name = words[2];
+            }
+            if (property.type == PlyType::Invalid || (property.list && property.countType == PlyType::Invalid)) {
+                error = "unknown ply property: " + line;
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+        else if (words[0] == "end_header") {
+            header = false;
+        }
+    }
+
+    // the vertex and face elements
+    int vertexElement = -1, faceElement = -1;
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (elements[i].name == "vertex") { vertexElement = static_cast<int>(i); }
+        if (elements[i].name == "face") { faceElement = static_cast<int>(i); }
+    }
+    if (vertexElement < 0 || faceElement < 0) {
+        error = "ply without vertex or face element";
+        return false;
+    }
+    const PlyElement& vertices = elements[vertexElement];
+    const PlyElement& faces = elements[faceElement];
+    PlyLayout layout;
+    layout.x = findProperty(vertices, "x");
+    layout.y = findProperty(vertices, "y");
+    layout.z = findProperty(vertices, "z");
+    layout.red = findProperty(vertices, "red", "r");
+    layout.green = findProperty(vertices, "green", "g");
+    layout.blue = findProperty(vertices, "blue", "b");
+    layout.indices = findProperty(faces, "vertex_indices", "vertex_index");
+    const bool colors = layout.red >= 0 && layout.green >= 0 && layout.blue >= 0;
+    if (layout.x < 0 || layout.y < 0 || layout.z < 0 || layout.indices < 0 || !faces.properties[layout.indices].list) {
+        error = "ply without x, y, z or vertex_indices";
+        return false;
+    }
+    for (const PlyProperty& property : vertices.properties) {
+        if (property.list) {
+            error = "ply vertex with a list property";
+            return false;
+        }
+    }
+    if (vertices.count > 0xFFFFFFFFu) {
+        error = "too many vertices";
+        return false;
+    }
+
+    Mesh raw;
+    raw.positions.resize(vertices.count);
+    if (colors) {
+        raw.colors.resize(vertices.count);
+    }
+    std::vector<int64_t> corners;
+
+    if (format == Format::Ascii) {
+        // chunks of lines: the number of every line is known from the newlines before it
+        std::vector<size_t> starts = splitLines(p, end - p, chunkSize);
+        const size_t chunkCount = starts.size() - 1;
+        std::vector<size_t> firstLine(chunkCount + 1, 0);
+        parallelFor(chunkCount, 1, [&](size_t begin, size_t finish) {
+            for (size_t c = begin; c < finish; c++) {
+                firstLine[c + 1] = std::count(p + starts[c], p + starts[c + 1], '\n');
+            }
+        });
+        for (size_t c = 0; c < chunkCount; c++) {
+            firstLine[c + 1] += firstLine[c];
+        }
+
+        // first line of every element
+        std::vector<size_t> elementLine(elements.size() + 1, 0);
+        for (size_t i = 0; i < elements.size(); i++) {
+            elementLine[i + 1] = elementLine[i] + elements[i].count;
+        }
+
+        std::vector<std::vector<int64_t>> chunkCorners(chunkCount);
+        std::vector<std::string> errors(chunkCount);
+        parallelFor(chunkCount, 1, [&](size_t begin, size_t finish) {
+            std::vector<double> values;
+            std::vector<int64_t> polygon;
+            for (size_t c = begin; c < finish; c++) {
+                const char* q = p + starts[c];
+                const char* chunkEnd = p + starts[c + 1];
+                for (size_t line = firstLine[c]; q < chunkEnd; line++) {
+                    const char* next = lineEnd(q, chunkEnd);
+                    size_t element = std::upper_bound(elementLine.begin(), elementLine.end(), line) - elementLine.begin() - 1;
+                    if (element == static_cast<size_t>(vertexElement)) {
+                        values.clear();
+                        float value;
+                        while (parseFloat(q, next, value)) {
+                            values.push_back(value);
+                        }
+                        if (values.size() < vertices.properties.size()) {
+                            errors[c] = "ply vertex with missing values";
+                            break;
+                        }
+                        size_t index = line - elementLine[element];
+                        raw.positions[index] = glm::vec3(values[layout.x], values[layout.y], values[layout.z]);
+                        if (colors) {
+                            raw.colors[index] = glm::vec3(plyColor(values[layout.red], vertices.properties[layout.red].type),
+                                plyColor(values[layout.green], vertices.properties[layout.green].type),
+                                plyColor(values[layout.blue], vertices.properties[layout.blue].type));
+                        }
+                    }
+                    else if (element == static_cast<size_t>(faceElement)) {
+                        for (size_t k = 0; k < faces.properties.size(); k++) {
+                            long long count = 1;
+                            if (faces.properties[k].list && !parseInteger(q, next, count)) {
+                                errors[c] = "ply face with missing values";
+                                break;
+                            }
+                            // indices are parsed as integers, a float holds them exactly only up to 2^24;
+                            // other properties are skipped
+                            const bool indices = static_cast<int>(k) == layout.indices;
+                            polygon.clear();
+                            for (long long i = 0; i < count; i++) {
+                                long long index;
+                                float value;
+                                if (indices ? !parseInteger(q, next, index) : !parseFloat(q, next, value)) {
+                                    errors[c] = "ply face with missing values";
+                                    break;
+                                }
+                                if (indices) {
+                                    polygon.push_back(static_cast<int64_t>(index));
+                                }
+                            }
+                            if (indices) {
+                                fan(polygon, chunkCorners[c]);
+                            }
+                        }
+                        if (!errors[c].empty()) { break; }
+                    }
+                    q = next + 1;
+                }
+            }
+        });
+        for (size_t c = 0; c < chunkCount; c++) {
+            if (!errors[c].empty()) {
+                error = errors[c];
+                return false;
+            }
+        }
+        // the last line counts even if no newline ends it
+        const size_t lineCount = firstLine.back() + (p < end && end[-1] != '\n' ? 1 : 0);
+        if (lineCount < elementLine[faceElement + 1] && faces.count > 0) {
+            error = "ply file is truncated";
+            return false;
+        }
+        for (const std::vector<int64_t>& chunk : chunkCorners) {
+            corners.insert(corners.end(), chunk.begin(), chunk.end());
+        }
+    }
+    else {
+        const bool swap = format == Format::Big;
+        for (size_t e = 0; e < elements.size(); e++) {
+            const PlyElement& element = elements[e];
+
+            bool scalar = true;
+            size_t stride = 0;
+            std::vector<size_t> offsets;
+            for (const PlyProperty& property : element.properties) {
+                scalar &= !property.list;
+                offsets.push_back(stride);
+                stride += plySize(property.type);
+            }
+
+            if (scalar) {
+                if (static_cast<size_t>(end - p) < stride * element.count) {
+                    error = "ply file is truncated";
+                    return false;
+                }
+                if (static_cast<int>(e) == vertexElement) {
+                    parallelFor(element.count, 64 * 1024, [&](size_t begin, size_t finish) {
+                        for (size_t i = begin; i < finish; i++) {
+                            const char* v = p + i * stride;
+                            auto read = [&](int property) {
+                                return readBinary(v + offsets[property], element.properties[property].type, swap);
+                            };
+                            raw.positions[i] = glm::vec3(read(layout.x), read(layout.y), read(layout.z));
+                            if (colors) {
+                                raw.colors[i] = glm::vec3(plyColor(read(layout.red), element.properties[layout.red].type),
+                                    plyColor(read(layout.green), element.properties[layout.green].type),
+                                    plyColor(read(layout.blue), element.properties[layout.blue].type));
+                            }
+                        }
+                    });
+                }
+                p += stride * element.count;
+                continue;
+            }
+
+            // faces that are all triangles and have nothing but the index list have a fixed size
+            const PlyProperty& list = element.properties[0];
+            const size_t countSize = plySize(list.countType);
+            const size_t indexSize = plySize(list.type);
+            const size_t triangleStride = countSize + 3 * indexSize;
+            if (static_cast<int>(e) == faceElement && element.properties.size() == 1
+                && static_cast<size_t>(end - p) >= triangleStride * element.count) {
+                raw.indices.resize(3 * element.count);
+                // per block of faces: 1 if there is a polygon, 2 if an index is out of range
+                std::vector<char> problems((element.count + 64 * 1024 - 1) / (64 * 1024), 0);
+                const double vertexCount = static_cast<double>(vertices.count);
+                parallelFor(element.count, 64 * 1024, [&](size_t begin, size_t finish) {
+                    for (size_t i = begin; i < finish; i++) {
+                        const char* f = p + i * triangleStride;
+                        if (readBinary(f, list.countType, swap) != 3.0) {
+                            problems[begin / (64 * 1024)] = 1;
+                            return;
+                        }
+                        for (int k = 0; k < 3; k++) {
+                            double index = readBinary(f + countSize + k * indexSize, list.type, swap);
+                            if (index < 0.0 || index >= vertexCount) {
+                                problems[begin / (64 * 1024)] = 2;
+                                return;
+                            }
+                            raw.indices[3 * i + k] = static_cast<uint32_t>(index);
+                        }
+                    }
+                });
+                // after the first polygon the faces are misread, so later blocks may report indices
+                // out of range that are not; the general reader decides about those
+                if (std::find(problems.begin(), problems.end(), 1) == problems.end()) {
+                    if (std::find(problems.begin(), problems.end(), 2) != problems.end()) {
+                        error = "face index out of range";
+                        return false;
+                    }
+                    p += triangleStride * element.count;
+                    continue;
+                }
+                raw.indices.clear();
+            }
+
+            // general case: every list has to be read to find the next element
+            std::vector<int64_t> polygon;
+            for (size_t i = 0; i < element.count; i++) {
+                for (size_t k = 0; k < element.properties.size(); k++) {
+                    const PlyProperty& property = element.properties[k];
+                    size_t count = 1;
+                    if (property.list) {
+                        if (static_cast<size_t>(end - p) < plySize(property.countType)) {
+                            error = "ply file is truncated";
+                            return false;
+                        }
+                        count = static_cast<size_t>(readBinary(p, property.countType, swap));
+                        p += plySize(property.countType);
+                    }
+                    const size_t valueSize = plySize(property.type);
+                    if (static_cast<size_t>(end - p) < count * valueSize) {
+                        error = "ply file is truncated";
+                        return false;
+                    }
+                    if (static_cast<int>(e) == faceElement && static_cast<int>(k) == layout.indices) {
+                        polygon.clear();
+                        for (size_t j = 0; j < count; j++) {
+                            polygon.push_back(static_cast<int64_t>(readBinary(p + j * valueSize, property.type, swap)));
+                        }
+                        fan(polygon, corners);
+                    }
+                    p += count * valueSize;
+                }
+            }
+        }
+    }
+
+    // the binary fast path has already filled the indices
+    if (raw.indices.empty()) {
+        raw.indices.resize(corners.size());
+    }
+    for (size_t i = 0; i < corners.size(); i++) {
+        if (corners[i] < 0 || corners[i] >= static_cast<int64_t>(vertices.count)) {
+            error = "face index out of range";
+            return false;
+        }
+        raw.indices[i] = static_cast<uint32_t>(corners[i]);
+    }
+    corners.clear();
+    corners.shrink_to_fit();
+
+    statistics.parseTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    bool welded = weld(raw, mesh, error);
+    statistics.totalTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return welded;
+}
+
+bool MeshImporter::weld(Mesh& raw, Mesh& mesh, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+
+    const size_t count = raw.positions.size();
+    const bool colors = !raw.colors.empty();
+    statistics.verticesRead = count;
+    statistics.trianglesRead = raw.indices.size() / 3;
+
+    // +0.0f turns -0 into 0 so that equal values always have equal bits
+    parallelFor(count, 64 * 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            raw.positions[i] += glm::vec3(0.0f);
+            if (colors) {
+                raw.colors[i] += glm::vec3(0.0f);
+            }
+        }
+    });
+    auto equal = [&](uint32_t a, uint32_t b) {
+        return raw.positions[a] == raw.positions[b] && (!colors || raw.colors[a] == raw.colors[b]);
+    };
+
+    std::vector<uint64_t> hashes(count);
+    parallelFor(count, 64 * 1024, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            uint32_t bits[6]{};
+            std::memcpy(bits, &raw.positions[i], sizeof(glm::vec3));
+            if (colors) {
+                std::memcpy(bits + 3, &raw.colors[i], sizeof(glm::vec3));
+            }
+            uint64_t hash = 0;
+            for (uint32_t b : bits) {
+                hash = (hash ^ b) * 0x9E3779B97F4A7C15ull;
+            }
+            hashes[i] = hash ^ (hash >> 29);
+        }
+    });
+
+    // the vertices are partitioned by the top bits of their hash (stable, so every partition is in
+    // file order) and every partition is welded with its own small table that stays in the cache;
+    // first[i] is the first vertex in the file that is equal to vertex i
+    const int partitionBits = count > (1 << 20) ? 10 : 4;
+    const size_t partitions = size_t(1) << partitionBits;
+    std::vector<size_t> partitionStart(partitions + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        partitionStart[(hashes[i] >> (64 - partitionBits)) + 1]++;
+    }
+    for (size_t p = 0; p < partitions; p++) {
+        partitionStart[p + 1] += partitionStart[p];
+    }
+    std::vector<uint32_t> sorted(count);
+    {
+        std::vector<size_t> cursor(partitionStart.begin(), partitionStart.end() - 1);
+        for (size_t i = 0; i < count; i++) {
+            sorted[cursor[hashes[i] >> (64 - partitionBits)]++] = static_cast<uint32_t>(i);
+        }
+    }
+
+    const uint32_t empty = 0xFFFFFFFF;
+    std::vector<uint32_t> first(count);
+    parallelFor(partitions, 1, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> table;
+        for (size_t p = begin; p < end; p++) {
+            size_t size = partitionStart[p + 1] - partitionStart[p];
+            size_t tableSize = 16;
+            while (tableSize < 2 * size) {
+                tableSize *= 2;
+            }
+            table.assign(tableSize, empty);
+            for (size_t s = partitionStart[p]; s < partitionStart[p + 1]; s++) {
+                uint32_t i = sorted[s];
+                size_t slot = static_cast<size_t>(hashes[i]) & (tableSize - 1);
+                while (table[slot] != empty && (hashes[table[slot]] != hashes[i] || !equal(table[slot], i))) {
+                    slot = (slot + 1) & (tableSize - 1);
+                }
+                if (table[slot] == empty) {
+                    table[slot] = i;
+                }
+                first[i] = table[slot];
+            }
+        }
+    });
+    hashes.clear();
+    hashes.shrink_to_fit();
+    sorted.clear();
+    sorted.shrink_to_fit();
+
+    // the kept vertices stay in file order
+    Mesh welded;
+    welded.positions.reserve(count);
+    if (colors) {
+        welded.colors.reserve(count);
+    }
+    std::vector<uint32_t>& remap = first;
+    for (size_t i = 0; i < count; i++) {
+        if (first[i] == i) {
+            remap[i] = static_cast<uint32_t>(welded.positions.size());
+            welded.positions.push_back(raw.positions[i]);
+            if (colors) {
+                welded.colors.push_back(raw.colors[i]);
+            }
+        }
+        else {
+            // first[i] < i was already replaced by its new index
+            remap[i] = remap[first[i]];
+        }
+    }
+
+    // triangles with two equal corners or without area are dropped
+    welded.indices.resize(raw.indices.size());
+    size_t kept = 0;
+    for (size_t t = 0; t + 2 < raw.indices.size(); t += 3) {
+        uint32_t a = remap[raw.indices[t]];
+        uint32_t b = remap[raw.indices[t + 1]];
+        uint32_t c = remap[raw.indices[t + 2]];
+        if (a == b || b == c || a == c) { continue; }
+        glm::vec3 normal = glm::cross(welded.positions[b] - welded.positions[a], welded.positions[c] - welded.positions[a]);
+        if (normal.x == 0.0f && normal.y == 0.0f && normal.z == 0.0f) { continue; }
+        welded.indices[kept++] = a;
+        welded.indices[kept++] = b;
+        welded.indices[kept++] = c;
+    }
+    welded.indices.resize(kept);
+
+    statistics.weldedVertices = count - welded.positions.size();
+    statistics.degenerateTriangles = statistics.trianglesRead - welded.indices.size() / 3;
+    statistics.weldTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // nothing could be drawn or picked, the previous mesh is kept
+    if (welded.indices.empty()) {
+        error = raw.indices.empty() ? "no faces" : "all faces are degenerate";
+        raw.clear();
+        return false;
+    }
+
+    welded.computeBounds();
+    mesh = std::move(welded);
+    raw.clear();
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef _MeshOptimizer_h_
+#define _MeshOptimizer_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+
+// reorders an indexed mesh for the gpu without changing what is drawn:
+//  1. triangles for the post-transform vertex cache with Tipsify (Sander, Nehab, Barczak 2007),
+//  2. clusters of those triangles from front to back against overdraw, a cluster ends at a dead end
+//     of Tipsify or where cutting it costs little cache efficiency,
+//  3. vertices in the order of their first use for locality of the vertex fetch.
+// The mesh is only changed if neither the ACMR nor the overfetch gets worse and one of them improves.
+class MeshOptimizer {
+public:
+    static const int cacheSize = 16;       // post-transform cache entries (fifo)
+    static const int fetchLineSize = 64;   // bytes of a line of the vertex fetch cache
+    static const int fetchLineCount = 2048; // 128 KB
+
+    struct CacheStatistics {
+        float acmr; // transformed vertices per triangle, 0.5 is the limit of regular grids, 3 means no reuse
+        float atvr; // transformed vertices per referenced vertex, 1 is ideal
+    };
+
+    struct Statistics {
+        CacheStatistics cacheBefore;
+        CacheStatistics cacheAfter;
+        float overfetchBefore; // bytes fetched per byte of referenced vertices, 1 is ideal
+        float overfetchAfter;
+        size_t clusters;
+        bool applied; // false if the mesh kept its order, the after values are those of the rejected one
+        float time;   // ms
+    };
+
+    Statistics statistics{};
+
+    // vertexSize - bytes per vertex of the buffer the fetch is measured for
+    void optimize(Mesh& mesh, size_t vertexSize);
+
+    static CacheStatistics analyzeCache(const std::vector<uint32_t>& indices, size_t vertexCount);
+    static float analyzeFetch(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexSize);
+
+private:
+    // triangle order of indices, clusters receives the first triangle of every hard cluster
+    static void tipsify(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& order, std::vector<uint32_t>& clusters);
+    // splits the hard clusters of an ordered triangle list where the cache costs stay below threshold
+    static void splitClusters(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, float threshold);
+    static void sortClusters(const Mesh& mesh, std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters);
+    // renames the vertices of indices in the order of their first use, remap[old] = new or
+    // 0xFFFFFFFF for unused ones; returns the number of used vertices
+    static size_t remapVertices(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& remap);
+    static void reorderVertices(Mesh& mesh, const std::vector<uint32_t>& remap, size_t used);
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "RenderQueue.h"
+#include "GeometryBatch.h"
+#include "GLState.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    const uint64_t idMask = 0xFFF;
+    const uint64_t depthMask = 0xFFFFFF;
+
+    GLuint vertexArrayOf(const RenderQueue::Packet& packet) {
+        if (packet.batch) { return packet.batch->VAO.ID; }
+        return packet.vertexArray ? packet.vertexArray->ID : 0;
+    }
+
+    size_t indexSize(GLenum type) {
+        switch (type) {
+            case GL_UNSIGNED_BYTE:  return sizeof(GLubyte);
+            case GL_UNSIGNED_SHORT: return sizeof(GLushort);
+            default:                return sizeof(GLuint);
+        }
+    }
+}
+
+uint64_t RenderQueue::key(Layer layer, GLuint program, GLuint texture, GLuint vertexArray, float depth) {
+    uint64_t quantized = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(depthMask));
+    uint64_t state = (program & idMask) << 24 | (texture & idMask) << 12 | (vertexArray & idMask);
+    uint64_t result = static_cast<uint64_t>(layer) << 60;
+    if (layer == Layer::Transparent) {
+        result |= (depthMask - quantized) << 36 | state;
+    }
+    else {
+        result |= state << 24 | quantized;
+    }
+    return result;
+}
+
+float RenderQueue::depth(const glm::mat4& view, const glm::vec3& position, float farPlane) {
+    float distance = -(view * glm::vec4(position, 1.0f)).z;
+    return std::clamp(distance / farPlane, 0.0f, 1.0f);
+}
+
+void RenderQueue::submit(Layer layer, float depth, const Packet& packet) {
+    GLuint program = packet.program ? packet.program->ID : 0;
+    GLuint texture = packet.texture ? packet.texture->ID : 0;
+    entries.push_back({ key(layer, program, texture, vertexArrayOf(packet), depth), static_cast<uint32_t>(packets.size()) });
+    packets.push_back(packet);
+}
+
+void RenderQueue::sort() {
+    const size_t n = entries.size();
+    size_t histograms[8][256]{};
+    for (const Entry& entry : entries) {
+        for (int digit = 0; digit < 8; digit++) {
+            histograms[digit][(entry.key >> (8 * digit)) & 0xFF]++;
+        }
+    }
+
+    scratch.resize(n);
+    for (int digit = 0; digit < 8; digit++) {
+        const int shift = 8 * digit;
+        size_t* histogram = histograms[digit];
+        // most digits are the same in every key (unused layers, few programs), those passes are skipped
+        if (histogram[(entries[0].key >> shift) & 0xFF] == n) { continue; }
+
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            size_t count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += count;
+        }
+        for (const Entry& entry : entries) {
+            scratch[histogram[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+unsigned int RenderQueue::countStateChanges() const {
+    unsigned int changes = 0;
+    const Packet* previous = nullptr;
+    for (const Entry& entry : entries) {
+        const Packet& packet = packets[entry.packet];
+        if (!previous) {
+            changes += 2 + (packet.texture != nullptr) + (packet.flags != 0);
+        }
+        else {
+            changes += packet.program != previous->program;
+            changes += packet.texture && packet.texture != previous->texture;
+            changes += vertexArrayOf(packet) != vertexArrayOf(*previous);
+            changes += packet.flags != previous->flags;
+        }
+        previous = &packet;
+    }
+    return changes;
+}
+
+void RenderQueue::execute() {
+    stats = Statistics();
+    stats.packets = packets.size();
+    if (packets.empty()) { return; }
+
+    stats.unsortedStateChanges = countStateChanges();
+    auto start = std::chrono::steady_clock::now();
+    sort();
+    stats.sortTime = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+    stats.stateChanges = countStateChanges();
+
+    const Packet* previous = nullptr;
+    unsigned int flags = 0;
+    for (const Entry& entry : entries) {
+        const Packet& packet = packets[entry.packet];
+
+        // binds of the object that is already bound are dropped by glState
+        if (packet.program) {
+            packet.program->use();
+        }
+        if (packet.texture) {
+            packet.texture->bind(0);
+        }
+        if (packet.modelLocation >= 0 && !(previous && previous->program == packet.program
+            && previous->modelLocation == packet.modelLocation && previous->model == packet.model)) {
+            packet.program->setMat4(packet.modelLocation, packet.model);
+            stats.uniformUpdates++;
+        }
+        if ((packet.flags ^ flags) & PolygonOffset) {
+            if (packet.flags & PolygonOffset) {
+                glEnable(GL_POLYGON_OFFSET_FILL);
+                glPolygonOffset(-1.0f, -1.0f);
+            }
+            else {
+                glDisable(GL_POLYGON_OFFSET_FILL);
+            }
+        }
+        flags = packet.flags;
+
+        if (packet.batch) {
+            packet.batch->draw();
+        }
+        else if (packet.indirect) {
+            packet.vertexArray->bind();
+            packet.indirect->bind(GL_DRAW_INDIRECT_BUFFER);
+            const void* commands = reinterpret_cast<const void*>(static_cast<uintptr_t>(packet.first));
+            glState.multiDrawElementsIndirect(packet.mode, packet.indexType, commands, packet.count, 0);
+        }
+        else if (packet.count > 0) {
+            packet.vertexArray->bind();
+            if (packet.indexType) {
+                const void* indices = reinterpret_cast<const void*>(static_cast<size_t>(packet.first) * indexSize(packet.indexType));
+                glState.drawElements(packet.mode, packet.count, packet.indexType, indices);
+            }
+            else {
+                glState.drawArrays(packet.mode, packet.first, packet.count);
+            }
+        }
+        previous = &packet;
+    }
+    if (flags & PolygonOffset) {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+    }
+
+    packets.clear();
+    entries.clear();
+}
\ No newline at end of file
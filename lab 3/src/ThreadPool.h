@@ -0,0 +1,57 @@
+#ifndef _ThreadPool_h_
+#define _ThreadPool_h_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// fixed set of worker threads for data-parallel loops; the calling thread takes part in the work
+class ThreadPool {
+public:
+    // threads = 0 -> one thread per hardware core
+    explicit ThreadPool(unsigned int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    // calls f(begin, end) for consecutive chunks of [0, count) of at most grain elements
+    // and returns when all of them are done; no allocations are made
+    template <typename F>
+    void parallelFor(size_t count, size_t grain, F&& f) {
+        using Function = typename std::remove_reference<F>::type;
+        run(count, grain, [](void* context, size_t begin, size_t end) {
+            (*static_cast<Function*>(context))(begin, end);
+        }, const_cast<void*>(static_cast<const void*>(&f)));
+    }
+
+private:
+    using Task = void (*)(void* context, size_t begin, size_t end);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping{ false };
+    unsigned long long generation{};
+
+    // current job
+    Task task{};
+    void* context{};
+    size_t count{};
+    size_t grain{};
+    std::atomic<size_t> next{};
+    unsigned int busy{};
+
+    void run(size_t count, size_t grain, Task task, void* context);
+    void work();
+    void workerLoop();
+};
+
+#endif
\ No newline at end of file
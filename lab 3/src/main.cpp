@@ -1,4 +1,7 @@
-﻿#include <glad/glad.h>
+﻿#include <algorithm>
+#include <chrono>
+#include <string>
+#include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -7,6 +10,14 @@
 #include <imgui/backends/imgui_impl_opengl3.h>
 
 #include "ShaderProgram.h"
+#include "CameraBuffer.h"
+#include "GLObjects.h"
+#include "GLState.h"
+#include "GeometryBatch.h"
+#include "MeshBuffer.h"
+#include "MeshCache.h"
+#include "MeshImporter.h"
+#include "RenderQueue.h"
 #include "TextRenderer.h"
 #include "Window.h"
 #include "Camera.h"
@@ -33,116 +44,86 @@ int main() {
 
     // shaders
     ShaderProgram pyramidShader("resources\\shader.vs", "resources\\shader.fs");
+    const GLint pyramidShaderModel = pyramidShader.location("model");
 
     GLfloat pyramidVertices[] = {
         // positions         // colors
+         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f, // green
+         0.5f, 0.0f, -0.5f,  0.0f, 0.0f, 1.0f, // blue
+        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f, // red
+        -0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 0.0f, // yellow
+         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f, // magenta
+    };
+
+    GLuint pyramidIndices[] = {
         // base
-         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,
-         0.5f, 0.0f, -0.5f,  0.0f, 0.0f, 1.0f,
-        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f,
-        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f,
-        -0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 0.0f,
-         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,
+        0, 1, 2,
+        2, 3, 0,
 
         // side
-         0.5f, 0.0f, -0.5f,  0.0f, 0.0f, 1.0f,
-        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f,
-
-        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f,
-        -0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f,
-
-        -0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 0.0f,
-         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f,
-
-         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,
-         0.5f, 0.0f, -0.5f,  0.0f, 0.0f, 1.0f,
-         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f,
+        1, 2, 4,
+        2, 3, 4,
+        3, 0, 4,
+        0, 1, 4,
     };
+    const GLsizei pyramidIndexCount = sizeof(pyramidIndices) / sizeof(GLuint);
 
-    GLfloat Ox[] = {
+    // x, y and z axis
+    const GLfloat axisX[] = {
         0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,
         2.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f
     };
-
-    GLfloat Oy[] = {
+    const GLfloat axisY[] = {
         0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f,
         0.0f, 2.0f, 0.0f,  0.0f, 1.0f, 0.0f
     };
-
-    GLfloat Oz[] = {
+    const GLfloat axisZ[] = {
         0.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f,
         0.0f, 0.0f, 2.0f,  0.0f, 0.0f, 1.0f
     };
 
-    GLuint VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidVertices), pyramidVertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    GLuint xVBO, xVAO;
-    glGenVertexArrays(1, &xVAO);
-    glGenBuffers(1, &xVBO);
-
-    glBindVertexArray(xVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, xVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Ox), Ox, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    GLuint yVBO, yVAO;
-    glGenVertexArrays(1, &yVAO);
-    glGenBuffers(1, &yVBO);
-
-    glBindVertexArray(yVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, yVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Oy), Oy, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    GLuint zVBO, zVAO;
-    glGenVertexArrays(1, &zVAO);
-    glGenBuffers(1, &zVBO);
-
-    glBindVertexArray(zVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, zVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Oz), Oz, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    pyramidShader.use();
+    Buffer VBO, EBO;
+    VBO.storage(sizeof(pyramidVertices), pyramidVertices);
+    EBO.storage(sizeof(pyramidIndices), pyramidIndices);
+
+    VertexArray VAO;
+    VAO.create();
+    VAO.vertexBuffer(0, VBO, 0, VAO.floatAttributes(0, { 3, 3 }));
+    VAO.elementBuffer(EBO);
+
+    // static helper geometry: position + color, one draw call per primitive type
+    GeometryBatch helpers;
+    helpers.init({ 3, 3 });
+    helpers.add(axisX, 2, GL_LINES);
+    helpers.add(axisY, 2, GL_LINES);
+    helpers.add(axisZ, 2, GL_LINES);
+    helpers.build();
+
+    // a mesh loaded from an obj or ply file replaces the pyramid; it is fitted into the same box
+    // (largest extent 1, standing on y = 0). The first load of a file writes a binary cache next to it
+    // which is mapped by later loads
+    ThreadPool pool;
+    MeshImporter importer(&pool);
+    MeshCache::Options cacheOptions;
+    MeshCache::Statistics cacheStatistics{};
+    MeshBuffer meshBuffer;
+    size_t meshVertexCount = 0;
+    float meshUploadTime = 0.0f;
+    glm::mat4 meshFit = glm::mat4(1.0f);
+    char meshPath[256] = "resources\\pyramid.obj";
+    std::string meshError;
+    bool meshLoaded = false;
+    std::string frameStatsExport;
+    RenderQueue renderQueue;
 
     ShaderProgram text("resources\\text.vs", "resources\\text.fs");
-    text.use();
+    text.setVec3("textColor", 0.0f, 0.0f, 0.0f);
     initFreeType();
 
+    // projection and view for all programs
+    CameraBuffer cameraBuffer;
+    cameraBuffer.init();
+
     //glPolygonMode(GL_FRONT_AND_BACK , GL_LINE);
 
     int cameraState = 1;
@@ -156,6 +137,7 @@ int main() {
     while (!glfwWindowShouldClose(window.pWindow)) {
         // per-frame time logic
         window.timing();
+        glState.beginFrame();
 
         // input
         window.keyCallback(window.pWindow);
@@ -170,6 +152,7 @@ int main() {
         //pyramidModel           = glm::rotate(pyramidModel, static_cast<float>(glfwGetTime()) / 5.0f, glm::vec3(0.0f, 1.0f, 0.0f));
 
         float ratio = static_cast<float>(window.Width) / static_cast<float>(window.Height);
+        void (*renderLabels)(RenderQueue&, const ShaderProgram&) = renderAllTextPerspective;
 
         switch (cameraState) {
             case 1: // perspective
@@ -184,7 +167,7 @@ int main() {
                 yam = window.Camera.Yaw;
                 pitch = window.Camera.Pitch;
                 projection = glm::perspective(glm::radians(window.Camera.Zoom), ratio, 0.001f, 100.0f);
-                renderAllTextPerspective(text, projection, view);
+                renderLabels = renderAllTextPerspective;
                 break;
             case 2: // front (ortho)
                 if (firstPerspective) {
@@ -198,7 +181,7 @@ int main() {
                 window.Camera.Yaw = -90.0f;
                 window.Camera.Pitch = 0.0f;
                 window.Camera.updateCameraVectors();
-                renderAllTextFront(text, projection, view);
+                renderLabels = renderAllTextFront;
                 break;
             case 3: // up (oblique)
                 if (firstPerspective) {
@@ -213,7 +196,7 @@ int main() {
                 window.Camera.Yaw = 0.0f;
                 window.Camera.Pitch = -89.999f;
                 window.Camera.updateCameraVectors();
-                renderAllTextUp(text, projection, view);
+                renderLabels = renderAllTextUp;
                 break;
             case 4: // side (ortho)
                 if (firstPerspective) {
@@ -227,26 +210,31 @@ int main() {
                 window.Camera.Yaw = -180.0f;
                 window.Camera.Pitch = 0.0f;
                 window.Camera.updateCameraVectors();
-                renderAllTextSide(text, projection, view);
+                renderLabels = renderAllTextSide;
                 break;
         }
 
-        pyramidShader.use();
-        pyramidShader.setMat4("projection", projection);
-        pyramidShader.setMat4("view", view);
-        pyramidShader.setMat4("model", pyramidModel);
-
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 18);
-
-        pyramidShader.setMat4("model", model);
-
-        glBindVertexArray(xVAO);
-        glDrawArrays(GL_LINES, 0, 2);
-        glBindVertexArray(yVAO);
-        glDrawArrays(GL_LINES, 0, 2);
-        glBindVertexArray(zVAO);
-        glDrawArrays(GL_LINES, 0, 2);
+        cameraBuffer.update(projection, view);
+
+        // everything is collected in the queue and drawn sorted by program, texture and vertex array
+        RenderQueue::Packet object;
+        object.program = &pyramidShader;
+        object.modelLocation = pyramidShaderModel;
+        object.model = pyramidModel * meshFit * meshBuffer.decoding();
+        object.vertexArray = meshLoaded ? &meshBuffer.VAO : &VAO;
+        object.count = meshLoaded ? meshBuffer.indexCount() : pyramidIndexCount;
+        object.indexType = GL_UNSIGNED_INT;
+        renderQueue.submit(RenderQueue::Layer::Opaque, RenderQueue::depth(view, glm::vec3(pyramidModel[3]), 100.0f), object);
+
+        RenderQueue::Packet axes;
+        axes.program = &pyramidShader;
+        axes.modelLocation = pyramidShaderModel;
+        axes.model = model;
+        axes.batch = &helpers;
+        renderQueue.submit(RenderQueue::Layer::Opaque, 0.0f, axes);
+
+        renderLabels(renderQueue, text);
+        renderQueue.execute();
         /*        */
 
         /* Interface */
@@ -267,6 +255,64 @@ int main() {
         ImGui::SliderFloat("Angle", &angle, -180.0f, 180.0f);
         ImGui::RadioButton("Side", &cameraState, 4);
         ImGui::Separator();
+        ImGui::Text("Mesh");
+        ImGui::InputText("File", meshPath, sizeof(meshPath));
+        if (ImGui::Button("Load")) {
+            MeshCache cache;
+            if (cache.load(meshPath, importer, cacheOptions, meshError)) {
+                meshError.clear();
+                cacheStatistics = cache.statistics;
+                auto start = std::chrono::steady_clock::now();
+                meshBuffer.init(cache);
+                glFinish();
+                meshUploadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                meshLoaded = true;
+
+                const MeshCache::Header& header = cache.header();
+                glm::vec3 lower = glm::vec3(header.min[0], header.min[1], header.min[2]);
+                glm::vec3 upper = glm::vec3(header.max[0], header.max[1], header.max[2]);
+                meshVertexCount = static_cast<size_t>(header.vertexCount);
+                cache.close();
+
+                glm::vec3 extent = upper - lower;
+                float size = std::max(extent.x, std::max(extent.y, extent.z));
+                glm::vec3 base = glm::vec3(0.5f * (lower.x + upper.x), lower.y, 0.5f * (lower.z + upper.z));
+                meshFit = glm::scale(glm::mat4(1.0f), glm::vec3(size > 0.0f ? 1.0f / size : 1.0f));
+                meshFit = glm::translate(meshFit, -base);
+            }
+        }
+        if (!meshError.empty()) {
+            ImGui::Text(("Error: " + meshError).c_str());
+        }
+        else if (meshLoaded) {
+            ImGui::Text((std::to_string(meshBuffer.indexCount() / 3) + " triangles, " + std::to_string(meshVertexCount) + " vertices, "
+                + std::to_string(meshBuffer.size() / 1024) + " KB on the gpu, uploaded in " + std::to_string(meshUploadTime) + " ms").c_str());
+            if (cacheStatistics.fromCache) {
+                ImGui::Text(("Cache mapped in " + std::to_string(cacheStatistics.mapTime) + " ms, " + std::to_string(cacheStatistics.cacheBytes / 1024)
+                    + " KB instead of " + std::to_string(cacheStatistics.sourceBytes / 1024) + " KB").c_str());
+            }
+            else {
+                const MeshImporter::Statistics& statistics = importer.statistics;
+                ImGui::Text(("Imported in " + std::to_string(statistics.totalTime) + " ms (parse " + std::to_string(statistics.parseTime) + ", weld "
+                    + std::to_string(statistics.weldTime) + "), " + std::to_string(statistics.megabytesPerSecond()) + " MB/s").c_str());
+                ImGui::Text((std::to_string(statistics.weldedVertices) + " vertices welded, " + std::to_string(statistics.degenerateTriangles)
+                    + " degenerate triangles removed, cache written in " + std::to_string(cacheStatistics.writeTime) + " ms").c_str());
+                if (cacheStatistics.optimization.clusters > 0) {
+                    const MeshOptimizer::Statistics& optimization = cacheStatistics.optimization;
+                    ImGui::Text(("Optimized in " + std::to_string(optimization.time) + " ms: ACMR " + std::to_string(optimization.cacheBefore.acmr) + " -> "
+                        + std::to_string(optimization.cacheAfter.acmr) + ", ATVR " + std::to_string(optimization.cacheBefore.atvr) + " -> "
+                        + std::to_string(optimization.cacheAfter.atvr)).c_str());
+                    ImGui::Text(("Overfetch " + std::to_string(optimization.overfetchBefore) + " -> " + std::to_string(optimization.overfetchAfter) + ", "
+                        + std::to_string(optimization.clusters) + " clusters" + (optimization.applied ? "" : ", not better, original order kept")).c_str());
+                }
+            }
+        }
+        ImGui::Checkbox("Quantize Positions", &cacheOptions.quantizePositions);
+        ImGui::SameLine();
+        ImGui::Checkbox("Normals", &cacheOptions.normals);
+        ImGui::SameLine();
+        ImGui::Checkbox("Optimize", &cacheOptions.optimize);
+        ImGui::Separator();
         ImGui::Text("Pitch"); ImGui::SameLine();
         ImGui::Text(std::to_string(window.Camera.Pitch).c_str());
         ImGui::Text("Yaw"); ImGui::SameLine();
@@ -274,6 +320,24 @@ int main() {
         ImGui::Separator();
         ImGui::Text("FPS:"); ImGui::SameLine();
         ImGui::Text(std::to_string(1.0f / window.DeltaTime).c_str());
+        ImGui::Text("Text:"); ImGui::SameLine();
+        ImGui::Text((std::to_string(textStats.drawCalls) + " draw call(s), " + std::to_string(textStats.glyphs) + " glyphs, " + std::to_string(textStats.cpuTime) + " us").c_str());
+        const GLState::Counters& frameStats = glState.lastFrame();
+        ImGui::Text("Frame:"); ImGui::SameLine();
+        ImGui::Text((std::to_string(frameStats.drawCalls) + " draw call(s), " + std::to_string(frameStats.stateChanges) + " state change(s) ("
+            + std::to_string(frameStats.redundantChanges) + " skipped), " + std::to_string(frameStats.bufferUploads) + " upload(s), "
+            + std::to_string(frameStats.uploadedBytes / 1024) + " KB").c_str());
+        if (ImGui::Button("Export Frame Stats")) {
+            frameStatsExport = glState.exportCsv("frame_stats.csv") ? "frame_stats.csv" : "cannot write frame_stats.csv";
+        }
+        if (!frameStatsExport.empty()) {
+            ImGui::SameLine();
+            ImGui::Text(frameStatsExport.c_str());
+        }
+        const RenderQueue::Statistics& queueStats = renderQueue.statistics();
+        ImGui::Text("Render queue:"); ImGui::SameLine();
+        ImGui::Text((std::to_string(queueStats.packets) + " packets, " + std::to_string(queueStats.stateChanges) + " state change(s) ("
+            + std::to_string(queueStats.unsortedStateChanges) + " unsorted), sort " + std::to_string(queueStats.sortTime) + " us").c_str());
         ImGui::End();
 
         ImGui::Render();
@@ -290,15 +354,16 @@ int main() {
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteVertexArrays(1, &xVAO);
-    glDeleteBuffers(1, &xVBO);
-    glDeleteVertexArrays(1, &yVAO);
-    glDeleteBuffers(1, &yVBO);
-    glDeleteVertexArrays(1, &zVAO);
-    glDeleteBuffers(1, &zVBO);
-    glDeleteProgram(pyramidShader.ID);
+    VAO.release();
+    VBO.release();
+    EBO.release();
+    pyramidShader.release();
+    text.release();
+    meshBuffer.release();
+    cameraBuffer.release();
+    helpers.release();
+    releaseText();
+    reportLeakedObjects();
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
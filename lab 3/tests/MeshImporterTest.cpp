@@ -0,0 +1,84 @@
+#include "MeshImporter.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// loads small meshes built in memory that exercise the parallel paths and their fallbacks,
+// returns the number of them that are not read as expected
+size_t verify(MeshImporter& importer) {
+    size_t failures = 0;
+    Mesh mesh;
+    std::string error;
+
+    // binary triangles with one quad in the second block of the parallel triangle path: the faces
+    // after the quad are misread with a count of 3 (the low byte of the last index) and an index
+    // out of range, which must not reject the file
+    {
+        const uint32_t faceCount = 140000;
+        const uint32_t quad = 70000;
+        std::string ply = "ply\nformat binary_little_endian 1.0\nelement vertex 4\nproperty float x\nproperty float y\n"
+            "property float z\nelement face " + std::to_string(faceCount) + "\nproperty list uchar int vertex_indices\nend_header\n";
+        auto append = [&](const void* value, size_t size) {
+            ply.append(static_cast<const char*>(value), size);
+        };
+        const float positions[4][3] = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+        append(positions, sizeof(positions));
+        for (uint32_t i = 0; i < faceCount; i++) {
+            const unsigned char count = i == quad ? 4 : 3;
+            const int32_t indices[4] = { i == quad ? 0 : 1, i == quad ? 1 : 2, i == quad ? 2 : 3, 3 };
+            append(&count, 1);
+            append(indices, count * sizeof(int32_t));
+        }
+        if (!importer.loadPly(ply.data(), ply.size(), mesh, error) || mesh.indices.size() != 3 * (size_t(faceCount) + 1)) {
+            failures++;
+        }
+    }
+
+    // a last line without a newline: a face that must be read and a header whose body is empty,
+    // copied to buffers of their exact size so that a read past the end leaves the allocation
+    const std::string header = "ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\n"
+        "element face 1\nproperty list uchar int vertex_indices\nend_header";
+    const std::string unterminated = header + "\n0 0 0\n1 0 0\n0 1 0\n3 0 1 2";
+    const std::vector<char> ascii(unterminated.begin(), unterminated.end());
+    if (!importer.loadPly(ascii.data(), ascii.size(), mesh, error) || mesh.indices.size() != 3) {
+        failures++;
+    }
+    for (const char* format : { "ascii", "binary_little_endian" }) {
+        std::string text = header;
+        text.replace(text.find("ascii"), 5, format);
+        const std::vector<char> headerOnly(text.begin(), text.end());
+        if (importer.loadPly(headerOnly.data(), headerOnly.size(), mesh, error)) {
+            failures++;
+        }
+    }
+
+    // vertices without faces and faces without area are errors, not empty meshes
+    const char faceless[] = "v 0 0 0\nv 1 0 0\nv 0 1 0\n";
+    const char degenerate[] = "v 0 0 0\nv 1 0 0\nv 2 0 0\nf 1 2 3\n";
+    for (const char* obj : { faceless, degenerate }) {
+        if (importer.loadObj(obj, std::strlen(obj), mesh, error)) {
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+}
+
+int main() {
+    // the parallel paths only run with workers, whatever the number of cores
+    ThreadPool pool(4);
+    MeshImporter importer(&pool);
+    const size_t failures = verify(importer);
+    if (failures) {
+        std::cout << "ERROR::MESH_IMPORTER: " << failures << " test meshes are not read as expected" << std::endl;
+        return 1;
+    }
+    std::cout << "every test mesh is read as expected" << std::endl;
+    return 0;
+}
\ No newline at end of file
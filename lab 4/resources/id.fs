@@ -0,0 +1,9 @@
+#version 460
+layout (location = 0) out uvec2 id;
+
+// 0 is the background
+uniform int object;
+
+void main() {
+    id = uvec2(uint(object), uint(gl_PrimitiveID));
+}
\ No newline at end of file
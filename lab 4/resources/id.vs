@@ -0,0 +1,13 @@
+#version 460
+layout (location = 0) in vec3 position;
+
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+uniform mat4 model;
+
+void main() {
+    gl_Position = projection * view * model * vec4(position, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 460
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+
+layout (std140, binding = 0) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+// model matrices of all instances; the instances of one shape are consecutive
+// and the draw command of the shape starts at the first of them
+layout (std430, binding = 1) readonly buffer Instances {
+    mat4 models[];
+};
+
+// with culling, every command draws the visible instances that are listed from its baseInstance on
+layout (std430, binding = 2) readonly buffer Visible {
+    uint visible[];
+};
+uniform bool culled;
+
+out vec3 ourColor;
+
+void main() {
+    uint instance = gl_BaseInstance + gl_InstanceID;
+    mat4 model = models[culled ? visible[instance] : instance];
+    gl_Position = projection * view * model * vec4(position, 1.0);
+    ourColor = color;
+}
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+const uint32_t noTriangle = 0xFFFFFFFF;
+
+struct Bounds {
+    glm::vec3 min{ std::numeric_limits<float>::max() };
+    glm::vec3 max{ -std::numeric_limits<float>::max() };
+
+    void grow(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void grow(const Bounds& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+    }
+    float area() const {
+        glm::vec3 e = max - min;
+        return e.x < 0.0f ? 0.0f : 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+// distance to the box along the ray, infinity if it is missed or farther than limit
+inline float hitBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverse, float limit) {
+    glm::vec3 t0 = (min - origin) * inverse;
+    glm::vec3 t1 = (max - origin) * inverse;
+    glm::vec3 entries = glm::min(t0, t1);
+    glm::vec3 exits = glm::max(t0, t1);
+    float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+    float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, limit));
+    return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+}
+
+}
+
+void Bvh::build(const std::vector<glm::vec3>& vertices, const glm::mat4& model, RayKernel kernel) {
+    object = vertices;
+    transform = model;
+    leafKernel = kernel;
+
+    const uint32_t packet = static_cast<uint32_t>(TriangleBlocks::width(kernel));
+    const uint32_t maxLeafSize = std::max(packet, 4u);
+
+    const uint32_t count = static_cast<uint32_t>(object.size() / 3);
+    order.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+
+    // bounds and centroids in world space
+    std::vector<Bounds> bounds(count);
+    std::vector<glm::vec3> centroids(count);
+    for (uint32_t i = 0; i < count; i++) {
+        for (int k = 0; k < 3; k++) {
+            bounds[i].grow(glm::vec3(transform * glm::vec4(object[3 * i + k], 1.0f)));
+        }
+        centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+    }
+
+    nodes.clear();
+    triangles = TriangleBlocks();
+    if (count == 0) {
+        // no root at all: an empty box would be taken for an inner node without children
+        order.clear();
+        return;
+    }
+    nodes.reserve(2 * count);
+    nodes.push_back(Node{ glm::vec3(0.0f), 0, glm::vec3(0.0f), count });
+
+    // binned sah: every node is split at the best of binCount - 1 planes on every axis;
+    // the stack holds the nodes that are still to be split and their depth
+    std::vector<std::pair<uint32_t, uint32_t>> stack{ { 0, 0 } };
+    while (!stack.empty()) {
+        const uint32_t index = stack.back().first;
+        const uint32_t depth = stack.back().second;
+        stack.pop_back();
+
+        const uint32_t first = nodes[index].first;
+        const uint32_t size = nodes[index].count;
+
+        Bounds box, centroidBox;
+        for (uint32_t i = first; i < first + size; i++) {
+            box.grow(bounds[order[i]]);
+            centroidBox.grow(centroids[order[i]]);
+        }
+        nodes[index].min = box.min;
+        nodes[index].max = box.max;
+        if (size <= maxLeafSize || depth == maxDepth) { continue; }
+
+        float bestCost = box.area() * size; // cost of a leaf, in units of one triangle test
+        int bestAxis = -1;
+        float bestSplit = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            float low = centroidBox.min[axis];
+            float high = centroidBox.max[axis];
+            if (high <= low) { continue; }
+
+            Bounds bins[binCount];
+            uint32_t binSizes[binCount]{};
+            float scale = binCount / (high - low);
+            for (uint32_t i = first; i < first + size; i++) {
+                int bin = std::min(binCount - 1, static_cast<int>((centroids[order[i]][axis] - low) * scale));
+                bins[bin].grow(bounds[order[i]]);
+                binSizes[bin]++;
+            }
+
+            // areas and counts left of every plane, then a sweep from the right
+            float leftArea[binCount - 1];
+            uint32_t leftCount[binCount - 1];
+            Bounds left;
+            uint32_t leftSum = 0;
+            for (int i = 0; i < binCount - 1; i++) {
+                left.grow(bins[i]);
+                leftSum += binSizes[i];
+                leftArea[i] = left.area();
+                leftCount[i] = leftSum;
+            }
+            Bounds right;
+            uint32_t rightSum = 0;
+            for (int i = binCount - 1; i > 0; i--) {
+                right.grow(bins[i]);
+                rightSum += binSizes[i];
+                // traversing a node costs about as much as one triangle test
+                float cost = box.area() + leftArea[i - 1] * leftCount[i - 1] + right.area() * rightSum;
+                if (leftCount[i - 1] > 0 && rightSum > 0 && cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = low + i / scale;
+                }
+            }
+        }
+        if (bestAxis < 0) { continue; }
+
+        auto middle = std::partition(order.begin() + first, order.begin() + first + size,
+            [&](uint32_t i) { return centroids[i][bestAxis] < bestSplit; });
+        uint32_t leftSize = static_cast<uint32_t>(middle - (order.begin() + first));
+        if (leftSize == 0 || leftSize == size) { continue; }
+
+        uint32_t leftChild = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(Node{ glm::vec3(0.0f), first, glm::vec3(0.0f), leftSize });
+        nodes.push_back(Node{ glm::vec3(0.0f), first + leftSize, glm::vec3(0.0f), size - leftSize });
+        nodes[index].first = leftChild;
+        nodes[index].count = 0;
+        stack.push_back({ leftChild, depth + 1 });
+        stack.push_back({ leftChild + 1, depth + 1 });
+    }
+
+    // leaves are laid out in lanes, each padded to a whole packet
+    std::vector<uint32_t> lanes;
+    lanes.reserve(order.size());
+    for (Node& node : nodes) {
+        if (node.count == 0) { continue; }
+        uint32_t first = static_cast<uint32_t>(lanes.size());
+        lanes.insert(lanes.end(), order.begin() + node.first, order.begin() + node.first + node.count);
+        lanes.resize((lanes.size() + packet - 1) / packet * packet, noTriangle);
+        node.first = first;
+    }
+    order.swap(lanes);
+
+    triangles.resize(order.size());
+    transformTriangles();
+}
+
+void Bvh::refit(const glm::mat4& model) {
+    transform = model;
+    transformTriangles();
+    refitNodes();
+}
+
+void Bvh::transformTriangles() {
+    for (size_t i = 0; i < order.size(); i++) {
+        if (order[i] == noTriangle) { continue; }
+        const glm::vec3* v = &object[3 * order[i]];
+        glm::vec3 p0(transform * glm::vec4(v[0], 1.0f));
+        glm::vec3 p1(transform * glm::vec4(v[1], 1.0f));
+        glm::vec3 p2(transform * glm::vec4(v[2], 1.0f));
+        triangles.set(i, p0, p1, p2);
+    }
+}
+
+void Bvh::refitNodes() {
+    // children are always stored after their parent, so one backward pass visits them first
+    for (size_t n = nodes.size(); n-- > 0;) {
+        Node& node = nodes[n];
+        Bounds box;
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                box.grow(triangles.vertex(i, 0));
+                box.grow(triangles.vertex(i, 1));
+                box.grow(triangles.vertex(i, 2));
+            }
+        }
+        else {
+            const Node& left = nodes[node.first];
+            const Node& right = nodes[node.first + 1];
+            box.min = glm::min(left.min, right.min);
+            box.max = glm::max(left.max, right.max);
+        }
+        node.min = box.min;
+        node.max = box.max;
+    }
+}
+
+bool Bvh::intersect(const glm::vec3& origin, const glm::vec3& direction, Hit& hit) const {
+    if (nodes.empty()) { return false; }
+
+    const glm::vec3 inverse = 1.0f / direction;
+    float closest = std::numeric_limits<float>::infinity();
+    size_t closestLane = 0;
+
+    // a node at depth d is popped from at most d + 1 entries and replaced by its two children
+    uint32_t stack[maxDepth + 1];
+    int top = 0;
+    if (hitBox(nodes[0].min, nodes[0].max, origin, inverse, closest) == std::numeric_limits<float>::infinity()) {
+        return false;
+    }
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+
+        if (node.count > 0) {
+            triangles.intersect(origin, direction, node.first, node.count, closest, closestLane, leafKernel);
+            continue;
+        }
+
+        // the nearer child is visited first, boxes behind the closest hit are skipped
+        uint32_t left = node.first;
+        uint32_t right = node.first + 1;
+        float leftDistance = hitBox(nodes[left].min, nodes[left].max, origin, inverse, closest);
+        float rightDistance = hitBox(nodes[right].min, nodes[right].max, origin, inverse, closest);
+        if (leftDistance > rightDistance) {
+            std::swap(left, right);
+            std::swap(leftDistance, rightDistance);
+        }
+        if (rightDistance != std::numeric_limits<float>::infinity()) {
+            stack[top++] = right;
+        }
+        if (leftDistance != std::numeric_limits<float>::infinity()) {
+            stack[top++] = left;
+        }
+    }
+
+    if (closest == std::numeric_limits<float>::infinity()) {
+        return false;
+    }
+    hit.t = closest;
+    hit.triangle = order[closestLane];
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef _Bvh_h_
+#define _Bvh_h_
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "TriangleBlocks.h"
+
+// bounding volume hierarchy over the triangles of a model in world space for closest-hit ray queries.
+// It is built once with the surface area heuristic; when only the model matrix changes the
+// triangles are transformed again and the boxes are refitted bottom-up with the same tree.
+// Every leaf holds up to one packet of the leaf kernel and starts on a packet boundary, so it is
+// tested with a single simd intersection; only leaves at the maximum depth may hold more.
+class Bvh {
+public:
+    struct Hit {
+        float t;           // distance along the ray in units of its direction
+        uint32_t triangle; // index of the triangle in the vertices given to build
+    };
+
+    // vertices - 3 per triangle in object space, the leaf size follows the width of kernel
+    void build(const std::vector<glm::vec3>& vertices, const glm::mat4& model, RayKernel kernel = TriangleBlocks::bestKernel());
+    void refit(const glm::mat4& model);
+    // any kernel gives the same results, but only the one of build fills the packets exactly
+    void setKernel(RayKernel kernel) { leafKernel = kernel; }
+    RayKernel kernel() const { return leafKernel; }
+
+    // closest triangle hit by origin + t * direction with t > 0, same tests as Window::distanceToIntersection
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, Hit& hit) const;
+
+    const glm::mat4& model() const { return transform; }
+    size_t triangleCount() const { return object.size() / 3; }
+    size_t nodeCount() const { return nodes.size(); }
+    // true before the first build and after a build without triangles
+    bool empty() const { return nodes.empty(); }
+
+private:
+    struct Node {
+        glm::vec3 min;
+        uint32_t first; // leaf: first lane of triangles, inner node: left child (the right one follows it)
+        glm::vec3 max;
+        uint32_t count; // number of triangles, 0 for inner nodes
+    };
+
+    static const int binCount = 12;
+    // leaves are at most this deep, so the traversal stack of intersect needs maxDepth + 1 entries
+    static const uint32_t maxDepth = 63;
+
+    std::vector<Node> nodes;
+    TriangleBlocks triangles;           // world space triangles in the order of the leaves
+    std::vector<uint32_t> order;        // input index of the triangle of every lane, padding lanes hold noTriangle
+    RayKernel leafKernel{ RayKernel::Scalar };
+    std::vector<glm::vec3> object;      // input vertices
+    glm::mat4 transform{ 1.0f };
+
+    void transformTriangles();
+    void refitNodes();
+};
+
+#endif
\ No newline at end of file
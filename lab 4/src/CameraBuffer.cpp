@@ -0,0 +1,19 @@
+#include "CameraBuffer.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+void CameraBuffer::init() {
+    buffer.storage(2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    buffer.bindBase(GL_UNIFORM_BUFFER, binding);
+}
+
+void CameraBuffer::release() {
+    buffer.release();
+}
+
+void CameraBuffer::update(const glm::mat4& projection, const glm::mat4& view) {
+    // std140 stores a mat4 as four vec4 columns, exactly like glm, and the two matrices are adjacent
+    const glm::mat4 matrices[2] = { projection, view };
+    buffer.update(0, sizeof(matrices), matrices);
+}
\ No newline at end of file
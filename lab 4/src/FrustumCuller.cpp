@@ -0,0 +1,196 @@
+#include "FrustumCuller.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRUSTUM_CULLER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+// as in TriangleBlocks: no fused multiply-add, so every kernel rounds like the scalar one
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#endif
+#endif
+
+namespace {
+
+const size_t width = FrustumCuller::blockWidth;
+const size_t blockFloats = 4 * width;
+
+// lanes of the packet starting at sphere c that lie in [first, end)
+inline unsigned int rangeMask(size_t c, size_t first, size_t end, size_t packet) {
+    unsigned int mask = (1u << packet) - 1;
+    if (c < first) {
+        mask &= mask << (first - c);
+    }
+    if (c + packet > end) {
+        mask &= mask >> (c + packet - end);
+    }
+    return mask;
+}
+
+inline size_t append(unsigned int mask, size_t c, uint32_t* visible) {
+    size_t n = 0;
+    for (size_t l = 0; mask; l++, mask >>= 1) {
+        if (mask & 1) {
+            visible[n++] = static_cast<uint32_t>(c + l);
+        }
+    }
+    return n;
+}
+
+inline size_t bitCount(unsigned int mask) {
+    size_t n = 0;
+    for (; mask; mask &= mask - 1) {
+        n++;
+    }
+    return n;
+}
+
+// a sphere is culled when its center is farther than the radius behind one of the planes;
+// the distance is ((a x + b y) + c z) + d in every kernel
+size_t cullScalar(const float* data, const float (*planes)[4], size_t first, size_t end, uint32_t* visible) {
+    size_t n = 0;
+    for (size_t i = first; i < end; i++) {
+        const float* p = data + i / width * blockFloats + i % width;
+        float x = p[0], y = p[width], z = p[2 * width], minusRadius = -p[3 * width];
+
+        bool inside = true;
+        for (int k = 0; k < 6 && inside; k++) {
+            float distance = planes[k][0] * x + planes[k][1] * y + planes[k][2] * z + planes[k][3];
+            inside = distance >= minusRadius;
+        }
+        if (inside) {
+            visible[n++] = static_cast<uint32_t>(i);
+        }
+    }
+    return n;
+}
+
+#ifdef FRUSTUM_CULLER_X86
+size_t cullSSE(const float* data, const float (*planes)[4], size_t first, size_t end, uint32_t* visible) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    size_t n = 0;
+    for (size_t c = first & ~size_t(3); c < end; c += 4) {
+        const float* p = data + c / width * blockFloats + c % width;
+        __m128 x = _mm_load_ps(p), y = _mm_load_ps(p + width), z = _mm_load_ps(p + 2 * width);
+        __m128 minusRadius = _mm_xor_ps(_mm_load_ps(p + 3 * width), sign);
+
+        unsigned int mask = rangeMask(c, first, end, 4);
+        for (int k = 0; k < 6 && mask; k++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[k][0]), x),
+                _mm_mul_ps(_mm_set1_ps(planes[k][1]), y)), _mm_mul_ps(_mm_set1_ps(planes[k][2]), z)), _mm_set1_ps(planes[k][3]));
+            mask &= static_cast<unsigned int>(_mm_movemask_ps(_mm_cmpge_ps(distance, minusRadius)));
+        }
+        n += append(mask, c, visible + n);
+    }
+    return n;
+}
+
+TARGET_AVX2 size_t cullAVX2(const float* data, const float (*planes)[4], size_t first, size_t end, uint32_t* visible) {
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    size_t n = 0;
+    for (size_t c = first & ~size_t(7); c < end; c += 8) {
+        const float* p = data + c / width * blockFloats + c % width;
+        __m256 x = _mm256_load_ps(p), y = _mm256_load_ps(p + width), z = _mm256_load_ps(p + 2 * width);
+        __m256 minusRadius = _mm256_xor_ps(_mm256_load_ps(p + 3 * width), sign);
+
+        unsigned int mask = rangeMask(c, first, end, 8);
+        for (int k = 0; k < 6 && mask; k++) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[k][0]), x),
+                _mm256_mul_ps(_mm256_set1_ps(planes[k][1]), y)), _mm256_mul_ps(_mm256_set1_ps(planes[k][2]), z)), _mm256_set1_ps(planes[k][3]));
+            mask &= static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(distance, minusRadius, _CMP_GE_OQ)));
+        }
+        n += append(mask, c, visible + n);
+    }
+    return n;
+}
+
+// the visible lanes are packed by a compress store instead of a loop over the mask
+TARGET_AVX512 size_t cullAVX512(const float* data, const float (*planes)[4], size_t first, size_t end, uint32_t* visible) {
+    const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+    size_t n = 0;
+    for (size_t c = first & ~size_t(15); c < end; c += 16) {
+        const float* p = data + c / width * blockFloats;
+        __m512 x = _mm512_load_ps(p), y = _mm512_load_ps(p + width), z = _mm512_load_ps(p + 2 * width);
+        __m512 minusRadius = _mm512_sub_ps(_mm512_setzero_ps(), _mm512_load_ps(p + 3 * width));
+
+        __mmask16 mask = static_cast<__mmask16>(rangeMask(c, first, end, 16));
+        for (int k = 0; k < 6 && mask; k++) {
+            __m512 distance = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(planes[k][0]), x),
+                _mm512_mul_ps(_mm512_set1_ps(planes[k][1]), y)), _mm512_mul_ps(_mm512_set1_ps(planes[k][2]), z)), _mm512_set1_ps(planes[k][3]));
+            mask = _mm512_mask_cmp_ps_mask(mask, distance, minusRadius, _CMP_GE_OQ);
+        }
+        if (mask) {
+            __m512i indices = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(c)), lanes);
+            _mm512_mask_compressstoreu_epi32(visible + n, mask, indices);
+            n += bitCount(mask);
+        }
+    }
+    return n;
+}
+#endif
+
+}
+
+void FrustumCuller::resize(size_t spheres) {
+    size_t old = blocks.size();
+    blocks.resize((spheres + blockWidth - 1) / blockWidth);
+    for (size_t b = old; b < blocks.size(); b++) {
+        std::memset(&blocks[b], 0, sizeof(Block));
+    }
+    count = spheres;
+}
+
+void FrustumCuller::set(size_t index, const glm::vec3& center, float radius) {
+    Block& block = blocks[index / blockWidth];
+    size_t l = index % blockWidth;
+    block.x[l] = center.x;
+    block.y[l] = center.y;
+    block.z[l] = center.z;
+    block.radius[l] = radius;
+}
+
+void FrustumCuller::setFrustum(const glm::mat4& viewProjection) {
+    // clip space is -w <= x, y, z <= w, so every plane is the last row of the matrix plus or minus
+    // one of the others; this holds for perspective and orthographic projections alike
+    for (int k = 0; k < 6; k++) {
+        float s = k % 2 == 0 ? 1.0f : -1.0f;
+        glm::vec4 plane;
+        for (int c = 0; c < 4; c++) {
+            plane[c] = viewProjection[c][3] + s * viewProjection[c][k / 2];
+        }
+        plane /= glm::length(glm::vec3(plane));
+        for (int c = 0; c < 4; c++) {
+            planes[k][c] = plane[c];
+        }
+    }
+}
+
+size_t FrustumCuller::cull(size_t first, size_t last, uint32_t* visible, RayKernel kernel) const {
+    size_t (*function)(const float*, const float (*)[4], size_t, size_t, uint32_t*) = cullScalar;
+#ifdef FRUSTUM_CULLER_X86
+    if (kernel == RayKernel::SSE) {
+        function = cullSSE;
+    }
+    else if (kernel == RayKernel::AVX2) {
+        function = cullAVX2;
+    }
+    else if (kernel == RayKernel::AVX512) {
+        function = cullAVX512;
+    }
+#endif
+    if (last > count) {
+        last = count;
+    }
+    if (first >= last) { return 0; }
+
+    return function(blocks.front().x, planes, first, last, visible);
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef _FrustumCuller_h_
+#define _FrustumCuller_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "TriangleBlocks.h"
+
+// bounding spheres of many objects tested against the six planes of the view frustum, 4, 8 or 16
+// at once: centers and radii are stored as structure of arrays in blocks of 16 lanes. The planes are
+// taken from projection * view, so perspective and orthographic cameras are handled alike.
+// Kernels are chosen as for the ray tests of TriangleBlocks and give the same result as the scalar one.
+class FrustumCuller {
+public:
+    static const size_t blockWidth = 16;
+
+    void resize(size_t spheres);
+    size_t size() const { return count; }
+
+    void set(size_t index, const glm::vec3& center, float radius);
+
+    void setFrustum(const glm::mat4& viewProjection);
+
+    // writes the indices of the spheres in [first, last) that are at least partly inside the frustum
+    // to visible in ascending order and returns their number; visible has room for last - first
+    // indices. Different ranges can be culled on different threads.
+    size_t cull(size_t first, size_t last, uint32_t* visible, RayKernel kernel = TriangleBlocks::bestKernel()) const;
+
+private:
+    struct alignas(64) Block {
+        float x[blockWidth];
+        float y[blockWidth];
+        float z[blockWidth];
+        float radius[blockWidth];
+    };
+
+    std::vector<Block> blocks;
+    size_t count{};
+    float planes[6][4]{}; // a x + b y + c z + d >= 0 inside, (a, b, c) has unit length
+};
+
+#endif
\ No newline at end of file
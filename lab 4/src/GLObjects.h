@@ -0,0 +1,126 @@
+#ifndef _GLObjects_h_
+#define _GLObjects_h_
+
+#include <initializer_list>
+#include <glad/glad.h>
+
+// owning wrappers of gl objects created and edited through direct state access (GL 4.5):
+// every call names the object, so nothing has to be bound to set it up or update it and
+// the bindings used for drawing are never disturbed. The objects are created by the first
+// create/storage call, not by the constructor, so they can be members of objects that exist
+// before the context. They are movable but not copyable and are deleted by release() or the
+// destructor; release() has to run while the context is alive.
+//
+// Debug builds count the live objects of every type (shader programs included),
+// reportLeakedObjects() lists the ones that were not released
+
+enum class GLObjectType { Buffer, VertexArray, Texture, Program, Count };
+
+#ifdef NDEBUG
+inline void trackObject(GLObjectType, int) {}
+inline int reportLeakedObjects() { return 0; }
+#else
+// delta: +1 when an object is created, -1 when it is deleted
+void trackObject(GLObjectType type, int delta);
+// prints the objects that are still alive and returns their number; meant to be called after
+// everything has been released, before the context is destroyed
+int reportLeakedObjects();
+#endif
+
+class Buffer {
+public:
+    GLuint ID{};
+
+    Buffer() = default;
+    ~Buffer();
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    Buffer(Buffer&& other) noexcept;
+    Buffer& operator=(Buffer&& other) noexcept;
+
+    // immutable storage, flags as for glBufferStorage (GL_DYNAMIC_STORAGE_BIT for update(),
+    // GL_MAP_* for map()); storage can not be respecified, so an existing buffer is replaced by a
+    // new object and vertex arrays have to be pointed at it again
+    void storage(GLsizeiptr size, const void* data, GLbitfield flags = 0);
+    // mutable storage, a later call respecifies it under the same name
+    void allocate(GLsizeiptr size, const void* data, GLenum usage);
+    void release();
+
+    void update(GLintptr offset, GLsizeiptr size, const void* data) const;
+    void read(GLintptr offset, GLsizeiptr size, void* data) const;
+    void* map(GLintptr offset, GLsizeiptr length, GLbitfield access) const;
+    void unmap() const;
+    // indexed binding point of GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, ...
+    void bindBase(GLenum target, GLuint index) const;
+    // part of the buffer at an indexed binding point; offset has to respect the alignment of the target
+    void bindRange(GLenum target, GLuint index, GLintptr offset, GLsizeiptr size) const;
+    // non-indexed targets that draw calls read from, e.g. GL_DRAW_INDIRECT_BUFFER
+    void bind(GLenum target) const;
+
+    GLsizeiptr size() const { return bytes; }
+    explicit operator bool() const { return ID != 0; }
+
+private:
+    GLsizeiptr bytes{};
+
+    void create();
+};
+
+class VertexArray {
+public:
+    GLuint ID{};
+
+    VertexArray() = default;
+    ~VertexArray();
+
+    VertexArray(const VertexArray&) = delete;
+    VertexArray& operator=(const VertexArray&) = delete;
+    VertexArray(VertexArray&& other) noexcept;
+    VertexArray& operator=(VertexArray&& other) noexcept;
+
+    void create();
+    void release();
+
+    // attaches the buffer to a binding point; attributes read from binding points, not buffers,
+    // so replacing the buffer is this one call
+    void vertexBuffer(GLuint binding, const Buffer& buffer, GLintptr offset, GLsizei stride) const;
+    void elementBuffer(const Buffer& buffer) const;
+    // enables the location and reads it from the binding point, relativeOffset in bytes
+    void attribute(GLuint location, GLuint binding, GLint size, GLenum type, GLboolean normalized, GLuint relativeOffset) const;
+    // interleaved float attributes at locations firstLocation, firstLocation + 1, ... with the
+    // given numbers of components; returns the stride in bytes
+    GLsizei floatAttributes(GLuint binding, std::initializer_list<GLint> components, GLuint firstLocation = 0) const;
+    // instanced attributes: the binding point advances once per divisor instances
+    void divisor(GLuint binding, GLuint divisor) const;
+
+    void bind() const;
+
+    explicit operator bool() const { return ID != 0; }
+};
+
+class Texture {
+public:
+    GLuint ID{};
+
+    Texture() = default;
+    ~Texture();
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+    Texture(Texture&& other) noexcept;
+    Texture& operator=(Texture&& other) noexcept;
+
+    // immutable 2D texture, pixels are uploaded with subImage2D
+    void storage2D(GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+    void release();
+
+    void subImage2D(GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) const;
+    void parameter(GLenum name, GLint value) const;
+    // texture unit, not GL_TEXTURE0 + unit
+    void bind(GLuint unit) const;
+
+    explicit operator bool() const { return ID != 0; }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "IdPicker.h"
+#include "GLState.h"
+
+#include <iostream>
+
+IdPicker::~IdPicker() {
+    release();
+}
+
+void IdPicker::init() {
+    // the attachments stay in place when resize() changes the storage of the renderbuffers
+    glCreateFramebuffers(1, &FBO);
+    glCreateRenderbuffers(1, &colorBuffer);
+    glCreateRenderbuffers(1, &depthBuffer);
+    glNamedFramebufferRenderbuffer(FBO, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glNamedFramebufferRenderbuffer(FBO, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glNamedFramebufferReadBuffer(FBO, GL_COLOR_ATTACHMENT0);
+
+    for (int i = 0; i < slotCount; i++) {
+        PBO[i].allocate(2 * sizeof(GLuint), nullptr, GL_STREAM_READ);
+    }
+
+    width = height = 0;
+    next = 0;
+    frame = 0;
+}
+
+void IdPicker::release() {
+    reset();
+    for (int i = 0; i < slotCount; i++) {
+        PBO[i].release();
+    }
+    if (FBO) {
+        glState.forgetFramebuffer(FBO);
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        FBO = colorBuffer = depthBuffer = 0;
+    }
+}
+
+void IdPicker::resize(GLsizei _width, GLsizei _height) {
+    width = _width;
+    height = _height;
+
+    glNamedRenderbufferStorage(colorBuffer, GL_RG32UI, width, height);
+    glNamedRenderbufferStorage(depthBuffer, GL_DEPTH_COMPONENT24, width, height);
+    if (glCheckNamedFramebufferStatus(FBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::ID_PICKER: framebuffer is not complete" << std::endl;
+    }
+}
+
+void IdPicker::begin(GLsizei _width, GLsizei _height, GLint x, GLint y) {
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    if (_width != width || _height != height) {
+        resize(_width, _height);
+    }
+    glState.bindFramebuffer(FBO);
+    glViewport(0, 0, width, height);
+
+    pixelX = x < 0 ? 0 : (x >= width ? width - 1 : x);
+    pixelY = y < 0 ? 0 : (y >= height ? height - 1 : y);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(pixelX, pixelY, 1, 1);
+
+    const GLuint background[4] = { 0, 0, 0, 0 };
+    glClearBufferuiv(GL_COLOR, 0, background);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void IdPicker::end(int tag) {
+    // a slot is free once its result has been polled
+    if (!fences[next]) {
+        // reading into a buffer has no direct state access form, the pack binding is needed
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, PBO[next].ID);
+        glReadPixels(pixelX, pixelY, 1, 1, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        tags[next] = tag;
+        frames[next] = frame;
+        next = (next + 1) % slotCount;
+    }
+    frame++;
+
+    glDisable(GL_SCISSOR_TEST);
+    glState.bindFramebuffer(0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+bool IdPicker::poll(Result& result) {
+    bool found = false;
+    // slots are checked from the oldest readback to the newest one
+    for (int k = 0; k < slotCount; k++) {
+        int i = (next + k) % slotCount;
+        if (!fences[i]) { continue; }
+
+        GLenum status = glClientWaitSync(fences[i], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) { break; }
+        glDeleteSync(fences[i]);
+        fences[i] = nullptr;
+
+        GLuint id[2];
+        PBO[i].read(0, sizeof(id), id);
+
+        result.object = id[0];
+        result.primitive = id[1];
+        result.tag = tags[i];
+        result.latency = frame - frames[i];
+        found = true;
+    }
+    return found;
+}
+
+void IdPicker::reset() {
+    for (int i = 0; i < slotCount; i++) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+    next = 0;
+}
\ No newline at end of file
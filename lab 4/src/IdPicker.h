@@ -0,0 +1,65 @@
+#ifndef _IdPicker_h_
+#define _IdPicker_h_
+
+#include <glad/glad.h>
+
+#include "GLObjects.h"
+
+// picking by rendering object and primitive ids into an integer render target:
+// fragment shaders write uvec2(object, gl_PrimitiveID) to location 0, 0 is left for the background.
+// The pixel under the cursor is copied into a pixel buffer object and read one or two frames later,
+// once its fence has signaled, so the cpu never waits for the gpu and the cost does not depend
+// on the number of triangles.
+class IdPicker {
+public:
+    struct Result {
+        GLuint object;         // 0 if nothing was drawn at the pixel
+        GLuint primitive;
+        int tag;               // value given to end() in the frame of the readback
+        unsigned int latency;  // frames between the readback and its result
+    };
+
+    IdPicker() = default;
+    ~IdPicker();
+
+    IdPicker(const IdPicker&) = delete;
+    IdPicker& operator=(const IdPicker&) = delete;
+
+    void init();
+    void release();
+
+    // binds the id target (resized to width x height if needed) and clears pixel (x, y);
+    // only that pixel is rasterized until end(), pickable objects are drawn in between
+    void begin(GLsizei width, GLsizei height, GLint x, GLint y);
+    // queues the readback of the pixel and binds the default framebuffer again;
+    // if every buffer is still in flight the readback of this frame is skipped
+    void end(int tag = 0);
+
+    // newest result that has arrived since the last call, false if there is none
+    bool poll(Result& result);
+    // drops the readbacks in flight, e.g. when the ids they carry belong to a mesh that was replaced
+    void reset();
+
+private:
+    static const int slotCount = 3;
+
+    GLuint FBO{};
+    GLuint colorBuffer{};
+    GLuint depthBuffer{};
+    GLsizei width{};
+    GLsizei height{};
+    GLint pixelX{};
+    GLint pixelY{};
+    GLint viewport[4]{};
+
+    Buffer PBO[slotCount];
+    GLsync fences[slotCount]{};
+    int tags[slotCount]{};
+    unsigned int frames[slotCount]{};
+    int next{};                 // slot of the next readback
+    unsigned int frame{};       // number of end() calls
+
+    void resize(GLsizei width, GLsizei height);
+};
+
+#endif
\ No newline at end of file
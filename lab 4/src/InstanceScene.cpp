@@ -0,0 +1,299 @@
+#include "InstanceScene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+    // positions and colors, every shape fits into [-0.5, 0.5]^3
+    const GLfloat tetrahedronVertices[] = {
+         0.5f,  0.5f,  0.5f,  1.0f, 0.2f, 0.2f,
+        -0.5f, -0.5f,  0.5f,  0.2f, 1.0f, 0.2f,
+        -0.5f,  0.5f, -0.5f,  0.2f, 0.2f, 1.0f,
+         0.5f, -0.5f, -0.5f,  1.0f, 1.0f, 0.2f
+    };
+    const GLuint tetrahedronIndices[] = { 0, 1, 3,  0, 2, 1,  0, 3, 2,  1, 2, 3 };
+
+    const GLfloat pyramidVertices[] = {
+         0.5f, -0.5f,  0.5f,  0.0f, 1.0f, 0.0f,
+         0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 1.0f,
+        -0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,
+        -0.5f, -0.5f,  0.5f,  1.0f, 1.0f, 0.0f,
+         0.0f,  0.5f,  0.0f,  1.0f, 0.0f, 1.0f
+    };
+    const GLuint pyramidIndices[] = { 0, 1, 2,  2, 3, 0,  1, 2, 4,  2, 3, 4,  3, 0, 4,  0, 1, 4 };
+
+    const GLfloat cubeVertices[] = {
+        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f, 0.0f,
+         0.5f, -0.5f, -0.5f,  1.0f, 0.0f, 0.0f,
+         0.5f,  0.5f, -0.5f,  1.0f, 1.0f, 0.0f,
+        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f, 0.0f,
+        -0.5f, -0.5f,  0.5f,  0.0f, 0.0f, 1.0f,
+         0.5f, -0.5f,  0.5f,  1.0f, 0.0f, 1.0f,
+         0.5f,  0.5f,  0.5f,  1.0f, 1.0f, 1.0f,
+        -0.5f,  0.5f,  0.5f,  0.0f, 1.0f, 1.0f
+    };
+    const GLuint cubeIndices[] = {
+        0, 2, 1,  0, 3, 2,  4, 5, 6,  4, 6, 7,  0, 1, 5,  0, 5, 4,
+        3, 6, 2,  3, 7, 6,  0, 4, 7,  0, 7, 3,  1, 2, 6,  1, 6, 5
+    };
+
+    const GLfloat octahedronVertices[] = {
+         0.5f,  0.0f,  0.0f,  1.0f, 0.5f, 0.0f,
+        -0.5f,  0.0f,  0.0f,  0.0f, 0.5f, 1.0f,
+         0.0f,  0.5f,  0.0f,  1.0f, 1.0f, 1.0f,
+         0.0f, -0.5f,  0.0f,  0.3f, 0.3f, 0.3f,
+         0.0f,  0.0f,  0.5f,  0.5f, 1.0f, 0.0f,
+         0.0f,  0.0f, -0.5f,  0.5f, 0.0f, 1.0f
+    };
+    const GLuint octahedronIndices[] = {
+        0, 2, 4,  4, 2, 1,  1, 2, 5,  5, 2, 0,
+        0, 4, 3,  4, 1, 3,  1, 5, 3,  5, 0, 3
+    };
+
+    struct Shape {
+        const GLfloat* vertices;
+        GLsizei vertexCount;
+        const GLuint* indices;
+        GLsizei indexCount;
+    };
+
+    const Shape shapes[InstanceScene::shapeCount] = {
+        { tetrahedronVertices, 4, tetrahedronIndices, 12 },
+        { pyramidVertices,     5, pyramidIndices,     18 },
+        { cubeVertices,        8, cubeIndices,        36 },
+        { octahedronVertices,  6, octahedronIndices,  24 }
+    };
+
+    const size_t grain = 4096;
+}
+
+InstanceScene::~InstanceScene() {
+    release();
+}
+
+void InstanceScene::init() {
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    for (int i = 0; i < shapeCount; i++) {
+        const Shape& shape = shapes[i];
+        commands[i] = { static_cast<GLuint>(shape.indexCount), 0, static_cast<GLuint>(indices.size()), static_cast<GLint>(vertices.size() / 6), 0 };
+        vertices.insert(vertices.end(), shape.vertices, shape.vertices + 6 * shape.vertexCount);
+        indices.insert(indices.end(), shape.indices, shape.indices + shape.indexCount);
+    }
+
+    VBO.storage(sizeof(GLfloat) * vertices.size(), vertices.data());
+    EBO.storage(sizeof(GLuint) * indices.size(), indices.data());
+    VAO.create();
+    VAO.vertexBuffer(0, VBO, 0, VAO.floatAttributes(0, { 3, 3 }));
+    VAO.elementBuffer(EBO);
+
+    commandBuffer.storage(sizeof(commands), commands, GL_DYNAMIC_STORAGE_BIT);
+
+    for (int i = 0; i < shapeCount; i++) {
+        shapeRadius[i] = 0.0f;
+        for (GLsizei v = 0; v < shapes[i].vertexCount; v++) {
+            const GLfloat* position = shapes[i].vertices + 6 * v;
+            shapeRadius[i] = std::max(shapeRadius[i], glm::length(glm::vec3(position[0], position[1], position[2])));
+        }
+    }
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+}
+
+void InstanceScene::release() {
+    VBO.release();
+    EBO.release();
+    VAO.release();
+    modelBuffer.release();
+    commandBuffer.release();
+    for (int i = 0; i < frameCount; i++) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+    visibleBuffer.release();
+    cullBuffer.release();
+    visibleMapped = nullptr;
+    cullMapped = nullptr;
+    culledFrame = false;
+    models.clear();
+    models.shrink_to_fit();
+    spheres.resize(0);
+    chunks.clear();
+    stats = Statistics();
+}
+
+void InstanceScene::generate(size_t count, ThreadPool& pool) {
+    auto start = std::chrono::steady_clock::now();
+
+    models.resize(count);
+    spheres.resize(count);
+    chunks.clear();
+    stats.triangles = 0;
+    for (int i = 0; i < shapeCount; i++) {
+        size_t first = count * i / shapeCount;
+        size_t last = count * (i + 1) / shapeCount;
+        commands[i].instanceCount = static_cast<GLuint>(last - first);
+        commands[i].baseInstance = static_cast<GLuint>(first);
+        stats.triangles += (last - first) * commands[i].count / 3;
+        for (size_t chunk = first; chunk < last; chunk += grain) {
+            chunks.push_back({ chunk, std::min(chunk + grain, last), i });
+        }
+    }
+    chunkVisible.assign(chunks.size(), 0);
+
+    const size_t side = std::max<size_t>(1, static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(count)))));
+    pool.parallelFor(count, grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            glm::vec3 cell(static_cast<float>(i % side), static_cast<float>(i / (side * side)), static_cast<float>(i / side % side));
+            // golden angle steps, so that neighbours do not look alike
+            float angle = 2.39996323f * static_cast<float>(i);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), origin + spacing * cell);
+            model = glm::rotate(model, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+            models[i] = glm::scale(model, glm::vec3(size));
+            updateSphere(i);
+        }
+    });
+
+    commandBuffer.update(0, sizeof(commands), commands);
+
+    // storage is immutable, so a new count gets a new buffer
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(sizeof(glm::mat4) * std::max<size_t>(count, 1));
+    if (modelBuffer.size() != bytes) {
+        modelBuffer.storage(bytes, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    }
+    if (count) {
+        modelBuffer.update(0, sizeof(glm::mat4) * count, models.data());
+    }
+    allocateCulling();
+
+    stats.generateTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void InstanceScene::transform(size_t first, size_t last, const glm::mat4& left, const glm::mat4& right, ThreadPool& pool) {
+    last = std::min(last, models.size());
+    if (first >= last) { return; }
+
+    auto start = std::chrono::steady_clock::now();
+    glm::mat4* range = models.data() + first;
+    pool.parallelFor(last - first, grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            range[i] = left * range[i] * right;
+            updateSphere(first + i);
+        }
+    });
+    auto transformed = std::chrono::steady_clock::now();
+
+    modelBuffer.update(sizeof(glm::mat4) * first, sizeof(glm::mat4) * (last - first), range);
+
+    stats.transformTime = std::chrono::duration<float, std::milli>(transformed - start).count();
+    stats.uploadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - transformed).count();
+}
+
+void InstanceScene::updateSphere(size_t instance) {
+    int shape = shapeCount - 1;
+    while (instance < commands[shape].baseInstance) {
+        shape--;
+    }
+    // the longest axis of the model bounds how far it can move a vertex from the center
+    const glm::mat4& model = models[instance];
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    spheres.set(instance, glm::vec3(model[3]), shapeRadius[shape] * scale);
+}
+
+void InstanceScene::allocateCulling() {
+    for (int i = 0; i < frameCount; i++) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+    frame = 0;
+    culledFrame = false;
+
+    // every frame has its own list of visible instances and its own commands, the lists start on
+    // offsets that can be bound as a shader storage buffer
+    GLsizeiptr listBytes = static_cast<GLsizeiptr>(sizeof(uint32_t) * std::max<size_t>(models.size(), 1));
+    visibleRegion = (listBytes + storageAlignment - 1) / storageAlignment * storageAlignment;
+    cullRegion = static_cast<GLsizeiptr>(sizeof(DrawCommand) * std::max<size_t>(chunks.size(), 1));
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    visibleBuffer.storage(visibleRegion * frameCount, nullptr, flags);
+    visibleMapped = static_cast<uint32_t*>(visibleBuffer.map(0, visibleRegion * frameCount, flags));
+    cullBuffer.storage(cullRegion * frameCount, nullptr, flags);
+    cullMapped = static_cast<DrawCommand*>(cullBuffer.map(0, cullRegion * frameCount, flags));
+}
+
+void InstanceScene::waitFence(int index) {
+    if (!fences[index]) { return; }
+
+    GLenum result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+    glDeleteSync(fences[index]);
+    fences[index] = nullptr;
+}
+
+void InstanceScene::cull(const glm::mat4& viewProjection, ThreadPool& pool, RayKernel kernel) {
+    if (models.empty()) { return; }
+
+    auto start = std::chrono::steady_clock::now();
+    waitFence(frame);
+    spheres.setFrustum(viewProjection);
+
+    // a chunk owns the entries of the list from its first instance on, so the chunks need no
+    // prefix sum and the threads write straight into the mapped memory
+    uint32_t* visible = visibleMapped + frame * visibleRegion / sizeof(uint32_t);
+    DrawCommand* culledCommands = cullMapped + frame * cullRegion / sizeof(DrawCommand);
+    pool.parallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; c++) {
+            const Chunk& chunk = chunks[c];
+            size_t n = spheres.cull(chunk.first, chunk.last, visible + chunk.first, kernel);
+            const DrawCommand& command = commands[chunk.shape];
+            culledCommands[c] = { command.count, static_cast<GLuint>(n), command.firstIndex, command.baseVertex, static_cast<GLuint>(chunk.first) };
+            chunkVisible[c] = n;
+        }
+    });
+
+    stats.visible = 0;
+    for (size_t n : chunkVisible) {
+        stats.visible += n;
+    }
+    stats.culled = models.size() - stats.visible;
+    stats.cullTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    culledFrame = true;
+}
+
+void InstanceScene::submit(RenderQueue& queue, const ShaderProgram& shader) {
+    if (models.empty()) { return; }
+
+    shader.setBool("culled", culledFrame);
+    modelBuffer.bindBase(GL_SHADER_STORAGE_BUFFER, modelBinding);
+
+    RenderQueue::Packet packet;
+    packet.program = &shader;
+    packet.vertexArray = &VAO;
+    packet.indexType = GL_UNSIGNED_INT;
+    if (!culledFrame) {
+        packet.indirect = &commandBuffer;
+        packet.count = shapeCount;
+    }
+    else {
+        visibleBuffer.bindRange(GL_SHADER_STORAGE_BUFFER, visibleBinding, frame * visibleRegion, visibleRegion);
+        packet.indirect = &cullBuffer;
+        packet.first = static_cast<GLint>(frame * cullRegion);
+        packet.count = static_cast<GLsizei>(chunks.size());
+    }
+    queue.submit(RenderQueue::Layer::Opaque, 0.0f, packet);
+}
+
+void InstanceScene::endFrame() {
+    if (!culledFrame) { return; }
+
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % frameCount;
+    culledFrame = false;
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#ifndef _InstanceScene_h_
+#define _InstanceScene_h_
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "FrustumCuller.h"
+#include "GLObjects.h"
+#include "RenderQueue.h"
+#include "ShaderProgram.h"
+#include "ThreadPool.h"
+
+// many polyhedra (tetrahedra, pyramids, cubes, octahedra) drawn by one glMultiDrawElementsIndirect.
+// The shapes share one vertex and one index buffer and the model matrices of all instances live in a
+// shader storage buffer (binding 1, see instance.vs). The instances of one shape are consecutive, so
+// every shape is one indirect command whose baseInstance is its first instance.
+// Instances are placed on a grid, instance i in cell i, and are transformed in ranges of indices.
+// With culling, every instance has a bounding sphere and the instances of a shape are split into
+// chunks; each chunk is culled on its own thread and becomes its own command, which draws the
+// visible instances listed from its first instance on in a second storage buffer (binding 2)
+class InstanceScene {
+public:
+    static const int shapeCount = 4;
+    static const GLuint modelBinding = 1;
+    static const GLuint visibleBinding = 2;
+
+    struct Statistics {
+        size_t triangles;      // drawn per frame
+        float generateTime;    // ms, placement and upload of the last generate()
+        float transformTime;   // ms, matrix products of the last transform()
+        float uploadTime;      // ms, buffer update of the last transform()
+        size_t visible;        // instances that passed the last cull()
+        size_t culled;         // instances that the last cull() removed
+        float cullTime;        // ms, sphere tests and command writes of the last cull()
+    };
+
+    glm::vec3 origin{ 2.0f, 0.0f, 2.0f }; // center of the first cell
+    float spacing = 1.0f;                 // distance between cells
+    float size = 0.4f;                    // scale of the shapes, which fit into a unit cube
+
+    InstanceScene() = default;
+    ~InstanceScene();
+
+    InstanceScene(const InstanceScene&) = delete;
+    InstanceScene& operator=(const InstanceScene&) = delete;
+
+    // builds the shared mesh of the shapes
+    void init();
+    void release();
+
+    // replaces all instances by count new ones, the shape changes every count / shapeCount instances
+    void generate(size_t count, ThreadPool& pool);
+    // models[i] = left * models[i] * right for i in [first, last), then uploads the range;
+    // left acts in world space (rotation about an axis), right in the space of the shape
+    void transform(size_t first, size_t last, const glm::mat4& left, const glm::mat4& right, ThreadPool& pool);
+
+    // tests the bounding spheres against the frustum of viewProjection (perspective or orthographic)
+    // and writes the visible lists and the commands of the next draw() to mapped buffers
+    void cull(const glm::mat4& viewProjection, ThreadPool& pool, RayKernel kernel = TriangleBlocks::bestKernel());
+    // queues one packet that draws the instances that passed cull() if it was called since the last
+    // endFrame(), otherwise all of them; binds the storage buffers, which the queue leaves alone
+    void submit(RenderQueue& queue, const ShaderProgram& shader);
+    // fences the culling region that the executed packet reads and moves to the next one
+    void endFrame();
+
+    size_t instanceCount() const { return models.size(); }
+    const glm::mat4& model(size_t instance) const { return models[instance]; }
+    const Statistics& statistics() const { return stats; }
+
+private:
+    // layout of glMultiDrawElementsIndirect
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // consecutive instances of one shape that are culled and drawn together
+    struct Chunk {
+        size_t first, last;
+        int shape;
+    };
+
+    // regions of the culling buffers in flight, as in StreamBuffer
+    static const int frameCount = 3;
+
+    Buffer VBO;
+    Buffer EBO;
+    VertexArray VAO;
+    Buffer modelBuffer;
+    Buffer commandBuffer;
+
+    Buffer visibleBuffer;
+    Buffer cullBuffer;
+
+    DrawCommand commands[shapeCount]{};
+    std::vector<glm::mat4> models;
+    Statistics stats{};
+
+    float shapeRadius[shapeCount]{};   // bounding spheres of the shapes around their origin
+    FrustumCuller spheres;
+    std::vector<Chunk> chunks;
+    std::vector<size_t> chunkVisible;
+    GLint storageAlignment{ 1 };
+    GLsizeiptr visibleRegion{};        // bytes per frame, a multiple of storageAlignment
+    GLsizeiptr cullRegion{};
+    uint32_t* visibleMapped{};
+    DrawCommand* cullMapped{};
+    GLsync fences[frameCount]{};
+    int frame{};
+    bool culledFrame{ false };
+
+    void updateSphere(size_t instance);
+    void allocateCulling();
+    void waitFence(int index);
+};
+
+#endif
\ No newline at end of file
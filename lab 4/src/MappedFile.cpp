@@ -0,0 +1,96 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) { return false; }
+    file = handle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(handle, &fileSize)) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+    opened = true;
+    if (length == 0) { return true; }
+
+    mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+    descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) { return false; }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(status.st_size);
+    opened = true;
+    if (length == 0) { return true; }
+
+    void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (address == MAP_FAILED) {
+        close();
+        return false;
+    }
+    // the whole file is going to be read by a few threads at once
+    madvise(address, length, MADV_WILLNEED);
+    view = static_cast<const char*>(address);
+#endif
+
+    if (!view) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (view) {
+        UnmapViewOfFile(view);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (file) {
+        CloseHandle(file);
+        file = nullptr;
+    }
+#else
+    if (view) {
+        munmap(const_cast<char*>(view), length);
+    }
+    if (descriptor >= 0) {
+        ::close(descriptor);
+        descriptor = -1;
+    }
+#endif
+    view = nullptr;
+    length = 0;
+    opened = false;
+}
\ No newline at end of file
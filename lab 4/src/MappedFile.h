@@ -0,0 +1,35 @@
+#ifndef _MappedFile_h_
+#define _MappedFile_h_
+
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const { return view; }
+    size_t size() const { return length; }
+    bool isOpen() const { return opened; }
+
+private:
+    const char* view{};
+    size_t length{};
+    bool opened{}; // an empty file is open but has no view
+#ifdef _WIN32
+    void* file{};
+    void* mapping{};
+#else
+    int descriptor{ -1 };
+#endif
+};
+
+#endif
\ No newline at end of file
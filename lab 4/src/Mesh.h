@@ -0,0 +1,37 @@
+#ifndef _Mesh_h_
+#define _Mesh_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// indexed triangle mesh
+struct Mesh {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;   // empty or one per position
+    std::vector<uint32_t> indices;   // 3 per triangle
+    glm::vec3 min{ 0.0f };           // bounds of the positions
+    glm::vec3 max{ 0.0f };
+
+    size_t vertexCount() const { return positions.size(); }
+    size_t triangleCount() const { return indices.size() / 3; }
+    bool empty() const { return indices.empty(); }
+
+    void clear() {
+        positions.clear();
+        colors.clear();
+        indices.clear();
+        min = max = glm::vec3(0.0f);
+    }
+
+    void computeBounds() {
+        min = max = positions.empty() ? glm::vec3(0.0f) : positions.front();
+        for (const glm::vec3& p : positions) {
+            min = glm::min(min, p);
+            max = glm::max(max, p);
+        }
+    }
+};
+
+#endif
\ No newline at end of file
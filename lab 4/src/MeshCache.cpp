@@ -0,0 +1,299 @@
+#include "MeshCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+const char magic[8] = { 'C', 'G', 'M', 'E', 'S', 'H', '\0', '\0' };
+const float quantizationSteps = 65535.0f;
+
+uint64_t aligned(uint64_t offset) {
+    return (offset + MeshCache::sectionAlignment - 1) / MeshCache::sectionAlignment * MeshCache::sectionAlignment;
+}
+
+// unit vector -> point of the octahedron |x| + |y| + |z| = 1 unfolded onto [-1, 1]^2
+glm::vec2 octahedral(glm::vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return p;
+}
+
+uint32_t flagsOf(const MeshCache::Options& options) {
+    uint32_t flags = 0;
+    if (options.quantizePositions) { flags |= MeshCache::QuantizedPositions; }
+    if (options.normals) { flags |= MeshCache::Normals; }
+    if (options.optimize) { flags |= MeshCache::Optimized; }
+    return flags;
+}
+
+bool contains(const MeshCache::Section& section, size_t fileSize) {
+    return section.offset % MeshCache::sectionAlignment == 0 && section.offset <= fileSize && section.size <= fileSize - section.offset;
+}
+
+}
+
+bool MeshCache::load(const std::string& source, MeshImporter& importer, const Options& options, std::string& error) {
+    statistics = Statistics{};
+
+    std::error_code code;
+    const uint64_t sourceSize = std::filesystem::file_size(source, code);
+    if (code) {
+        error = "cannot open " + source;
+        return false;
+    }
+    const int64_t sourceTime = static_cast<int64_t>(std::filesystem::last_write_time(source, code).time_since_epoch().count());
+    statistics.sourceBytes = static_cast<size_t>(sourceSize);
+
+    const std::string path = cachePath(source);
+    auto start = std::chrono::steady_clock::now();
+    std::string ignored;
+    if (open(path, ignored) && head->sourceSize == sourceSize && head->sourceTime == sourceTime
+        && (head->flags & (QuantizedPositions | Normals | Optimized)) == flagsOf(options)) {
+        statistics.fromCache = true;
+        statistics.mapTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        statistics.cacheBytes = file.size();
+        return true;
+    }
+    close();
+
+    Mesh mesh;
+    if (!importer.load(source, mesh, error)) { return false; }
+    statistics.importTime = importer.statistics.totalTime;
+    if (options.optimize) {
+        // the fetch is measured for the position stream, the largest one
+        MeshOptimizer optimizer;
+        optimizer.optimize(mesh, options.quantizePositions ? 4 * sizeof(uint16_t) : 3 * sizeof(float));
+        statistics.optimization = optimizer.statistics;
+    }
+
+    start = std::chrono::steady_clock::now();
+    if (!write(path, mesh, options, sourceSize, sourceTime, error)) { return false; }
+    mesh.clear();
+    auto written = std::chrono::steady_clock::now();
+    if (!open(path, error)) { return false; }
+    statistics.writeTime = std::chrono::duration<float, std::milli>(written - start).count();
+    statistics.mapTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - written).count();
+    statistics.cacheBytes = file.size();
+    return true;
+}
+
+bool MeshCache::write(const std::string& path, const Mesh& mesh, const Options& options, uint64_t sourceSize, int64_t sourceTime, std::string& error) {
+    const size_t count = mesh.vertexCount();
+    const glm::vec3 extent = mesh.max - mesh.min;
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.flags = flagsOf(options);
+    if (!mesh.colors.empty()) {
+        header.flags |= SourceColors;
+    }
+    header.vertexCount = count;
+    header.indexCount = mesh.indices.size();
+    for (int k = 0; k < 3; k++) {
+        header.min[k] = mesh.min[k];
+        header.max[k] = mesh.max[k];
+    }
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+
+    header.positions = { aligned(sizeof(Header)), count * (options.quantizePositions ? 4 * sizeof(uint16_t) : 3 * sizeof(float)) };
+    header.colors = { aligned(header.positions.offset + header.positions.size), count * 4 };
+    header.normals = { aligned(header.colors.offset + header.colors.size), options.normals ? count * 2 * sizeof(int16_t) : 0 };
+    header.indices = { aligned(header.normals.offset + header.normals.size), mesh.indices.size() * sizeof(uint32_t) };
+
+    const std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "cannot write " + temporary;
+        return false;
+    }
+
+    std::vector<char> buffer;
+    auto section = [&](const Section& section) {
+        // zeros up to the start of the section
+        buffer.assign(static_cast<size_t>(section.offset - out.tellp()), 0);
+        out.write(buffer.data(), buffer.size());
+        buffer.resize(static_cast<size_t>(section.size));
+        return buffer.data();
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    char* data = section(header.positions);
+    if (options.quantizePositions) {
+        uint16_t* positions = reinterpret_cast<uint16_t*>(data);
+        const glm::vec3 scale = glm::vec3(
+            extent.x > 0.0f ? quantizationSteps / extent.x : 0.0f,
+            extent.y > 0.0f ? quantizationSteps / extent.y : 0.0f,
+            extent.z > 0.0f ? quantizationSteps / extent.z : 0.0f);
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 q = glm::clamp((mesh.positions[i] - mesh.min) * scale, 0.0f, quantizationSteps);
+            for (int k = 0; k < 3; k++) {
+                positions[4 * i + k] = static_cast<uint16_t>(std::lround(q[k]));
+            }
+            positions[4 * i + 3] = 0;
+        }
+    }
+    else {
+        std::memcpy(data, mesh.positions.data(), buffer.size());
+    }
+    out.write(buffer.data(), buffer.size());
+
+    data = section(header.colors);
+    const glm::vec3 colorExtent = glm::max(extent, glm::vec3(1e-20f));
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 color = mesh.colors.empty() ? (mesh.positions[i] - mesh.min) / colorExtent : mesh.colors[i];
+        color = glm::clamp(color, 0.0f, 1.0f);
+        unsigned char* rgba = reinterpret_cast<unsigned char*>(data) + 4 * i;
+        for (int k = 0; k < 3; k++) {
+            rgba[k] = static_cast<unsigned char>(std::lround(255.0f * color[k]));
+        }
+        rgba[3] = 255;
+    }
+    out.write(buffer.data(), buffer.size());
+
+    if (options.normals) {
+        // area weighted sums of the normals of the adjacent triangles
+        std::vector<glm::vec3> normals(count, glm::vec3(0.0f));
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            uint32_t a = mesh.indices[t], b = mesh.indices[t + 1], c = mesh.indices[t + 2];
+            glm::vec3 normal = glm::cross(mesh.positions[b] - mesh.positions[a], mesh.positions[c] - mesh.positions[a]);
+            normals[a] += normal;
+            normals[b] += normal;
+            normals[c] += normal;
+        }
+        data = section(header.normals);
+        int16_t* encoded = reinterpret_cast<int16_t*>(data);
+        for (size_t i = 0; i < count; i++) {
+            glm::vec2 p = normals[i] == glm::vec3(0.0f) ? glm::vec2(0.0f, 0.0f) : octahedral(normals[i]);
+            encoded[2 * i] = static_cast<int16_t>(std::lround(glm::clamp(p.x, -1.0f, 1.0f) * 32767.0f));
+            encoded[2 * i + 1] = static_cast<int16_t>(std::lround(glm::clamp(p.y, -1.0f, 1.0f) * 32767.0f));
+        }
+        out.write(buffer.data(), buffer.size());
+    }
+
+    data = section(header.indices);
+    std::memcpy(data, mesh.indices.data(), buffer.size());
+    out.write(buffer.data(), buffer.size());
+
+    out.close();
+    if (!out) {
+        error = "cannot write " + temporary;
+        std::filesystem::remove(temporary);
+        return false;
+    }
+
+    std::error_code code;
+    std::filesystem::rename(temporary, path, code);
+    if (code) {
+        error = "cannot replace " + path + ": " + code.message();
+        std::filesystem::remove(temporary, code);
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::open(const std::string& path, std::string& error) {
+    close();
+
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const size_t size = file.size();
+    const Header* header = reinterpret_cast<const Header*>(file.data());
+    if (size < sizeof(Header) || std::memcmp(header->magic, magic, sizeof(magic)) != 0) {
+        error = path + " is not a mesh cache";
+        close();
+        return false;
+    }
+    if (header->version != version) {
+        error = path + " has version " + std::to_string(header->version) + " instead of " + std::to_string(version);
+        close();
+        return false;
+    }
+
+    const bool quantized = (header->flags & QuantizedPositions) != 0;
+    const bool normals = (header->flags & Normals) != 0;
+    const uint64_t count = header->vertexCount;
+    if (!contains(header->positions, size) || !contains(header->colors, size) || !contains(header->normals, size) || !contains(header->indices, size)
+        || header->positions.size != count * (quantized ? 4 * sizeof(uint16_t) : 3 * sizeof(float))
+        || header->colors.size != count * 4
+        || header->normals.size != (normals ? count * 2 * sizeof(int16_t) : 0)
+        || header->indices.size != header->indexCount * sizeof(uint32_t) || header->indexCount % 3 != 0) {
+        error = path + " is damaged";
+        close();
+        return false;
+    }
+    if (header->indexCount == 0) {
+        // written before empty meshes were rejected by the importer
+        error = path + " has no faces";
+        close();
+        return false;
+    }
+
+    // decode, the picking gather and the gpu read vertices through the indices without a check,
+    // so a damaged index section must not get past this point
+    const uint32_t* indices = reinterpret_cast<const uint32_t*>(file.data() + header->indices.offset);
+    uint32_t largest = 0;
+    for (uint64_t i = 0; i < header->indexCount; i++) {
+        largest = std::max(largest, indices[i]);
+    }
+    if (largest >= count) {
+        error = path + " is damaged";
+        close();
+        return false;
+    }
+
+    head = header;
+    return true;
+}
+
+void MeshCache::close() {
+    head = nullptr;
+    file.close();
+}
+
+glm::mat4 MeshCache::decoding() const {
+    if (!(head->flags & QuantizedPositions)) {
+        return glm::mat4(1.0f);
+    }
+    // the vertex shader reads the normalized integers as 0..1
+    glm::vec3 min(head->min[0], head->min[1], head->min[2]);
+    glm::vec3 max(head->max[0], head->max[1], head->max[2]);
+    return glm::scale(glm::translate(glm::mat4(1.0f), min), max - min);
+}
+
+void MeshCache::decode(Mesh& mesh) const {
+    const size_t count = static_cast<size_t>(head->vertexCount);
+    mesh.clear();
+    mesh.positions.resize(count);
+    mesh.min = glm::vec3(head->min[0], head->min[1], head->min[2]);
+    mesh.max = glm::vec3(head->max[0], head->max[1], head->max[2]);
+
+    const char* positions = file.data() + head->positions.offset;
+    if (head->flags & QuantizedPositions) {
+        const glm::vec3 step = (mesh.max - mesh.min) / quantizationSteps;
+        for (size_t i = 0; i < count; i++) {
+            uint16_t q[4];
+            std::memcpy(q, positions + 8 * i, sizeof(q));
+            mesh.positions[i] = mesh.min + glm::vec3(q[0], q[1], q[2]) * step;
+        }
+    }
+    else {
+        std::memcpy(mesh.positions.data(), positions, static_cast<size_t>(head->positions.size));
+    }
+
+    mesh.indices.resize(static_cast<size_t>(head->indexCount));
+    std::memcpy(mesh.indices.data(), file.data() + head->indices.offset, static_cast<size_t>(head->indices.size));
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef _MeshImporter_h_
+#define _MeshImporter_h_
+
+#include <cstddef>
+#include <string>
+
+#include "Mesh.h"
+#include "ThreadPool.h"
+
+// OBJ and PLY (ascii, binary little and big endian) loader. The file is memory mapped and cut into
+// chunks at line boundaries which are parsed in parallel with std::from_chars; afterwards equal
+// vertices are welded through a hash table and degenerate triangles are dropped.
+// OBJ: "v x y z [r g b]" and "f a[/b[/c]] ..." with negative (relative) indices, polygons are fanned.
+// PLY: vertex x, y, z and optional red, green, blue; face vertex_indices (or vertex_index).
+class MeshImporter {
+public:
+    struct Statistics {
+        size_t bytes;
+        size_t verticesRead;
+        size_t trianglesRead;
+        size_t weldedVertices;       // vertices removed by welding
+        size_t degenerateTriangles;  // triangles removed
+        float parseTime;             // ms
+        float weldTime;              // ms
+        float totalTime;             // ms, including the mapping of the file
+
+        float megabytesPerSecond() const { return totalTime > 0.0f ? bytes / (totalTime * 1000.0f) : 0.0f; }
+    };
+
+    Statistics statistics{};
+
+    explicit MeshImporter(ThreadPool* pool = nullptr);
+
+    // the format is chosen by the extension; on failure mesh is not changed and error describes the problem
+    bool load(const std::string& path, Mesh& mesh, std::string& error);
+    bool loadObj(const char* data, size_t size, Mesh& mesh, std::string& error);
+    bool loadPly(const char* data, size_t size, Mesh& mesh, std::string& error);
+
+private:
+    static const size_t chunkSize = 1 << 20;
+
+    ThreadPool* pool;
+
+    // calls f(begin, end) on the pool if there is one
+    template <typename F>
+    void parallelFor(size_t count, size_t grain, F&& f) {
+        if (pool) {
+            pool->parallelFor(count, grain, f);
+        }
+        else if (count > 0) {
+            f(0, count);
+        }
+    }
+
+    // raw is consumed, mesh receives the welded vertices and the remaining triangles;
+    // fails without changing mesh if no triangle remains
+    bool weld(Mesh& raw, Mesh& mesh, std::string& error);
+};
+
+#endif
\ No newline at end of file
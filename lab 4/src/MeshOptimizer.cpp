@@ -0,0 +1,320 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+const uint32_t unusedVertex = 0xFFFFFFFF;
+
+// fifo cache with time stamps: a vertex is in the cache if fewer than size misses happened since it was
+// loaded; advancing the time by more than size empties it
+struct FifoCache {
+    std::vector<uint32_t> stamps;
+    uint32_t time;
+    uint32_t size;
+
+    FifoCache(size_t entries, uint32_t _size) : stamps(entries, 0), time(_size + 1), size(_size) {}
+
+    // true on a miss
+    bool access(uint32_t entry) {
+        if (time - stamps[entry] > size) {
+            stamps[entry] = time++;
+            return true;
+        }
+        return false;
+    }
+
+    void clear() { time += size + 1; }
+};
+
+}
+
+void MeshOptimizer::optimize(Mesh& mesh, size_t vertexSize) {
+    auto start = std::chrono::steady_clock::now();
+    const size_t vertexCount = mesh.vertexCount();
+    statistics = Statistics{};
+    statistics.cacheBefore = analyzeCache(mesh.indices, vertexCount);
+    statistics.overfetchBefore = analyzeFetch(mesh.indices, vertexCount, vertexSize);
+
+    std::vector<uint32_t> order, clusters;
+    tipsify(mesh.indices, vertexCount, order, clusters);
+    std::vector<uint32_t> ordered(mesh.indices.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        for (int k = 0; k < 3; k++) {
+            ordered[3 * i + k] = mesh.indices[3 * static_cast<size_t>(order[i]) + k];
+        }
+    }
+    order.clear();
+    order.shrink_to_fit();
+
+    splitClusters(ordered, vertexCount, clusters, 1.05f);
+    sortClusters(mesh, ordered, clusters);
+    std::vector<uint32_t> remap;
+    const size_t used = remapVertices(ordered, vertexCount, remap);
+
+    // the new order is measured before the mesh is touched: input that is already in a good order
+    // for one of the caches (a row-major grid for the fetch) can get worse there and is kept as it is
+    statistics.clusters = clusters.size();
+    statistics.cacheAfter = analyzeCache(ordered, used);
+    statistics.overfetchAfter = analyzeFetch(ordered, used, vertexSize);
+    const CacheStatistics& before = statistics.cacheBefore;
+    const CacheStatistics& after = statistics.cacheAfter;
+    statistics.applied = after.acmr <= before.acmr && statistics.overfetchAfter <= statistics.overfetchBefore
+        && (after.acmr < before.acmr || statistics.overfetchAfter < statistics.overfetchBefore);
+    if (statistics.applied) {
+        mesh.indices = std::move(ordered);
+        reorderVertices(mesh, remap, used);
+        mesh.computeBounds();
+    }
+    statistics.time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+MeshOptimizer::CacheStatistics MeshOptimizer::analyzeCache(const std::vector<uint32_t>& indices, size_t vertexCount) {
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t misses = 0, unique = 0;
+    for (uint32_t v : indices) {
+        misses += cache.access(v);
+        if (!referenced[v]) {
+            referenced[v] = true;
+            unique++;
+        }
+    }
+
+    CacheStatistics result{};
+    if (indices.size() >= 3) {
+        result.acmr = static_cast<float>(misses) / (indices.size() / 3);
+        result.atvr = static_cast<float>(misses) / unique;
+    }
+    return result;
+}
+
+float MeshOptimizer::analyzeFetch(const std::vector<uint32_t>& indices, size_t vertexCount, size_t vertexSize) {
+    // only vertices missing in the post-transform cache are fetched
+    FifoCache transformed(vertexCount, cacheSize);
+    FifoCache lines((vertexCount * vertexSize + fetchLineSize - 1) / fetchLineSize, fetchLineCount);
+    std::vector<bool> referenced(vertexCount, false);
+    size_t fetched = 0, unique = 0;
+    for (uint32_t v : indices) {
+        if (!referenced[v]) {
+            referenced[v] = true;
+            unique++;
+        }
+        if (!transformed.access(v)) { continue; }
+
+        size_t first = v * vertexSize / fetchLineSize;
+        size_t last = ((v + 1) * vertexSize - 1) / fetchLineSize;
+        for (size_t line = first; line <= last; line++) {
+            fetched += lines.access(static_cast<uint32_t>(line)) ? fetchLineSize : 0;
+        }
+    }
+    return unique ? static_cast<float>(fetched) / (unique * vertexSize) : 0.0f;
+}
+
+void MeshOptimizer::tipsify(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& order, std::vector<uint32_t>& clusters) {
+    const size_t triangleCount = indices.size() / 3;
+    order.clear();
+    order.reserve(triangleCount);
+    clusters.clear();
+    if (triangleCount == 0) { return; }
+
+    // triangles around every vertex and the number of them that are not emitted yet
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (uint32_t v : indices) {
+        live[v]++;
+    }
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    const uint32_t size = cacheSize;
+    std::vector<uint32_t> stamps(vertexCount, 0);
+    uint32_t time = size + 1;
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    size_t cursor = 0;
+
+    auto nextLive = [&]() -> int64_t {
+        while (cursor < vertexCount) {
+            if (live[cursor] > 0) { return static_cast<int64_t>(cursor); }
+            cursor++;
+        }
+        return -1;
+    };
+
+    int64_t fan = nextLive();
+    clusters.push_back(0);
+    while (fan >= 0) {
+        // all remaining triangles around the fanning vertex
+        candidates.clear();
+        for (size_t k = offsets[fan]; k < offsets[fan + 1]; k++) {
+            uint32_t t = adjacency[k];
+            if (emitted[t]) { continue; }
+            emitted[t] = true;
+            order.push_back(t);
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = indices[3 * static_cast<size_t>(t) + c];
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - stamps[v] > size) {
+                    stamps[v] = time++;
+                }
+            }
+        }
+
+        // the next fanning vertex is the oldest candidate that stays in the cache while its own
+        // triangles are emitted (2 new vertices per triangle at most)
+        int64_t best = -1;
+        int64_t priority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) { continue; }
+            int64_t p = 0;
+            if (time - stamps[v] + 2 * live[v] <= size) {
+                p = time - stamps[v];
+            }
+            if (p > priority) {
+                priority = p;
+                best = v;
+            }
+        }
+
+        if (best < 0) {
+            // dead end: the most recent vertex with triangles left, else the next one in input order
+            while (!deadEnds.empty() && best < 0) {
+                uint32_t v = deadEnds.back();
+                deadEnds.pop_back();
+                if (live[v] > 0) { best = v; }
+            }
+            if (best < 0) {
+                best = nextLive();
+            }
+            if (best >= 0 && clusters.back() != order.size()) {
+                clusters.push_back(static_cast<uint32_t>(order.size()));
+            }
+        }
+        fan = best;
+    }
+}
+
+void MeshOptimizer::splitClusters(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, float threshold) {
+    const size_t triangleCount = indices.size() / 3;
+    FifoCache cache(vertexCount, cacheSize);
+    auto misses = [&](size_t t) {
+        return cache.access(indices[3 * t]) + cache.access(indices[3 * t + 1]) + cache.access(indices[3 * t + 2]);
+    };
+
+    std::vector<uint32_t> split;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        const size_t start = clusters[c];
+        const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        cache.clear();
+        size_t clusterMisses = 0;
+        for (size_t t = start; t < end; t++) {
+            clusterMisses += misses(t);
+        }
+        const float limit = threshold * clusterMisses / (end - start);
+
+        // a new cluster starts with an empty cache wherever the part so far is about as good as the whole
+        cache.clear();
+        split.push_back(static_cast<uint32_t>(start));
+        size_t begin = start;
+        size_t partMisses = 0;
+        for (size_t t = start; t < end; t++) {
+            partMisses += misses(t);
+            if (t + 1 < end && partMisses <= limit * (t + 1 - begin)) {
+                split.push_back(static_cast<uint32_t>(t + 1));
+                begin = t + 1;
+                partMisses = 0;
+                cache.clear();
+            }
+        }
+    }
+    clusters = std::move(split);
+}
+
+void MeshOptimizer::sortClusters(const Mesh& mesh, std::vector<uint32_t>& indices, const std::vector<uint32_t>& clusters) {
+    const size_t triangleCount = indices.size() / 3;
+    if (clusters.size() < 2) { return; }
+
+    // area weighted centroids and normals
+    std::vector<glm::vec3> centroids(clusters.size(), glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(clusters.size(), glm::vec3(0.0f));
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        float area = 0.0f;
+        for (size_t t = clusters[c]; t < end; t++) {
+            const glm::vec3& a = mesh.positions[indices[3 * t]];
+            const glm::vec3& b = mesh.positions[indices[3 * t + 1]];
+            const glm::vec3& d = mesh.positions[indices[3 * t + 2]];
+            glm::vec3 normal = glm::cross(b - a, d - a);
+            float weight = glm::length(normal);
+            centroids[c] += (a + b + d) * (weight / 3.0f);
+            normals[c] += normal;
+            area += weight;
+        }
+        meshCentroid += centroids[c];
+        meshArea += area;
+        centroids[c] = area > 0.0f ? centroids[c] / area : mesh.positions[indices[3 * clusters[c]]];
+    }
+    if (meshArea > 0.0f) {
+        meshCentroid /= meshArea;
+    }
+
+    // clusters facing away from the center are in front of the others from most directions
+    std::vector<float> keys(clusters.size());
+    std::vector<uint32_t> sorted(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        float length = glm::length(normals[c]);
+        keys[c] = length > 0.0f ? glm::dot(centroids[c] - meshCentroid, normals[c] / length) : 0.0f;
+        sorted[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (uint32_t c : sorted) {
+        const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + 3 * static_cast<size_t>(clusters[c]), indices.begin() + 3 * end);
+    }
+    indices = std::move(result);
+}
+
+size_t MeshOptimizer::remapVertices(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& remap) {
+    remap.assign(vertexCount, unusedVertex);
+    uint32_t used = 0;
+    for (uint32_t& index : indices) {
+        if (remap[index] == unusedVertex) {
+            remap[index] = used++;
+        }
+        index = remap[index];
+    }
+    return used;
+}
+
+void MeshOptimizer::reorderVertices(Mesh& mesh, const std::vector<uint32_t>& remap, size_t used) {
+    // unreferenced vertices are dropped
+    std::vector<glm::vec3> positions(used), colors(mesh.colors.empty() ? 0 : used);
+    for (size_t i = 0; i < remap.size(); i++) {
+        if (remap[i] == unusedVertex) { continue; }
+        positions[remap[i]] = mesh.positions[i];
+        if (!colors.empty()) {
+            colors[remap[i]] = mesh.colors[i];
+        }
+    }
+    mesh.positions = std::move(positions);
+    mesh.colors = std::move(colors);
+}
\ No newline at end of file
@@ -0,0 +1,86 @@
+#ifndef _RenderQueue_h_
+#define _RenderQueue_h_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLObjects.h"
+#include "ShaderProgram.h"
+
+class GeometryBatch;
+
+// draws of one pass collected as packets and executed in the order of a 64-bit sort key, so the
+// packets that share a program, texture and vertex array run one after another and the state is
+// switched once per group instead of once per object. The key, from the highest bits:
+//
+//   opaque, overlay:  layer (4) | program (12) | texture (12) | vertex array (12) | depth (24)
+//   transparent:      layer (4) | far-to-near depth (24) | program (12) | texture (12) | vertex array (12)
+//
+// so layers are drawn in order, opaque packets are grouped by state and then drawn front to back,
+// and transparent ones are blended back to front. Only the low 12 bits of the gl names go into the
+// key; names that collide are merely not grouped, every packet still binds its own objects.
+// The keys are sorted by a stable LSD radix sort, packets with equal keys keep their submission order.
+class RenderQueue {
+public:
+    enum class Layer : unsigned int { Opaque, Overlay, Transparent };
+
+    enum Flags : unsigned int {
+        PolygonOffset = 1 // pulled towards the camera, for faces drawn over other faces
+    };
+
+    struct Packet {
+        const ShaderProgram* program{};
+        const VertexArray* vertexArray{};
+        const Texture* texture{};      // bound to unit 0 if set
+        const GeometryBatch* batch{};  // drawn by GeometryBatch::draw instead of the call below
+        const Buffer* indirect{};      // glMultiDrawElementsIndirect of count commands from byte first on
+        GLint modelLocation{ -1 };     // uniform set to model before the draw, -1 if there is none
+        glm::mat4 model{ 1.0f };
+        GLenum mode{ GL_TRIANGLES };
+        GLint first{};                 // first vertex, or first index if indexType is set, or see indirect
+        GLsizei count{};
+        GLenum indexType{};            // GL_UNSIGNED_INT, ... for glDrawElements, 0 for glDrawArrays
+        unsigned int flags{};
+    };
+
+    struct Statistics {
+        size_t packets;
+        unsigned int stateChanges;          // program, texture, vertex array and flag switches as executed
+        unsigned int unsortedStateChanges;  // the same in submission order
+        unsigned int uniformUpdates;
+        float sortTime;                     // microseconds
+    };
+
+    // depth - distance from the camera, 0 (near) to 1 (far)
+    void submit(Layer layer, float depth, const Packet& packet);
+    // sorts and draws the packets, the queue is empty afterwards
+    void execute();
+
+    static uint64_t key(Layer layer, GLuint program, GLuint texture, GLuint vertexArray, float depth);
+    // distance of a world position from the camera along the view direction, scaled to [0, 1]
+    static float depth(const glm::mat4& view, const glm::vec3& position, float farPlane);
+
+    size_t size() const { return packets.size(); }
+    // of the last execute()
+    const Statistics& statistics() const { return stats; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    std::vector<Packet> packets;
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;
+    Statistics stats{};
+
+    void sort();
+    // switches between consecutive packets of the order given by entries
+    unsigned int countStateChanges() const;
+};
+
+#endif
\ No newline at end of file
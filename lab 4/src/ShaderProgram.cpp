@@ -1,13 +1,17 @@
 #include "ShaderProgram.h"
 
 #include <string>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
-ShaderProgram::ShaderProgram(const char* vertexPath, const char* fragmentPath) {
+#include "GLObjects.h"
+#include "GLState.h"
+
+ShaderProgram::ShaderProgram(const char* vertexPath, const char* fragmentPath, const std::string& vertexFunctions) {
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
     std::string fragmentCode;
@@ -34,13 +38,13 @@ ShaderProgram::ShaderProgram(const char* vertexPath, const char* fragmentPath) {
     catch (std::ifstream::failure& e) {
         std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
     }
-    const char* vShaderCode = vertexCode.c_str();
+    const char* vShaderCode[] = { vertexCode.c_str(), vertexFunctions.c_str() };
     const char* fShaderCode = fragmentCode.c_str();
     // 2. compile shaders
     GLuint vertex, fragment;
     // vertex shader
     vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, nullptr);
+    glShaderSource(vertex, 2, vShaderCode, nullptr);
     glCompileShader(vertex);
     checkCompileErrors(vertex, "VERTEX");
     // fragment Shader
@@ -50,65 +54,116 @@ ShaderProgram::ShaderProgram(const char* vertexPath, const char* fragmentPath) {
     checkCompileErrors(fragment, "FRAGMENT");
     // shader Program
     ID = glCreateProgram();
+    trackObject(GLObjectType::Program, 1);
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    cacheUniforms();
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
 }
 
-void ShaderProgram::use() {
-    glUseProgram(ID);
+ShaderProgram::~ShaderProgram() {
+    release();
+}
+
+void ShaderProgram::release() {
+    if (ID) {
+        glState.forgetProgram(ID);
+        glDeleteProgram(ID);
+        trackObject(GLObjectType::Program, -1);
+        ID = 0;
+    }
 }
 
-void ShaderProgram::setBool(const std::string& name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), static_cast<int>(value));
+void ShaderProgram::use() const {
+    glState.useProgram(ID);
+}
+
+GLint ShaderProgram::location(std::string_view name) const {
+    auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name,
+        [](const std::pair<std::string, GLint>& uniform, std::string_view key) { return uniform.first < key; });
+    if (it != uniforms.end() && it->first == name) {
+        return it->second;
+    }
+    return -1;
 }
 
-void ShaderProgram::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+void ShaderProgram::setBool(GLint location, bool value) const {
+    glProgramUniform1i(ID, location, static_cast<int>(value));
 }
 
-void ShaderProgram::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+void ShaderProgram::setInt(GLint location, int value) const {
+    glProgramUniform1i(ID, location, value);
 }
 
-void ShaderProgram::setVec2(const std::string& name, glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void ShaderProgram::setFloat(GLint location, float value) const {
+    glProgramUniform1f(ID, location, value);
 }
 
-void ShaderProgram::setVec2(const std::string& name, float x, float y) const {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+void ShaderProgram::setVec2(GLint location, const glm::vec2& value) const {
+    glProgramUniform2fv(ID, location, 1, &value[0]);
 }
 
-void ShaderProgram::setVec3(const std::string& name, glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void ShaderProgram::setVec2(GLint location, float x, float y) const {
+    glProgramUniform2f(ID, location, x, y);
 }
 
-void ShaderProgram::setVec3(const std::string& name, float x, float y, float z) const {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+void ShaderProgram::setVec3(GLint location, const glm::vec3& value) const {
+    glProgramUniform3fv(ID, location, 1, &value[0]);
 }
 
-void ShaderProgram::setVec4(const std::string& name, glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void ShaderProgram::setVec3(GLint location, float x, float y, float z) const {
+    glProgramUniform3f(ID, location, x, y, z);
 }
 
-void ShaderProgram::setVec4(const std::string& name, float x, float y, float z, float w) const {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+void ShaderProgram::setVec4(GLint location, const glm::vec4& value) const {
+    glProgramUniform4fv(ID, location, 1, &value[0]);
 }
 
-void ShaderProgram::setMat2(const std::string& name, const glm::mat2& mat) const {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void ShaderProgram::setVec4(GLint location, float x, float y, float z, float w) const {
+    glProgramUniform4f(ID, location, x, y, z, w);
 }
 
-void ShaderProgram::setMat3(const std::string& name, const glm::mat3& mat) const {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void ShaderProgram::setMat2(GLint location, const glm::mat2& mat) const {
+    glProgramUniformMatrix2fv(ID, location, 1, GL_FALSE, &mat[0][0]);
 }
 
-void ShaderProgram::setMat4(const std::string& name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+void ShaderProgram::setMat3(GLint location, const glm::mat3& mat) const {
+    glProgramUniformMatrix3fv(ID, location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void ShaderProgram::setMat4(GLint location, const glm::mat4& mat) const {
+    glProgramUniformMatrix4fv(ID, location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void ShaderProgram::cacheUniforms() {
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length, &size, &type, buffer.data());
+
+        std::string name(buffer.data(), length);
+        GLint uniformLocation = glGetUniformLocation(ID, name.c_str());
+        // members of uniform blocks have no location
+        if (uniformLocation < 0) { continue; }
+
+        // arrays are reported as "name[0]"
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            name.resize(name.size() - 3);
+        }
+        uniforms.emplace_back(std::move(name), uniformLocation);
+    }
+    std::sort(uniforms.begin(), uniforms.end());
 }
 
 void ShaderProgram::checkCompileErrors(GLuint shader, std::string type) {
@@ -0,0 +1,128 @@
+#include "StreamBuffer.h"
+#include "GLState.h"
+
+#include <cstring>
+#include <glad/glad.h>
+
+StreamBuffer::~StreamBuffer() {
+    release();
+}
+
+void StreamBuffer::init(GLsizeiptr _frameSize, std::initializer_list<GLint> attributes, int _frameCount) {
+    // the format of the vertices does not change, only the buffer behind binding point 0 does
+    VAO.create();
+    stride = VAO.floatAttributes(0, attributes);
+
+    frameCount = _frameCount < 1 ? 1 : (_frameCount > maxFrames ? maxFrames : _frameCount);
+    frame = 0;
+    highWater = 0;
+    requested = 0;
+    growCount = 0;
+
+    allocate(_frameSize);
+}
+
+void StreamBuffer::release() {
+    for (int i = 0; i < maxFrames; i++) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+    VBO.release();
+    spill.release();
+    VAO.release();
+    mapped = nullptr;
+}
+
+void StreamBuffer::allocate(GLsizeiptr size) {
+    // every region has to start on a vertex boundary so that push() can return a vertex index
+    frameSize = (size + stride - 1) / stride * stride;
+
+    // only called before the first push() of a frame, so every draw that reads the old storage has
+    // already been issued and the driver keeps the storage alive until they are finished; the
+    // fences guarded the old storage and mean nothing for the new one
+    for (int i = 0; i < maxFrames; i++) {
+        if (fences[i]) {
+            glDeleteSync(fences[i]);
+            fences[i] = nullptr;
+        }
+    }
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    VBO.storage(frameSize * frameCount, nullptr, flags);
+    mapped = static_cast<char*>(VBO.map(0, frameSize * frameCount, flags));
+    VAO.vertexBuffer(0, VBO, 0, stride);
+
+    offset = 0;
+}
+
+void StreamBuffer::waitFence(int index) {
+    if (!fences[index]) { return; }
+
+    GLenum result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (result == GL_TIMEOUT_EXPIRED) {
+        result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+    glDeleteSync(fences[index]);
+    fences[index] = nullptr;
+}
+
+void StreamBuffer::beginFrame() {
+    if (highWater > frameSize) {
+        // an earlier frame did not fit; packets of that frame may still be queued with indices into
+        // the storage at that time, so the ring only grows here, between frames
+        GLsizeiptr grown = frameSize * 2;
+        while (grown < highWater) {
+            grown *= 2;
+        }
+        allocate(grown);
+        growCount++;
+    }
+
+    waitFence(frame);
+    offset = 0;
+    requested = 0;
+}
+
+void StreamBuffer::endFrame() {
+    fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    frame = (frame + 1) % frameCount;
+}
+
+GLint StreamBuffer::push(const void* data, GLsizei count) {
+    GLsizeiptr size = static_cast<GLsizeiptr>(count) * stride;
+
+    requested += size;
+    if (requested > highWater) {
+        highWater = requested;
+    }
+    if (offset + size > frameSize) {
+        // the region is full until the next beginFrame()
+        return -1;
+    }
+
+    GLsizeiptr start = frame * frameSize + offset;
+    std::memcpy(mapped + start, data, size);
+    glState.countUpload(static_cast<size_t>(size));
+    offset += size;
+
+    return static_cast<GLint>(start / stride);
+}
+
+void StreamBuffer::draw(const void* data, GLenum mode, GLsizei count) {
+    if (count <= 0) { return; }
+
+    GLint first = push(data, count);
+    VAO.bind();
+    if (first < 0) {
+        // the draw is issued right away, so vertices that do not fit can go through a buffer of
+        // their own as long as the ring is attached again afterwards
+        spill.allocate(static_cast<GLsizeiptr>(count) * stride, data, GL_STREAM_DRAW);
+        VAO.vertexBuffer(0, spill, 0, stride);
+        glState.drawArrays(mode, 0, count);
+        VAO.vertexBuffer(0, VBO, 0, stride);
+        return;
+    }
+    glState.drawArrays(mode, first, count);
+}
\ No newline at end of file
@@ -2,18 +2,43 @@
 #define _TextRenderer_h_
 
 #include <iostream>
-#include <map>
+#include <vector>
+#include <algorithm>
+#include <chrono>
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
-GLuint textVAO, textVBO;
+#include "GLObjects.h"
+#include "RenderQueue.h"
+
+VertexArray textVAO;
+Buffer textVBO;
+Texture textAtlas;
 struct Character {
-    unsigned int textureID;
+    glm::ivec2   offset;  // position of the glyph in the atlas (pixels)
+    glm::vec2    uvMin;
+    glm::vec2    uvMax;
     glm::ivec2   size;
     glm::ivec2   bearing;
     unsigned int advance;
 };
-std::map<GLchar, Character> characters;
+Character characters[128];
+
+std::vector<GLfloat> textBatch; // quads of all strings of the frame (x, y, z, u, v)
+
+struct TextStats {
+    int drawCalls;
+    int glyphs;
+    float cpuTime; // microseconds spent on building and submitting the batch
+};
+TextStats textStats{};
+
+// releases the objects created by initFreeType
+void releaseText() {
+    textVAO.release();
+    textVBO.release();
+    textAtlas.release();
+}
 
 int initFreeType() {
     FT_Library ft;
@@ -29,51 +54,65 @@ int initFreeType() {
 
     FT_Set_Pixel_Sizes(face, 0, 48);
 
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // all glyphs are packed row by row into one texture
+    const int atlasWidth = 1024;
+    const int padding = 1;
+    std::vector<std::vector<unsigned char>> bitmaps(128);
+    glm::ivec2 pen(padding, padding);
+    int rowHeight = 0;
+
     for (unsigned char c = 0; c < 128; c++) {
         if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
             std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
             continue;
         }
 
-        GLuint texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            static_cast<unsigned int>(face->glyph->advance.x)
-        };
-        characters.insert(std::pair<char, Character>(c, character));
+        FT_Bitmap& bitmap = face->glyph->bitmap;
+        if (pen.x + static_cast<int>(bitmap.width) + padding > atlasWidth) {
+            pen.x = padding;
+            pen.y += rowHeight + padding;
+            rowHeight = 0;
+        }
+
+        Character& character = characters[c];
+        character.offset  = pen;
+        character.size    = glm::ivec2(bitmap.width, bitmap.rows);
+        character.bearing = glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top);
+        character.advance = static_cast<unsigned int>(face->glyph->advance.x);
+
+        bitmaps[c].resize(static_cast<size_t>(bitmap.width) * bitmap.rows);
+        for (unsigned int row = 0; row < bitmap.rows; row++) {
+            std::copy(bitmap.buffer + row * bitmap.pitch, bitmap.buffer + row * bitmap.pitch + bitmap.width, bitmaps[c].begin() + row * bitmap.width);
+        }
+
+        pen.x += bitmap.width + padding;
+        rowHeight = std::max(rowHeight, static_cast<int>(bitmap.rows));
+    }
+    int atlasHeight = pen.y + rowHeight + padding;
+
+    std::vector<unsigned char> atlas(static_cast<size_t>(atlasWidth) * atlasHeight, 0);
+    for (unsigned char c = 0; c < 128; c++) {
+        Character& character = characters[c];
+        for (int row = 0; row < character.size.y; row++) {
+            std::copy_n(bitmaps[c].begin() + row * character.size.x, character.size.x, atlas.begin() + (character.offset.y + row) * atlasWidth + character.offset.x);
+        }
+        character.uvMin = glm::vec2(character.offset) / glm::vec2(atlasWidth, atlasHeight);
+        character.uvMax = glm::vec2(character.offset + character.size) / glm::vec2(atlasWidth, atlasHeight);
     }
 
-    glGenVertexArrays(1, &textVAO);
-    glGenBuffers(1, &textVBO);
-    glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, nullptr, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    textAtlas.storage2D(1, GL_R8, atlasWidth, atlasHeight);
+    textAtlas.subImage2D(0, 0, 0, atlasWidth, atlasHeight, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+    textAtlas.parameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    textAtlas.parameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    textAtlas.parameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    textAtlas.parameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // the buffer gets its storage with the first batch, it grows under the same name
+    textVAO.create();
+    GLsizei stride = textVAO.floatAttributes(0, { 3, 2 });
+    textVBO.allocate(stride * 6 * 64, nullptr, GL_DYNAMIC_DRAW);
+    textVAO.vertexBuffer(0, textVBO, 0, stride);
 
     FT_Done_Face(face);
     FT_Done_FreeType(ft);
@@ -81,53 +120,85 @@ int initFreeType() {
     return 0;
 }
 
-void renderText(ShaderProgram& shader, std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::mat4 projection, glm::mat4 view, glm::mat4 model) {
-    shader.use();
-    shader.setVec3("textColor", 0.0f, 0.0f, 0.0f);
-    shader.setMat4("projection", projection);
-    shader.setMat4("view", view);
-    shader.setMat4("model", model);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
-
+// appends the quads of the string to the text batch, nothing is drawn until submitText;
+// the model matrix is applied here so that labels with different models share one draw call
+void renderText(const std::string& text, GLfloat x, GLfloat y, GLfloat scale, const glm::mat4& model) {
     for (const char& c : text) {
-        Character ch = characters[c];
-
-        glm::vec4 pos = glm::vec4(x + ch.bearing.x * scale, y - (ch.size.y - ch.bearing.y) * scale, 0.0, 1.0);
+        const Character& ch = characters[c & 0x7F];
 
-        GLfloat xpos = pos.x;
-        GLfloat ypos = pos.y;
+        GLfloat xpos = x + ch.bearing.x * scale;
+        GLfloat ypos = y - (ch.size.y - ch.bearing.y) * scale;
         GLfloat w = ch.size.x * scale;
         GLfloat h = ch.size.y * scale;
 
-        float vertices[6][4] = {
-            { xpos,     ypos + h, 0.0f, 0.0f },
+        const glm::vec4 corners[6] = {
+            { xpos,     ypos + h, 0.0f, 1.0f },
             { xpos,     ypos,     0.0f, 1.0f },
-            { xpos + w, ypos,     1.0f, 1.0f },
+            { xpos + w, ypos,     0.0f, 1.0f },
 
-            { xpos,     ypos + h, 0.0f, 0.0f },
-            { xpos + w, ypos,     1.0f, 1.0f },
-            { xpos + w, ypos + h, 1.0f, 0.0f }
+            { xpos,     ypos + h, 0.0f, 1.0f },
+            { xpos + w, ypos,     0.0f, 1.0f },
+            { xpos + w, ypos + h, 0.0f, 1.0f }
+        };
+        const glm::vec2 uvs[6] = {
+            { ch.uvMin.x, ch.uvMin.y },
+            { ch.uvMin.x, ch.uvMax.y },
+            { ch.uvMax.x, ch.uvMax.y },
+
+            { ch.uvMin.x, ch.uvMin.y },
+            { ch.uvMax.x, ch.uvMax.y },
+            { ch.uvMax.x, ch.uvMin.y }
         };
 
-        glBindTexture(GL_TEXTURE_2D, ch.textureID);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        for (int i = 0; i < 6; i++) {
+            glm::vec4 position = model * corners[i];
+            const GLfloat vertex[5] = { position.x, position.y, position.z, uvs[i].x, uvs[i].y };
+            textBatch.insert(textBatch.end(), vertex, vertex + 5);
+        }
 
         x += (ch.advance >> 6) * scale;
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-void renderAllText(ShaderProgram& shader, glm::mat4 projection, glm::mat4 view) {
-    renderText(shader, "0", 0.0f, 0.0f, 0.003f, projection, view, glm::mat4(1.0f));
-    renderText(shader, "x", 2.0f, 0.0f, 0.003f, projection, view, glm::mat4(1.0f));
-    renderText(shader, "y", 0.0f, 2.0f, 0.003f, projection, view, glm::mat4(1.0f));
+// submits everything collected by renderText as one packet of the transparent layer, so the
+// labels are drawn after the geometry they are blended over
+void submitText(RenderQueue& queue, const ShaderProgram& shader) {
+    GLsizei count = static_cast<GLsizei>(textBatch.size() / 5);
+    textStats.glyphs = count / 6;
+    textStats.drawCalls = 0;
+    if (count == 0) { return; }
+
+    GLsizeiptr size = sizeof(GLfloat) * textBatch.size();
+    if (size > textVBO.size()) {
+        textVBO.allocate(size, nullptr, GL_DYNAMIC_DRAW);
+    }
+    textVBO.update(0, size, textBatch.data());
+
+    // textColor is set once after linking, projection and view come from the camera uniform block;
+    // the model matrices are already applied to the vertices
+    RenderQueue::Packet packet;
+    packet.program = &shader;
+    packet.texture = &textAtlas;
+    packet.vertexArray = &textVAO;
+    packet.count = count;
+    queue.submit(RenderQueue::Layer::Transparent, 0.0f, packet);
+
+    textStats.drawCalls++;
+    textBatch.clear();
+}
+
+void renderAllText(RenderQueue& queue, const ShaderProgram& shader) {
+    auto start = std::chrono::steady_clock::now();
+
+    renderText("0", 0.0f, 0.0f, 0.003f, glm::mat4(1.0f));
+    renderText("x", 2.0f, 0.0f, 0.003f, glm::mat4(1.0f));
+    renderText("y", 0.0f, 2.0f, 0.003f, glm::mat4(1.0f));
     glm::mat4 model = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    renderText(shader, "z", -2.0f, 0.0f, 0.003f, projection, view, model);
+    renderText("z", -2.0f, 0.0f, 0.003f, model);
+
+    submitText(queue, shader);
+
+    textStats.cpuTime = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    for (unsigned int i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(size_t _count, size_t _grain, Task _task, void* _context) {
+    if (_count == 0) { return; }
+    if (_grain == 0) { _grain = 1; }
+
+    // small jobs are not worth waking anybody up
+    if (workers.empty() || _count <= _grain) {
+        _task(_context, 0, _count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task = _task;
+        context = _context;
+        count = _count;
+        grain = _grain;
+        next = 0;
+        busy = static_cast<unsigned int>(workers.size());
+        generation++;
+    }
+    wake.notify_all();
+
+    work();
+
+    // the job lives on the caller's stack, so every worker has to be out of it before returning
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return busy == 0; });
+}
+
+void ThreadPool::work() {
+    size_t chunks = (count + grain - 1) / grain;
+    for (size_t chunk = next++; chunk < chunks; chunk = next++) {
+        size_t begin = chunk * grain;
+        size_t end = begin + grain < count ? begin + grain : count;
+        task(context, begin, end);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) { return; }
+            seen = generation;
+        }
+
+        work();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+        }
+        done.notify_one();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include "TriangleBlocks.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TRIANGLE_BLOCKS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+// the kernels have to round exactly like the scalar code: avx2 is enabled without fma, and
+// avx-512 has fma in its base set, so gcc must not fuse its multiplications and additions
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#endif
+#endif
+
+namespace {
+
+const size_t width = TriangleBlocks::blockWidth;
+const size_t blockFloats = 9 * width;
+const float epsilon = 0.00001f;
+
+// lanes of the packet starting at lane c that lie in [first, end)
+inline unsigned int rangeMask(size_t c, size_t first, size_t end, size_t packet) {
+    unsigned int mask = (1u << packet) - 1;
+    if (c < first) {
+        mask &= mask << (first - c);
+    }
+    if (c + packet > end) {
+        mask &= mask >> (c + packet - end);
+    }
+    return mask;
+}
+
+// lowest lane of the mask with the smallest t, if it is nearer than t
+inline bool closest(const float* ts, unsigned int mask, size_t c, float& t, size_t& lane) {
+    bool found = false;
+    for (size_t l = 0; mask; l++, mask >>= 1) {
+        if ((mask & 1) && ts[l] < t) {
+            t = ts[l];
+            lane = c + l;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// same operations in the same order as Window::distanceToIntersection
+bool intersectScalar(const float* data, const float* o, const float* d, size_t first, size_t end, float& t, size_t& lane) {
+    bool found = false;
+    for (size_t i = first; i < end; i++) {
+        const float* p = data + i / width * blockFloats + i % width;
+        float v0x = p[0], v0y = p[width], v0z = p[2 * width];
+        float e1x = p[3 * width], e1y = p[4 * width], e1z = p[5 * width];
+        float e2x = p[6 * width], e2y = p[7 * width], e2z = p[8 * width];
+
+        float hx = d[1] * e2z - e2y * d[2];
+        float hy = d[2] * e2x - e2z * d[0];
+        float hz = d[0] * e2y - e2x * d[1];
+        float a = e1x * hx + e1y * hy + e1z * hz;
+        if (a > -epsilon && a < epsilon) { continue; }
+
+        float f = 1.0f / a;
+        float sx = o[0] - v0x, sy = o[1] - v0y, sz = o[2] - v0z;
+        float u = f * (sx * hx + sy * hy + sz * hz);
+        if (u < 0.0f || u > 1.0f) { continue; }
+
+        float qx = sy * e1z - e1y * sz;
+        float qy = sz * e1x - e1z * sx;
+        float qz = sx * e1y - e1x * sy;
+        float v = f * (d[0] * qx + d[1] * qy + d[2] * qz);
+        if (v < 0.0f || u + v > 1.0f) { continue; }
+
+        float distance = f * (e2x * qx + e2y * qy + e2z * qz);
+        if (distance > epsilon && distance < t) {
+            t = distance;
+            lane = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+#ifdef TRIANGLE_BLOCKS_X86
+bool intersectSSE(const float* data, const float* o, const float* d, size_t first, size_t end, float& t, size_t& lane) {
+    const __m128 ox = _mm_set1_ps(o[0]), oy = _mm_set1_ps(o[1]), oz = _mm_set1_ps(o[2]);
+    const __m128 dx = _mm_set1_ps(d[0]), dy = _mm_set1_ps(d[1]), dz = _mm_set1_ps(d[2]);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    const __m128 plusEpsilon = _mm_set1_ps(epsilon), minusEpsilon = _mm_set1_ps(-epsilon);
+
+    bool found = false;
+    alignas(16) float ts[4];
+    for (size_t c = first & ~size_t(3); c < end; c += 4) {
+        const float* p = data + c / width * blockFloats + c % width;
+        __m128 v0x = _mm_load_ps(p), v0y = _mm_load_ps(p + width), v0z = _mm_load_ps(p + 2 * width);
+        __m128 e1x = _mm_load_ps(p + 3 * width), e1y = _mm_load_ps(p + 4 * width), e1z = _mm_load_ps(p + 5 * width);
+        __m128 e2x = _mm_load_ps(p + 6 * width), e2y = _mm_load_ps(p + 7 * width), e2z = _mm_load_ps(p + 8 * width);
+
+        __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(e2y, dz));
+        __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(e2z, dx));
+        __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(e2x, dy));
+        __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+        __m128 parallel = _mm_and_ps(_mm_cmpgt_ps(a, minusEpsilon), _mm_cmplt_ps(a, plusEpsilon));
+
+        __m128 f = _mm_div_ps(one, a);
+        __m128 sx = _mm_sub_ps(ox, v0x), sy = _mm_sub_ps(oy, v0y), sz = _mm_sub_ps(oz, v0z);
+        __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)));
+
+        __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(e1y, sz));
+        __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(e1z, sx));
+        __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(e1x, sy));
+        __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+        __m128 distance = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+
+        // negated comparisons reject exactly what the scalar code rejects
+        __m128 hit = _mm_andnot_ps(parallel, _mm_and_ps(_mm_cmpnlt_ps(u, zero), _mm_cmpngt_ps(u, one)));
+        hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpnlt_ps(v, zero), _mm_cmpngt_ps(_mm_add_ps(u, v), one)));
+        hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(distance, plusEpsilon), _mm_cmplt_ps(distance, _mm_set1_ps(t))));
+
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(hit)) & rangeMask(c, first, end, 4);
+        if (mask) {
+            _mm_store_ps(ts, distance);
+            found |= closest(ts, mask, c, t, lane);
+        }
+    }
+    return found;
+}
+
+TARGET_AVX2 bool intersectAVX2(const float* data, const float* o, const float* d, size_t first, size_t end, float& t, size_t& lane) {
+    const __m256 ox = _mm256_set1_ps(o[0]), oy = _mm256_set1_ps(o[1]), oz = _mm256_set1_ps(o[2]);
+    const __m256 dx = _mm256_set1_ps(d[0]), dy = _mm256_set1_ps(d[1]), dz = _mm256_set1_ps(d[2]);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+    const __m256 plusEpsilon = _mm256_set1_ps(epsilon), minusEpsilon = _mm256_set1_ps(-epsilon);
+
+    bool found = false;
+    alignas(32) float ts[8];
+    for (size_t c = first & ~size_t(7); c < end; c += 8) {
+        const float* p = data + c / width * blockFloats + c % width;
+        __m256 v0x = _mm256_load_ps(p), v0y = _mm256_load_ps(p + width), v0z = _mm256_load_ps(p + 2 * width);
+        __m256 e1x = _mm256_load_ps(p + 3 * width), e1y = _mm256_load_ps(p + 4 * width), e1z = _mm256_load_ps(p + 5 * width);
+        __m256 e2x = _mm256_load_ps(p + 6 * width), e2y = _mm256_load_ps(p + 7 * width), e2z = _mm256_load_ps(p + 8 * width);
+
+        __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(e2y, dz));
+        __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(e2z, dx));
+        __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(e2x, dy));
+        __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz));
+        __m256 parallel = _mm256_and_ps(_mm256_cmp_ps(a, minusEpsilon, _CMP_GT_OQ), _mm256_cmp_ps(a, plusEpsilon, _CMP_LT_OQ));
+
+        __m256 f = _mm256_div_ps(one, a);
+        __m256 sx = _mm256_sub_ps(ox, v0x), sy = _mm256_sub_ps(oy, v0y), sz = _mm256_sub_ps(oz, v0z);
+        __m256 u = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz)));
+
+        __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(e1y, sz));
+        __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(e1z, sx));
+        __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(e1x, sy));
+        __m256 v = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)));
+        __m256 distance = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+
+        __m256 hit = _mm256_andnot_ps(parallel, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_NLT_UQ), _mm256_cmp_ps(u, one, _CMP_NGT_UQ)));
+        hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_NLT_UQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_NGT_UQ)));
+        hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(distance, plusEpsilon, _CMP_GT_OQ), _mm256_cmp_ps(distance, _mm256_set1_ps(t), _CMP_LT_OQ)));
+
+        unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(hit)) & rangeMask(c, first, end, 8);
+        if (mask) {
+            _mm256_store_ps(ts, distance);
+            found |= closest(ts, mask, c, t, lane);
+        }
+    }
+    return found;
+}
+
+TARGET_AVX512 bool intersectAVX512(const float* data, const float* o, const float* d, size_t first, size_t end, float& t, size_t& lane) {
+    const __m512 ox = _mm512_set1_ps(o[0]), oy = _mm512_set1_ps(o[1]), oz = _mm512_set1_ps(o[2]);
+    const __m512 dx = _mm512_set1_ps(d[0]), dy = _mm512_set1_ps(d[1]), dz = _mm512_set1_ps(d[2]);
+    const __m512 zero = _mm512_setzero_ps(), one = _mm512_set1_ps(1.0f);
+    const __m512 plusEpsilon = _mm512_set1_ps(epsilon), minusEpsilon = _mm512_set1_ps(-epsilon);
+
+    bool found = false;
+    alignas(64) float ts[16];
+    for (size_t c = first & ~size_t(15); c < end; c += 16) {
+        const float* p = data + c / width * blockFloats;
+        __m512 v0x = _mm512_load_ps(p), v0y = _mm512_load_ps(p + width), v0z = _mm512_load_ps(p + 2 * width);
+        __m512 e1x = _mm512_load_ps(p + 3 * width), e1y = _mm512_load_ps(p + 4 * width), e1z = _mm512_load_ps(p + 5 * width);
+        __m512 e2x = _mm512_load_ps(p + 6 * width), e2y = _mm512_load_ps(p + 7 * width), e2z = _mm512_load_ps(p + 8 * width);
+
+        __m512 hx = _mm512_sub_ps(_mm512_mul_ps(dy, e2z), _mm512_mul_ps(e2y, dz));
+        __m512 hy = _mm512_sub_ps(_mm512_mul_ps(dz, e2x), _mm512_mul_ps(e2z, dx));
+        __m512 hz = _mm512_sub_ps(_mm512_mul_ps(dx, e2y), _mm512_mul_ps(e2x, dy));
+        __m512 a = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e1x, hx), _mm512_mul_ps(e1y, hy)), _mm512_mul_ps(e1z, hz));
+        __mmask16 parallel = _mm512_cmp_ps_mask(a, minusEpsilon, _CMP_GT_OQ) & _mm512_cmp_ps_mask(a, plusEpsilon, _CMP_LT_OQ);
+
+        __m512 f = _mm512_div_ps(one, a);
+        __m512 sx = _mm512_sub_ps(ox, v0x), sy = _mm512_sub_ps(oy, v0y), sz = _mm512_sub_ps(oz, v0z);
+        __m512 u = _mm512_mul_ps(f, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(sx, hx), _mm512_mul_ps(sy, hy)), _mm512_mul_ps(sz, hz)));
+
+        __m512 qx = _mm512_sub_ps(_mm512_mul_ps(sy, e1z), _mm512_mul_ps(e1y, sz));
+        __m512 qy = _mm512_sub_ps(_mm512_mul_ps(sz, e1x), _mm512_mul_ps(e1z, sx));
+        __m512 qz = _mm512_sub_ps(_mm512_mul_ps(sx, e1y), _mm512_mul_ps(e1x, sy));
+        __m512 v = _mm512_mul_ps(f, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, qx), _mm512_mul_ps(dy, qy)), _mm512_mul_ps(dz, qz)));
+        __m512 distance = _mm512_mul_ps(f, _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e2x, qx), _mm512_mul_ps(e2y, qy)), _mm512_mul_ps(e2z, qz)));
+
+        __mmask16 hit = ~parallel & _mm512_cmp_ps_mask(u, zero, _CMP_NLT_UQ) & _mm512_cmp_ps_mask(u, one, _CMP_NGT_UQ);
+        hit &= _mm512_cmp_ps_mask(v, zero, _CMP_NLT_UQ) & _mm512_cmp_ps_mask(_mm512_add_ps(u, v), one, _CMP_NGT_UQ);
+        hit &= _mm512_cmp_ps_mask(distance, plusEpsilon, _CMP_GT_OQ) & _mm512_cmp_ps_mask(distance, _mm512_set1_ps(t), _CMP_LT_OQ);
+
+        unsigned int mask = static_cast<unsigned int>(hit) & rangeMask(c, first, end, 16);
+        if (mask) {
+            _mm512_store_ps(ts, distance);
+            found |= closest(ts, mask, c, t, lane);
+        }
+    }
+    return found;
+}
+
+bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSaves = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osSaves || !avx || (_xgetbv(0) & 6) != 6) { return false; }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool cpuHasAVX512() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 0xE6) != 0xE6) { return false; }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 16)) != 0;
+#else
+    return __builtin_cpu_supports("avx512f");
+#endif
+}
+#endif
+
+}
+
+void TriangleBlocks::resize(size_t lanes) {
+    size_t old = blocks.size();
+    blocks.resize((lanes + blockWidth - 1) / blockWidth);
+    for (size_t b = old; b < blocks.size(); b++) {
+        std::memset(&blocks[b], 0, sizeof(Block));
+    }
+    count = lanes;
+}
+
+void TriangleBlocks::set(size_t lane, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+    Block& block = blocks[lane / blockWidth];
+    size_t l = lane % blockWidth;
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+    for (int k = 0; k < 3; k++) {
+        block.v0[k][l] = v0[k];
+        block.edge1[k][l] = edge1[k];
+        block.edge2[k][l] = edge2[k];
+    }
+}
+
+glm::vec3 TriangleBlocks::vertex(size_t lane, int k) const {
+    const Block& block = blocks[lane / blockWidth];
+    size_t l = lane % blockWidth;
+    glm::vec3 v(block.v0[0][l], block.v0[1][l], block.v0[2][l]);
+    if (k == 1) {
+        v += glm::vec3(block.edge1[0][l], block.edge1[1][l], block.edge1[2][l]);
+    }
+    else if (k == 2) {
+        v += glm::vec3(block.edge2[0][l], block.edge2[1][l], block.edge2[2][l]);
+    }
+    return v;
+}
+
+bool TriangleBlocks::intersect(const glm::vec3& origin, const glm::vec3& direction, size_t first, size_t lanes,
+    float& t, size_t& lane, RayKernel kernel) const {
+    bool (*function)(const float*, const float*, const float*, size_t, size_t, float&, size_t&) = intersectScalar;
+#ifdef TRIANGLE_BLOCKS_X86
+    if (kernel == RayKernel::SSE) {
+        function = intersectSSE;
+    }
+    else if (kernel == RayKernel::AVX2) {
+        function = intersectAVX2;
+    }
+    else if (kernel == RayKernel::AVX512) {
+        function = intersectAVX512;
+    }
+#endif
+    if (lanes == 0) { return false; }
+
+    const float o[3] = { origin.x, origin.y, origin.z };
+    const float d[3] = { direction.x, direction.y, direction.z };
+    return function(blocks.front().v0[0], o, d, first, first + lanes, t, lane);
+}
+
+bool TriangleBlocks::supported(RayKernel kernel) {
+#ifdef TRIANGLE_BLOCKS_X86
+    static const bool avx2 = cpuHasAVX2();
+    static const bool avx512 = cpuHasAVX512();
+    switch (kernel) {
+        case RayKernel::Scalar:
+        case RayKernel::SSE:    return true;
+        case RayKernel::AVX2:   return avx2;
+        case RayKernel::AVX512: return avx512;
+    }
+    return false;
+#else
+    return kernel == RayKernel::Scalar;
+#endif
+}
+
+RayKernel TriangleBlocks::bestKernel() {
+    if (supported(RayKernel::AVX512)) { return RayKernel::AVX512; }
+    if (supported(RayKernel::AVX2)) { return RayKernel::AVX2; }
+    if (supported(RayKernel::SSE)) { return RayKernel::SSE; }
+    return RayKernel::Scalar;
+}
+
+size_t TriangleBlocks::width(RayKernel kernel) {
+    switch (kernel) {
+        case RayKernel::Scalar: return 1;
+        case RayKernel::SSE:    return 4;
+        case RayKernel::AVX2:   return 8;
+        case RayKernel::AVX512: return 16;
+    }
+    return 1;
+}
+
+const char* TriangleBlocks::kernelName(RayKernel kernel) {
+    switch (kernel) {
+        case RayKernel::Scalar: return "Scalar";
+        case RayKernel::SSE:    return "SSE";
+        case RayKernel::AVX2:   return "AVX2";
+        case RayKernel::AVX512: return "AVX-512";
+    }
+    return "";
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef _TriangleBlocks_h_
+#define _TriangleBlocks_h_
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+
+enum class RayKernel { Scalar, SSE, AVX2, AVX512 };
+
+// triangles prepared for moller-trumbore tests of one ray against 4, 8 or 16 of them at once:
+// v0, edge1 = v1 - v0 and edge2 = v2 - v0 are stored as structure of arrays in blocks of 16 lanes.
+// Lanes that were never set hold degenerate triangles which are never hit.
+class TriangleBlocks {
+public:
+    static const size_t blockWidth = 16;
+
+    void resize(size_t lanes);
+    size_t size() const { return count; }
+
+    void set(size_t lane, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+    // vertex k (0, 1, 2) of the triangle in lane
+    glm::vec3 vertex(size_t lane, int k) const;
+
+    // closest hit of origin + t * direction among the lanes [first, first + lanes) that is nearer than t;
+    // on success t and lane are updated. The tests and epsilons are those of Window::distanceToIntersection,
+    // every kernel gives the same result as the scalar one, ties go to the lowest lane.
+    bool intersect(const glm::vec3& origin, const glm::vec3& direction, size_t first, size_t lanes,
+        float& t, size_t& lane, RayKernel kernel = bestKernel()) const;
+
+    // widest kernel supported by the processor
+    static RayKernel bestKernel();
+    static bool supported(RayKernel kernel);
+    static size_t width(RayKernel kernel);
+    static const char* kernelName(RayKernel kernel);
+
+private:
+    struct alignas(64) Block {
+        float v0[3][blockWidth];
+        float edge1[3][blockWidth];
+        float edge2[3][blockWidth];
+    };
+
+    std::vector<Block> blocks;
+    size_t count{};
+};
+
+#endif
\ No newline at end of file
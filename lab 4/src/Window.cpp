@@ -1,5 +1,6 @@
 #include "Window.h"
 
+#include <chrono>
 #include <iostream>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/string_cast.hpp>
@@ -26,6 +27,13 @@ Window::Window(GLsizei width, GLsizei height, const std::string& title) {
     SelectedFace[1] = glm::vec3(0.0f);
     SelectedFace[2] = glm::vec3(0.0f);
 
+    Model = glm::mat4(1.0f);
+    InverseModel = glm::mat4(1.0f);
+
+    HoveredFace = -1;
+    GpuPicking = false;
+    PickTime = 0.0f;
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
@@ -92,6 +100,34 @@ void Window::renderBackgroundColor() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
+void Window::pick() {
+    auto start = std::chrono::steady_clock::now();
+
+    hover(faceAt(Camera.Position, Camera.Front));
+
+    PickTime = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Window::hover(long long face) {
+    HoveredFace = face >= 0 && static_cast<size_t>(face) < Vertices.size() / 3 ? static_cast<int>(face) : -1;
+}
+
+int Window::faceAt(const glm::vec3& origin, const glm::vec3& direction) const {
+    // the ray goes into object space instead of the mesh into world space; the direction is not
+    // normalized again, so t is the same along both rays
+    Bvh::Hit hit;
+    glm::vec3 objectOrigin(InverseModel * glm::vec4(origin, 1.0f));
+    glm::vec3 objectDirection(InverseModel * glm::vec4(direction, 0.0f));
+    return Picker.intersect(objectOrigin, objectDirection, hit) ? static_cast<int>(hit.triangle) : -1;
+}
+
+void Window::setModel(const glm::mat4& model) {
+    if (model == Model) { return; }
+    Model = model;
+    // a zero scale flattens the mesh, nothing can be picked then
+    InverseModel = glm::determinant(model) != 0.0f ? glm::inverse(model) : glm::mat4(0.0f);
+}
+
 void Window::frameBuffersizeCallback(int width, int height) {
     glViewport(0, 0, width, height);
     if (width || height) {
@@ -138,20 +174,14 @@ void Window::mouseButtonCallback(int button, int action, int mods) {
         }
     }
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE && !EnableCursor) {
-        float closestDist = -1.0f;
-
-        for (size_t i = 0; i < Vertices.size();) {
-            glm::vec3 point1 = Vertices.at(i++);
-            glm::vec3 point2 = Vertices.at(i++);
-            glm::vec3 point3 = Vertices.at(i++);
-
-            float dist = distanceToIntersection(point1, point2, point3);
-            if (dist >= 0 && (closestDist < 0 || dist < closestDist)) {
-                closestDist = dist;
-                SelectedFace[0] = point1;
-                SelectedFace[1] = point2;
-                SelectedFace[2] = point3;
-            }
+        // the camera may have moved since the last frame, the id buffer is always a frame or two behind
+        if (!GpuPicking) {
+            pick();
+        }
+        if (HoveredFace >= 0) {
+            SelectedFace[0] = worldVertex(3 * HoveredFace);
+            SelectedFace[1] = worldVertex(3 * HoveredFace + 1);
+            SelectedFace[2] = worldVertex(3 * HoveredFace + 2);
         }
     }
 }
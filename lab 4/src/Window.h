@@ -7,6 +7,7 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
+#include "Bvh.h"
 #include "Camera.h"
 
 class Window {
@@ -26,9 +27,18 @@ public:
     float LastFrame;
 
     Camera Camera;
+    // mesh in object space, 3 per triangle; it never changes, the transformations only change Model
     std::vector<glm::vec3> Vertices;
+    glm::mat4 Model;
+    glm::mat4 InverseModel;
     glm::vec3 SelectedFace[3];
 
+    // triangles of Vertices in object space for ray picking, built by the owner of Vertices
+    Bvh Picker;
+    int HoveredFace;   // triangle under the crosshair, -1 if there is none; set by hover()
+    bool GpuPicking;   // HoveredFace comes from the id buffer of the owner instead of pick()
+    float PickTime;    // duration of the last pick, microseconds
+
     GLFWwindow* pWindow;
 
     Window(GLsizei _width, GLsizei _height, const std::string& title);
@@ -36,6 +46,16 @@ public:
     void timing();
     void keyCallback(GLFWwindow* window);
     void renderBackgroundColor();
+    // finds the triangle under the crosshair (camera position along the front vector)
+    void pick();
+    // makes face the hovered triangle if it is one of Vertices, otherwise there is none; every
+    // reader of HoveredFace can index Vertices with it then
+    void hover(long long face);
+    // closest triangle hit by a world space ray, -1 if there is none
+    int faceAt(const glm::vec3& origin, const glm::vec3& direction) const;
+    void setModel(const glm::mat4& model);
+    // vertex i of Vertices in world space, i < Vertices.size()
+    glm::vec3 worldVertex(size_t i) const { return glm::vec3(Model * glm::vec4(Vertices[i], 1.0f)); }
     glm::vec3 translate(const float distance);
     glm::vec3 scale(const float scaleFactor, float(&point1)[3], float(&point2)[3], float(&point3)[3]);
     glm::mat4 reflect();
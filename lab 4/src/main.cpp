@@ -1,4 +1,12 @@
-﻿#include <glad/glad.h>
+﻿#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+#include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -7,6 +15,18 @@
 #include <imgui/backends/imgui_impl_opengl3.h>
 
 #include "ShaderProgram.h"
+#include "CameraBuffer.h"
+#include "GLObjects.h"
+#include "GLState.h"
+#include "GeometryBatch.h"
+#include "StreamBuffer.h"
+#include "MeshBuffer.h"
+#include "MeshCache.h"
+#include "MeshImporter.h"
+#include "IdPicker.h"
+#include "FrustumCuller.h"
+#include "InstanceScene.h"
+#include "RenderQueue.h"
 #include "TextRenderer.h"
 #include "Window.h"
 #include "Camera.h"
@@ -33,116 +53,128 @@ int main() {
 
     // shaders
     ShaderProgram pyramidShader("resources\\shader.vs", "resources\\shader.fs");
+    const GLint pyramidShaderModel = pyramidShader.location("model");
 
     GLfloat pyramidVertices[] = {
         // positions         // colors
+         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f, // green
+         0.5f, 0.0f, -0.5f,  0.0f, 0.0f, 1.0f, // blue
+        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f, // red
+        -0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 0.0f, // yellow
+         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f, // magenta
+    };
+
+    GLuint pyramidIndices[] = {
         // base
-         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,
-         0.5f, 0.0f, -0.5f,  0.0f, 0.0f, 1.0f,
-        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f,
-        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f,
-        -0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 0.0f,
-         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,
+        0, 1, 2,
+        2, 3, 0,
 
         // side
-         0.5f, 0.0f, -0.5f,  0.0f, 0.0f, 1.0f,
-        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f,
-
-        -0.5f, 0.0f, -0.5f,  1.0f, 0.0f, 0.0f,
-        -0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f,
-
-        -0.5f, 0.0f,  0.5f,  1.0f, 1.0f, 0.0f,
-         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,
-         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f,
+        1, 2, 4,
+        2, 3, 4,
+        3, 0, 4,
+        0, 1, 4,
+    };
+    const GLsizei pyramidIndexCount = sizeof(pyramidIndices) / sizeof(GLuint);
 
-         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,
-         0.5f, 0.0f, -0.5f,  0.0f, 0.0f, 1.0f,
-         0.0f, 1.0f,  0.0f,  1.0f, 0.0f, 1.0f,
+    // positions of the pyramid, 3 per triangle, for picking
+    for (GLuint index : pyramidIndices) {
+        window.Vertices.push_back(glm::vec3(pyramidVertices[6 * index], pyramidVertices[6 * index + 1], pyramidVertices[6 * index + 2]));
+    }
+    // the tree is built once, the picking ray is transformed into object space instead
+    window.Picker.build(window.Vertices, glm::mat4(1.0f));
+
+    // a mesh loaded from an obj or ply file replaces the pyramid; it is fitted into the same box
+    // (largest extent 1, standing on y = 0) so that the transformations below act the same on it.
+    // The first load of a file writes a binary cache next to it which is mapped by later loads
+    ThreadPool pool;
+    MeshImporter importer(&pool);
+    MeshCache::Options cacheOptions;
+    MeshCache::Statistics cacheStatistics{};
+    MeshBuffer meshBuffer;
+    size_t meshVertexCount = 0;
+    float meshUploadTime = 0.0f;
+    glm::mat4 meshFit = glm::mat4(1.0f);
+    char meshPath[256] = "resources\\pyramid.obj";
+    std::string meshError;
+    bool meshLoaded = false;
+
+    // the picking tree of a big mesh takes a while, so it is built in the background and
+    // picking is off until it is ready
+    struct PickingMesh {
+        std::vector<glm::vec3> vertices;
+        Bvh bvh;
+        float buildTime; // ms
     };
+    std::future<PickingMesh> pickingBuild;
+    float pickingBuildTime = 0.0f;
 
-    GLfloat Ox[] = {
+    // x, y and z axis
+    const GLfloat axisX[] = {
         0.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f,
         2.0f, 0.0f, 0.0f,  1.0f, 0.0f, 0.0f
     };
-
-    GLfloat Oy[] = {
+    const GLfloat axisY[] = {
         0.0f, 0.0f, 0.0f,  0.0f, 1.0f, 0.0f,
         0.0f, 2.0f, 0.0f,  0.0f, 1.0f, 0.0f
     };
-
-    GLfloat Oz[] = {
+    const GLfloat axisZ[] = {
         0.0f, 0.0f, 0.0f,  0.0f, 0.0f, 1.0f,
         0.0f, 0.0f, 2.0f,  0.0f, 0.0f, 1.0f
     };
 
-    GLuint VBO, VAO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidVertices), pyramidVertices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    GLuint xVBO, xVAO;
-    glGenVertexArrays(1, &xVAO);
-    glGenBuffers(1, &xVBO);
-
-    glBindVertexArray(xVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, xVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Ox), Ox, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    GLuint yVBO, yVAO;
-    glGenVertexArrays(1, &yVAO);
-    glGenBuffers(1, &yVBO);
-
-    glBindVertexArray(yVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, yVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Oy), Oy, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    GLuint zVBO, zVAO;
-    glGenVertexArrays(1, &zVAO);
-    glGenBuffers(1, &zVBO);
-
-    glBindVertexArray(zVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, zVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Oz), Oz, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(0);
-
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-
-    pyramidShader.use();
+    Buffer VBO, EBO;
+    VBO.storage(sizeof(pyramidVertices), pyramidVertices);
+    EBO.storage(sizeof(pyramidIndices), pyramidIndices);
+
+    VertexArray VAO;
+    VAO.create();
+    VAO.vertexBuffer(0, VBO, 0, VAO.floatAttributes(0, { 3, 3 }));
+    VAO.elementBuffer(EBO);
+
+    // static helper geometry: position + color, one draw call per primitive type
+    GeometryBatch helpers;
+    helpers.init({ 3, 3 });
+    helpers.add(axisX, 2, GL_LINES);
+    helpers.add(axisY, 2, GL_LINES);
+    helpers.add(axisZ, 2, GL_LINES);
+    helpers.build();
+
+    // per-frame geometry (crosshair): position + color
+    StreamBuffer stream;
+    stream.init(4 * 1024, { 3, 3 });
+
+    // picking by rendering ids, the pyramid is object 1
+    ShaderProgram idShader("resources\\id.vs", "resources\\id.fs");
+    const GLint idShaderModel = idShader.location("model");
+    const GLint idShaderObject = idShader.location("object");
+    const GLuint pyramidObject = 1;
+    IdPicker idPicker;
+    idPicker.init();
+    bool compareIdPicking = true;
+    unsigned int idResults = 0;
+    unsigned int idAgreements = 0;
+    unsigned int idLatency = 0;
 
     ShaderProgram text("resources\\text.vs", "resources\\text.fs");
-    text.use();
+    text.setVec3("textColor", 0.0f, 0.0f, 0.0f);
     initFreeType();
 
+    // scene mode: thousands of polyhedra in one indirect draw, the transformations of the menu
+    // apply to the selected range of instances instead of the pyramid and are multiplied into
+    // their models, so they accumulate where the pyramid's replace the previous one
+    ShaderProgram instanceShader("resources\\instance.vs", "resources\\shader.fs");
+    InstanceScene scene;
+    scene.init();
+    bool sceneMode = false;
+    bool sceneCulling = true; // only the instances whose bounding spheres touch the frustum are drawn
+    int sceneInstances = 10000;
+    int sceneSelection[2] = { 0, 1000 }; // [first, last)
+
+    // projection and view for all programs
+    CameraBuffer cameraBuffer;
+    cameraBuffer.init();
+
     int cameraState = 1;
     float distance = 0.0f;
     glm::vec3 transferVec = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -157,6 +189,16 @@ int main() {
     glm::mat4 rotation = glm::mat4(1.0f);
     float angle = 0.0f;
 
+    // bvh benchmark results: triangles, build ms, refit ms, rays per second of every kernel
+    // through the bvh and by brute force over all triangles
+    size_t bvhBenchmarkTriangles = 0;
+    float bvhBenchmarkBuild = 0.0f;
+    float bvhBenchmarkRefit = 0.0f;
+    float bvhBenchmarkRays[4]{};
+    float bruteForceRays[4]{};
+    std::string frameStatsExport;
+    RenderQueue renderQueue;
+
     glPointSize(2.0f);
     //glPolygonMode(GL_FRONT_AND_BACK , GL_LINE);
 
@@ -164,6 +206,8 @@ int main() {
     while (!glfwWindowShouldClose(window.pWindow)) {
         // per-frame time logic
         window.timing();
+        glState.beginFrame();
+        stream.beginFrame();
 
         // input
         window.keyCallback(window.pWindow);
@@ -178,21 +222,6 @@ int main() {
             0.0f, 0.0f, 0.0f
         };
 
-        GLuint crosshairVBO, crosshairVAO;
-        glGenVertexArrays(1, &crosshairVAO);
-        glGenBuffers(1, &crosshairVBO);
-
-        glBindVertexArray(crosshairVAO);
-
-        glBindBuffer(GL_ARRAY_BUFFER, crosshairVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(crosshair), crosshair, GL_STATIC_DRAW);
-
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), nullptr);
-        glEnableVertexAttribArray(0);
-
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(GLfloat)));
-        glEnableVertexAttribArray(1);
-
         glm::mat4 projection;
         glm::mat4 view         = glm::lookAt(window.Camera.Position, window.Camera.Position + window.Camera.Front, window.Camera.Up);
         glm::mat4 model        = glm::mat4(1.0f);
@@ -211,33 +240,114 @@ int main() {
         pyramidModel = glm::scale(pyramidModel, scaleVec);
         pyramidModel = pyramidModel * reflection;
         pyramidModel = rotation * pyramidModel;
+        glm::mat4 objectModel = pyramidModel * meshFit;
+
+        if (pickingBuild.valid() && pickingBuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            PickingMesh picking = pickingBuild.get();
+            window.Vertices = std::move(picking.vertices);
+            window.Picker = std::move(picking.bvh);
+            pickingBuildTime = picking.buildTime;
+        }
 
-        window.Vertices.clear();
-        for (size_t i = 0; i < sizeof(pyramidVertices) / sizeof(GLfloat); i += 6) {
-            window.Vertices.push_back(glm::vec3(pyramidVertices[i], pyramidVertices[i + 1], pyramidVertices[i + 2]));
-            window.Vertices.back() = pyramidModel * glm::vec4(window.Vertices.back(), 1.0f);
+        window.setModel(objectModel);
+        if (window.EnableCursor || pickingBuild.valid()) {
+            window.HoveredFace = -1;
+        }
+        else if (!window.GpuPicking) {
+            window.pick();
+        }
+        else {
+            // the id pass of an earlier frame, tagged with the answer of the bvh in that frame
+            IdPicker::Result result;
+            if (idPicker.poll(result)) {
+                // hover() also drops a primitive past the current triangles, which can only come from a
+                // readback of an older mesh
+                window.hover(result.object == pyramidObject ? static_cast<long long>(result.primitive) : -1);
+                idLatency = result.latency;
+                if (compareIdPicking) {
+                    idResults++;
+                    idAgreements += result.tag == window.HoveredFace;
+                }
+            }
         }
 
-        pyramidShader.use();
-        pyramidShader.setMat4("projection", projection);
-        pyramidShader.setMat4("view", view);
-        pyramidShader.setMat4("model", pyramidModel);
+        cameraBuffer.update(projection, view);
+
+        if (window.GpuPicking && !window.EnableCursor && !pickingBuild.valid()) {
+            int tag = compareIdPicking ? window.faceAt(window.Camera.Position, window.Camera.Front) : -1;
+
+            // gl_PrimitiveID of glDrawElements(GL_TRIANGLES) is the index of the triangle, as in the bvh
+            idPicker.begin(window.Width, window.Height, window.Width / 2, window.Height / 2);
+            idShader.use();
+            idShader.setMat4(idShaderModel, objectModel * meshBuffer.decoding());
+            idShader.setInt(idShaderObject, pyramidObject);
+            if (meshLoaded) {
+                meshBuffer.draw();
+            }
+            else {
+                VAO.bind();
+                glState.drawElements(GL_TRIANGLES, pyramidIndexCount, GL_UNSIGNED_INT, nullptr);
+            }
+            idPicker.end(tag);
+        }
 
-        glBindVertexArray(VAO);
-        glDrawArrays(GL_TRIANGLES, 0, 18);
+        // the main pass is collected in the queue and drawn sorted by program, texture and vertex array
+        if (sceneMode) {
+            if (sceneCulling) {
+                scene.cull(projection * view, pool);
+            }
+            scene.submit(renderQueue, instanceShader);
+        }
 
-        pyramidShader.setMat4("model", model);
+        RenderQueue::Packet object;
+        object.program = &pyramidShader;
+        object.modelLocation = pyramidShaderModel;
+        object.model = objectModel * meshBuffer.decoding();
+        object.vertexArray = meshLoaded ? &meshBuffer.VAO : &VAO;
+        object.count = meshLoaded ? meshBuffer.indexCount() : pyramidIndexCount;
+        object.indexType = GL_UNSIGNED_INT;
+        renderQueue.submit(RenderQueue::Layer::Opaque, RenderQueue::depth(view, glm::vec3(objectModel[3]), 100.0f), object);
+
+        RenderQueue::Packet axes;
+        axes.program = &pyramidShader;
+        axes.modelLocation = pyramidShaderModel;
+        axes.batch = &helpers;
+        renderQueue.submit(RenderQueue::Layer::Opaque, 0.0f, axes);
+
+        RenderQueue::Packet point;
+        point.program = &pyramidShader;
+        point.modelLocation = pyramidShaderModel;
+        point.vertexArray = &stream.VAO;
+        point.mode = GL_POINTS;
+        point.first = stream.push(crosshair, 1);
+        point.count = 1;
+        // a full stream buffer drops the overlay for the one frame before it grows
+        if (point.first >= 0) {
+            renderQueue.submit(RenderQueue::Layer::Overlay, 0.0f, point);
+        }
 
-        glBindVertexArray(xVAO);
-        glDrawArrays(GL_LINES, 0, 2);
-        glBindVertexArray(yVAO);
-        glDrawArrays(GL_LINES, 0, 2);
-        glBindVertexArray(zVAO);
-        glDrawArrays(GL_LINES, 0, 2);
-        glBindVertexArray(crosshairVAO);
-        glDrawArrays(GL_POINTS, 0, 1);
+        if (window.HoveredFace >= 0) {
+            GLfloat hovered[18];
+            for (int i = 0; i < 3; i++) {
+                glm::vec3 vertex = window.worldVertex(3 * window.HoveredFace + i);
+                GLfloat* out = hovered + 6 * i;
+                out[0] = vertex.x; out[1] = vertex.y; out[2] = vertex.z;
+                out[3] = 1.0f; out[4] = 0.5f; out[5] = 0.0f;
+            }
+            // drawn over the face of the pyramid it covers
+            RenderQueue::Packet face = point;
+            face.mode = GL_TRIANGLES;
+            face.first = stream.push(hovered, 3);
+            face.count = 3;
+            face.flags = RenderQueue::PolygonOffset;
+            if (face.first >= 0) {
+                renderQueue.submit(RenderQueue::Layer::Overlay, 0.0f, face);
+            }
+        }
 
-        renderAllText(text, projection, view);
+        renderAllText(renderQueue, text);
+        renderQueue.execute();
+        scene.endFrame();
         /*        */
 
         /* Interface */
@@ -250,6 +360,117 @@ int main() {
         ImGui::RadioButton("Perspective", &cameraState, 1);
         ImGui::RadioButton("Orthographic", &cameraState, 2);
         ImGui::Separator();
+        ImGui::Text("Mesh");
+        ImGui::InputText("File", meshPath, sizeof(meshPath));
+        if (pickingBuild.valid()) {
+            ImGui::Text("Building the picking tree...");
+        }
+        else if (ImGui::Button("Load")) {
+            MeshCache cache;
+            if (cache.load(meshPath, importer, cacheOptions, meshError)) {
+                meshError.clear();
+                cacheStatistics = cache.statistics;
+                auto start = std::chrono::steady_clock::now();
+                meshBuffer.init(cache);
+                glFinish();
+                meshUploadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                meshLoaded = true;
+
+                // picking works on the positions as they are drawn, dequantized
+                Mesh loaded;
+                cache.decode(loaded);
+                cache.close();
+                meshVertexCount = loaded.vertexCount();
+
+                glm::vec3 extent = loaded.max - loaded.min;
+                float size = std::max(extent.x, std::max(extent.y, extent.z));
+                glm::vec3 base = glm::vec3(0.5f * (loaded.min.x + loaded.max.x), loaded.min.y, 0.5f * (loaded.min.z + loaded.max.z));
+                meshFit = glm::scale(glm::mat4(1.0f), glm::vec3(size > 0.0f ? 1.0f / size : 1.0f));
+                meshFit = glm::translate(meshFit, -base);
+
+                window.Vertices.clear();
+                window.Picker = Bvh();
+                window.HoveredFace = -1;
+                idPicker.reset();
+                pickingBuild = std::async(std::launch::async, [mesh = std::move(loaded)]() {
+                    auto start = std::chrono::steady_clock::now();
+                    PickingMesh picking;
+                    picking.vertices.resize(mesh.indices.size());
+                    for (size_t i = 0; i < mesh.indices.size(); i++) {
+                        picking.vertices[i] = mesh.positions[mesh.indices[i]];
+                    }
+                    picking.bvh.build(picking.vertices, glm::mat4(1.0f));
+                    picking.buildTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    return picking;
+                });
+            }
+        }
+        if (!meshError.empty()) {
+            ImGui::Text(("Error: " + meshError).c_str());
+        }
+        else if (meshLoaded) {
+            ImGui::Text((std::to_string(meshBuffer.indexCount() / 3) + " triangles, " + std::to_string(meshVertexCount) + " vertices, "
+                + std::to_string(meshBuffer.size() / 1024) + " KB on the gpu, uploaded in " + std::to_string(meshUploadTime) + " ms").c_str());
+            if (cacheStatistics.fromCache) {
+                ImGui::Text(("Cache mapped in " + std::to_string(cacheStatistics.mapTime) + " ms, " + std::to_string(cacheStatistics.cacheBytes / 1024)
+                    + " KB instead of " + std::to_string(cacheStatistics.sourceBytes / 1024) + " KB").c_str());
+            }
+            else {
+                const MeshImporter::Statistics& statistics = importer.statistics;
+                ImGui::Text(("Imported in " + std::to_string(statistics.totalTime) + " ms (parse " + std::to_string(statistics.parseTime) + ", weld "
+                    + std::to_string(statistics.weldTime) + "), " + std::to_string(statistics.megabytesPerSecond()) + " MB/s").c_str());
+                ImGui::Text((std::to_string(statistics.weldedVertices) + " vertices welded, " + std::to_string(statistics.degenerateTriangles)
+                    + " degenerate triangles removed, cache written in " + std::to_string(cacheStatistics.writeTime) + " ms").c_str());
+                if (cacheStatistics.optimization.clusters > 0) {
+                    const MeshOptimizer::Statistics& optimization = cacheStatistics.optimization;
+                    ImGui::Text(("Optimized in " + std::to_string(optimization.time) + " ms: ACMR " + std::to_string(optimization.cacheBefore.acmr) + " -> "
+                        + std::to_string(optimization.cacheAfter.acmr) + ", ATVR " + std::to_string(optimization.cacheBefore.atvr) + " -> "
+                        + std::to_string(optimization.cacheAfter.atvr)).c_str());
+                    ImGui::Text(("Overfetch " + std::to_string(optimization.overfetchBefore) + " -> " + std::to_string(optimization.overfetchAfter) + ", "
+                        + std::to_string(optimization.clusters) + " clusters" + (optimization.applied ? "" : ", not better, original order kept")).c_str());
+                }
+            }
+            ImGui::Text(("Picking tree: " + std::to_string(pickingBuildTime) + " ms").c_str());
+        }
+        ImGui::Checkbox("Quantize Positions", &cacheOptions.quantizePositions);
+        ImGui::SameLine();
+        ImGui::Checkbox("Normals", &cacheOptions.normals);
+        ImGui::SameLine();
+        ImGui::Checkbox("Optimize", &cacheOptions.optimize);
+        ImGui::Separator();
+        ImGui::Text("Instances");
+        ImGui::Checkbox("Scene Mode", &sceneMode);
+        if (sceneMode) {
+            ImGui::SliderInt("Count", &sceneInstances, 10000, 1000000, "%d", ImGuiSliderFlags_Logarithmic);
+            ImGui::SameLine();
+            if (ImGui::Button("Generate") || scene.instanceCount() == 0) {
+                scene.generate(static_cast<size_t>(sceneInstances), pool);
+            }
+            ImGui::InputInt2("Selection", sceneSelection);
+            int instances = static_cast<int>(scene.instanceCount());
+            sceneSelection[0] = std::clamp(sceneSelection[0], 0, instances);
+            sceneSelection[1] = std::clamp(sceneSelection[1], sceneSelection[0], instances);
+            ImGui::SameLine();
+            if (ImGui::Button("All")) {
+                sceneSelection[0] = 0;
+                sceneSelection[1] = instances;
+            }
+            // unlike the pyramid's, which replace its scale, reflection and rotation
+            ImGui::Text("The transformations below multiply the models of the selection:");
+            ImGui::Text("Reflect toggles, Scale and Rotate accumulate.");
+            const InstanceScene::Statistics& sceneStats = scene.statistics();
+            ImGui::Text((std::to_string(scene.instanceCount()) + " instances, " + std::to_string(sceneStats.triangles) + " triangles, generated in "
+                + std::to_string(sceneStats.generateTime) + " ms").c_str());
+            ImGui::Text(("Last transform: " + std::to_string(sceneStats.transformTime) + " ms, upload " + std::to_string(sceneStats.uploadTime)
+                + " ms, frame " + std::to_string(glState.lastFrame().frameTime) + " ms").c_str());
+            ImGui::Checkbox("Frustum Culling", &sceneCulling);
+            if (sceneCulling) {
+                ImGui::SameLine();
+                ImGui::Text((std::to_string(sceneStats.visible) + " visible, " + std::to_string(sceneStats.culled) + " culled in "
+                    + std::to_string(sceneStats.cullTime) + " ms (" + TriangleBlocks::kernelName(TriangleBlocks::bestKernel()) + ")").c_str());
+            }
+        }
+        ImGui::Separator();
         ImGui::Text("Selected Face");
         float A[3] = { window.SelectedFace[0].x, window.SelectedFace[0].y, window.SelectedFace[0].z };
         float B[3] = { window.SelectedFace[1].x, window.SelectedFace[1].y, window.SelectedFace[1].z };
@@ -261,7 +482,12 @@ int main() {
         ImGui::Text("Translation");
         ImGui::InputFloat("Distance", &distance);
         if (ImGui::Button("Translate")) {
-            transferVec += window.translate(distance);
+            if (sceneMode) {
+                scene.transform(sceneSelection[0], sceneSelection[1], glm::mat4(1.0f), glm::translate(glm::mat4(1.0f), window.translate(distance)), pool);
+            }
+            else {
+                transferVec += window.translate(distance);
+            }
         }
         ImGui::Separator();
         ImGui::Text("Scaling");
@@ -269,21 +495,37 @@ int main() {
         ImGui::InputFloat3("B", pointOfPlane2);
         ImGui::InputFloat3("C", pointOfPlane3);
         ImGui::InputFloat("Scale Factor", &scaleFactor);
-        if (ImGui::Button("Scale")) {
-            scaleVec = window.scale(scaleFactor, pointOfPlane1, pointOfPlane2, pointOfPlane3);
+        if (ImGui::Button(sceneMode ? "Scale (incremental)" : "Scale")) {
+            if (sceneMode) {
+                glm::vec3 factors = window.scale(scaleFactor, pointOfPlane1, pointOfPlane2, pointOfPlane3);
+                scene.transform(sceneSelection[0], sceneSelection[1], glm::mat4(1.0f), glm::scale(glm::mat4(1.0f), factors), pool);
+            }
+            else {
+                scaleVec = window.scale(scaleFactor, pointOfPlane1, pointOfPlane2, pointOfPlane3);
+            }
         }
         ImGui::Separator();
         ImGui::Text("Reflection");
-        if (ImGui::Button("Reflect")) {
-            reflection = window.reflect();
+        if (ImGui::Button(sceneMode ? "Reflect (incremental)" : "Reflect")) {
+            if (sceneMode) {
+                scene.transform(sceneSelection[0], sceneSelection[1], glm::mat4(1.0f), window.reflect(), pool);
+            }
+            else {
+                reflection = window.reflect();
+            }
         }
         ImGui::Separator();
         ImGui::Text("Rotation");
         ImGui::InputFloat3("a", pointOfLine1);
         ImGui::InputFloat3("b", pointOfLine2);
         ImGui::SliderFloat("Angle", &angle, -360.0f, 360.0f);
-        if (ImGui::Button("Rotate")) {
-            rotation = window.rotate(angle, pointOfLine1, pointOfLine2);
+        if (ImGui::Button(sceneMode ? "Rotate (incremental)" : "Rotate")) {
+            if (sceneMode) {
+                scene.transform(sceneSelection[0], sceneSelection[1], window.rotate(angle, pointOfLine1, pointOfLine2), glm::mat4(1.0f), pool);
+            }
+            else {
+                rotation = window.rotate(angle, pointOfLine1, pointOfLine2);
+            }
         }
         ImGui::NewLine(); ImGui::NewLine(); ImGui::NewLine();
         ImGui::ColorEdit3("Background Color", window.BackgroundColor);
@@ -300,19 +542,139 @@ int main() {
         ImGui::Separator();
         ImGui::Text("FPS:"); ImGui::SameLine();
         ImGui::Text(std::to_string(1.0f / window.DeltaTime).c_str());
+        ImGui::Text("Text:"); ImGui::SameLine();
+        ImGui::Text((std::to_string(textStats.drawCalls) + " draw call(s), " + std::to_string(textStats.glyphs) + " glyphs, " + std::to_string(textStats.cpuTime) + " us").c_str());
+        ImGui::Text("Stream buffer:"); ImGui::SameLine();
+        ImGui::Text((std::to_string(stream.highWaterMark()) + " / " + std::to_string(stream.capacity()) + " B").c_str());
+        const GLState::Counters& frameStats = glState.lastFrame();
+        ImGui::Text("Frame:"); ImGui::SameLine();
+        ImGui::Text((std::to_string(frameStats.drawCalls) + " draw call(s), " + std::to_string(frameStats.stateChanges) + " state change(s) ("
+            + std::to_string(frameStats.redundantChanges) + " skipped), " + std::to_string(frameStats.bufferUploads) + " upload(s), "
+            + std::to_string(frameStats.uploadedBytes / 1024) + " KB").c_str());
+        if (ImGui::Button("Export Frame Stats")) {
+            frameStatsExport = glState.exportCsv("frame_stats.csv") ? "frame_stats.csv" : "cannot write frame_stats.csv";
+        }
+        if (!frameStatsExport.empty()) {
+            ImGui::SameLine();
+            ImGui::Text(frameStatsExport.c_str());
+        }
+        const RenderQueue::Statistics& queueStats = renderQueue.statistics();
+        ImGui::Text("Render queue:"); ImGui::SameLine();
+        ImGui::Text((std::to_string(queueStats.packets) + " packets, " + std::to_string(queueStats.stateChanges) + " state change(s) ("
+            + std::to_string(queueStats.unsortedStateChanges) + " unsorted), sort " + std::to_string(queueStats.sortTime) + " us").c_str());
+        ImGui::Text("Picking:"); ImGui::SameLine();
+        ImGui::Text((std::to_string(window.Picker.triangleCount()) + " triangles, " + std::to_string(window.Picker.nodeCount()) + " nodes, "
+            + std::to_string(window.PickTime) + " us, " + TriangleBlocks::kernelName(window.Picker.kernel())).c_str());
+        ImGui::Checkbox("GPU Picking", &window.GpuPicking);
+        if (window.GpuPicking) {
+            ImGui::SameLine();
+            ImGui::Checkbox("Compare with BVH", &compareIdPicking);
+            ImGui::Text(("Latency: " + std::to_string(idLatency) + " frame(s), agrees with BVH: "
+                + std::to_string(idAgreements) + " / " + std::to_string(idResults)).c_str());
+        }
+        if (ImGui::Button("BVH Benchmark")) {
+            // height field of 2 * 708^2 = 1002528 triangles
+            const int quads = 708;
+            std::vector<glm::vec3> terrain;
+            terrain.reserve(6 * quads * quads);
+            auto height = [&](int i, int j) {
+                float x = 10.0f * i / quads;
+                float z = 10.0f * j / quads;
+                return glm::vec3(x, 0.5f * std::sin(3.0f * x) * std::cos(2.0f * z), z);
+            };
+            for (int i = 0; i < quads; i++) {
+                for (int j = 0; j < quads; j++) {
+                    glm::vec3 a = height(i, j), b = height(i + 1, j), c = height(i, j + 1), d = height(i + 1, j + 1);
+                    terrain.insert(terrain.end(), { a, c, b, b, c, d });
+                }
+            }
+
+            Bvh benchmark;
+            auto start = std::chrono::steady_clock::now();
+            benchmark.build(terrain, glm::mat4(1.0f));
+            auto built = std::chrono::steady_clock::now();
+            benchmark.refit(glm::rotate(glm::mat4(1.0f), 0.4f, glm::vec3(0.0f, 1.0f, 0.3f)));
+            auto refitted = std::chrono::steady_clock::now();
+
+            const int rayCount = 1000000;
+            std::mt19937 random(1);
+            std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+            std::vector<glm::vec3> origins(rayCount), directions(rayCount);
+            for (int i = 0; i < rayCount; i++) {
+                origins[i] = glm::vec3(14.0f * uniform(random) - 2.0f, 3.0f, 14.0f * uniform(random) - 2.0f);
+                directions[i] = glm::normalize(glm::vec3(uniform(random) - 0.5f, -1.0f, uniform(random) - 0.5f));
+            }
+
+            // brute force is tested with a few rays only
+            const int bruteForceRayCount = 64;
+            TriangleBlocks all;
+            all.resize(terrain.size() / 3);
+            for (size_t i = 0; i < all.size(); i++) {
+                all.set(i, terrain[3 * i], terrain[3 * i + 1], terrain[3 * i + 2]);
+            }
+
+            for (int k = 0; k < 4; k++) {
+                RayKernel kernel = static_cast<RayKernel>(k);
+                bvhBenchmarkRays[k] = bruteForceRays[k] = 0.0f;
+                if (!TriangleBlocks::supported(kernel)) { continue; }
+
+                benchmark.setKernel(kernel);
+                auto traced = std::chrono::steady_clock::now();
+                Bvh::Hit hit;
+                for (int i = 0; i < rayCount; i++) {
+                    benchmark.intersect(origins[i], directions[i], hit);
+                }
+                auto middle = std::chrono::steady_clock::now();
+                for (int i = 0; i < bruteForceRayCount; i++) {
+                    float t = std::numeric_limits<float>::infinity();
+                    size_t lane;
+                    all.intersect(origins[i], directions[i], 0, all.size(), t, lane, kernel);
+                }
+                auto end = std::chrono::steady_clock::now();
+
+                bvhBenchmarkRays[k] = rayCount / std::chrono::duration<float>(middle - traced).count();
+                bruteForceRays[k] = bruteForceRayCount / std::chrono::duration<float>(end - middle).count();
+            }
+
+            bvhBenchmarkTriangles = benchmark.triangleCount();
+            bvhBenchmarkBuild = std::chrono::duration<float, std::milli>(built - start).count();
+            bvhBenchmarkRefit = std::chrono::duration<float, std::milli>(refitted - built).count();
+        }
+        if (bvhBenchmarkTriangles) {
+            ImGui::Text((std::to_string(bvhBenchmarkTriangles) + " triangles: build " + std::to_string(bvhBenchmarkBuild) + " ms, refit "
+                + std::to_string(bvhBenchmarkRefit) + " ms").c_str());
+            for (int k = 0; k < 4; k++) {
+                if (bvhBenchmarkRays[k] == 0.0f) { continue; }
+                ImGui::Text((std::string(TriangleBlocks::kernelName(static_cast<RayKernel>(k))) + ": " + std::to_string(bvhBenchmarkRays[k] / 1e6f)
+                    + " Mrays/s, brute force " + std::to_string(bruteForceRays[k]) + " rays/s").c_str());
+            }
+        }
         ImGui::End();
 
+        // only the shown vertices are transformed to world space
         ImGui::Begin("Vertices");
-        float green[3]   = { window.Vertices.at(0).x, window.Vertices.at(0).y, window.Vertices.at(0).z };
-        float blue[3]    = { window.Vertices.at(1).x, window.Vertices.at(1).y, window.Vertices.at(1).z };
-        float red[3]     = { window.Vertices.at(2).x, window.Vertices.at(2).y, window.Vertices.at(2).z };
-        float yellow[3]  = { window.Vertices.at(4).x, window.Vertices.at(4).y, window.Vertices.at(4).z };
-        float magenta[3] = { window.Vertices.at(8).x, window.Vertices.at(8).y, window.Vertices.at(8).z };
-        ImGui::InputFloat3("Green", green, "%.3f", ImGuiInputTextFlags_ReadOnly);
-        ImGui::InputFloat3("Blue", blue, "%.3f", ImGuiInputTextFlags_ReadOnly);
-        ImGui::InputFloat3("Red", red, "%.3f", ImGuiInputTextFlags_ReadOnly);
-        ImGui::InputFloat3("Yellow", yellow, "%.3f", ImGuiInputTextFlags_ReadOnly);
-        ImGui::InputFloat3("Magenta", magenta, "%.3f", ImGuiInputTextFlags_ReadOnly);
+        if (!meshLoaded) {
+            glm::vec3 greenVertex = window.worldVertex(0), blueVertex = window.worldVertex(1), redVertex = window.worldVertex(2);
+            glm::vec3 yellowVertex = window.worldVertex(4), magentaVertex = window.worldVertex(8);
+            float green[3]   = { greenVertex.x, greenVertex.y, greenVertex.z };
+            float blue[3]    = { blueVertex.x, blueVertex.y, blueVertex.z };
+            float red[3]     = { redVertex.x, redVertex.y, redVertex.z };
+            float yellow[3]  = { yellowVertex.x, yellowVertex.y, yellowVertex.z };
+            float magenta[3] = { magentaVertex.x, magentaVertex.y, magentaVertex.z };
+            ImGui::InputFloat3("Green", green, "%.3f", ImGuiInputTextFlags_ReadOnly);
+            ImGui::InputFloat3("Blue", blue, "%.3f", ImGuiInputTextFlags_ReadOnly);
+            ImGui::InputFloat3("Red", red, "%.3f", ImGuiInputTextFlags_ReadOnly);
+            ImGui::InputFloat3("Yellow", yellow, "%.3f", ImGuiInputTextFlags_ReadOnly);
+            ImGui::InputFloat3("Magenta", magenta, "%.3f", ImGuiInputTextFlags_ReadOnly);
+        }
+        else {
+            // corners of the first triangles of a loaded mesh
+            for (size_t i = 0; i < 6 && i < window.Vertices.size(); i++) {
+                glm::vec3 vertex = window.worldVertex(i);
+                float position[3] = { vertex.x, vertex.y, vertex.z };
+                ImGui::InputFloat3(("Vertex " + std::to_string(i)).c_str(), position, "%.3f", ImGuiInputTextFlags_ReadOnly);
+            }
+        }
         ImGui::End();
 
         ImGui::Render();
@@ -325,22 +687,27 @@ int main() {
         }
         /* --------- */
 
-        glDeleteVertexArrays(1, &crosshairVAO);
-        glDeleteBuffers(1, &crosshairVBO);
+        stream.endFrame();
 
         glfwSwapBuffers(window.pWindow);
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteVertexArrays(1, &xVAO);
-    glDeleteBuffers(1, &xVBO);
-    glDeleteVertexArrays(1, &yVAO);
-    glDeleteBuffers(1, &yVBO);
-    glDeleteVertexArrays(1, &zVAO);
-    glDeleteBuffers(1, &zVBO);
-    glDeleteProgram(pyramidShader.ID);
+    VAO.release();
+    VBO.release();
+    EBO.release();
+    pyramidShader.release();
+    idShader.release();
+    instanceShader.release();
+    scene.release();
+    text.release();
+    meshBuffer.release();
+    idPicker.release();
+    cameraBuffer.release();
+    stream.release();
+    helpers.release();
+    releaseText();
+    reportLeakedObjects();
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -0,0 +1,64 @@
+#include "FrustumCuller.h"
+
+#include <iostream>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace {
+
+// compares every supported kernel with the scalar one on random spheres and perspective and
+// orthographic frusta, returns the number of spheres that are classified differently
+size_t verify(size_t sphereCount) {
+    if (sphereCount == 0) { return 0; }
+
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    auto point = [&]() { return glm::vec3(uniform(random), uniform(random), uniform(random)); };
+
+    // an odd number of spheres leaves a partial last block; some spheres touch a plane, some have
+    // no radius at all
+    FrustumCuller spheres;
+    spheres.resize(sphereCount);
+    for (size_t i = 0; i < sphereCount; i++) {
+        float radius = i % 7 == 0 ? 0.0f : 0.5f * (uniform(random) + 1.0f);
+        spheres.set(i, 20.0f * point(), radius);
+    }
+
+    size_t failures = 0;
+    std::vector<uint32_t> reference(sphereCount), visible(sphereCount);
+    for (int f = 0; f < 16; f++) {
+        glm::vec3 eye = 10.0f * point();
+        glm::mat4 view = glm::lookAt(eye, eye + point(), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = f % 2 == 0
+            ? glm::perspective(glm::radians(30.0f + 30.0f * (uniform(random) + 1.0f)), 1.5f, 0.001f, 100.0f)
+            : glm::ortho(-8.0f, 8.0f, -5.0f, 5.0f, 0.001f, 100.0f);
+        spheres.setFrustum(projection * view);
+
+        size_t first = random() % sphereCount;
+        size_t last = first + 1 + random() % (sphereCount - first);
+        size_t n = spheres.cull(first, last, reference.data(), RayKernel::Scalar);
+
+        for (RayKernel kernel : { RayKernel::SSE, RayKernel::AVX2, RayKernel::AVX512 }) {
+            if (!TriangleBlocks::supported(kernel)) { continue; }
+            size_t m = spheres.cull(first, last, visible.data(), kernel);
+            size_t common = 0;
+            while (common < n && common < m && visible[common] == reference[common]) {
+                common++;
+            }
+            failures += (n > m ? n : m) - common;
+        }
+    }
+    return failures;
+}
+
+}
+
+int main() {
+    const size_t failures = verify(100001);
+    if (failures) {
+        std::cout << "ERROR::FRUSTUM_CULLER: " << failures << " spheres differ from the scalar test" << std::endl;
+        return 1;
+    }
+    std::cout << "every kernel agrees with the scalar test (" << TriangleBlocks::kernelName(TriangleBlocks::bestKernel()) << ")" << std::endl;
+    return 0;
+}
\ No newline at end of file
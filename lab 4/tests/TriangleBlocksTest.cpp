@@ -0,0 +1,99 @@
+#include "TriangleBlocks.h"
+
+#include <cstring>
+#include <iostream>
+#include <random>
+
+namespace {
+
+// compares every supported kernel with the glm code of Window::distanceToIntersection on random
+// triangles and rays, returns the number of queries with a different hit or a different distance
+size_t verify(size_t rayCount) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    auto point = [&]() { return glm::vec3(uniform(random), uniform(random), uniform(random)); };
+
+    // an odd number of lanes leaves a partial last block; some triangles are degenerate or tiny
+    // and some rays go exactly through vertices, so the epsilons and the edge tests are exercised
+    const size_t triangleCount = 203;
+    std::vector<glm::vec3> vertices;
+    TriangleBlocks triangles;
+    triangles.resize(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        glm::vec3 v0 = point();
+        glm::vec3 v1 = point();
+        glm::vec3 v2 = point();
+        if (i % 17 == 0) {
+            v2 = v0 + 0.5f * (v1 - v0);
+        }
+        else if (i % 13 == 0) {
+            v1 = v0 + 0.001f * (v1 - v0);
+            v2 = v0 + 0.001f * (v2 - v0);
+        }
+        triangles.set(i, v0, v1, v2);
+        vertices.insert(vertices.end(), { v0, v1, v2 });
+    }
+
+    // the glm code of Window::distanceToIntersection for any ray
+    auto distanceToIntersection = [](const glm::vec3& origin, const glm::vec3& direction,
+        const glm::vec3& point1, const glm::vec3& point2, const glm::vec3& point3) {
+        glm::vec3 edge1 = point2 - point1;
+        glm::vec3 edge2 = point3 - point1;
+        glm::vec3 h = glm::cross(direction, edge2);
+        float a = glm::dot(edge1, h);
+        if (a > -0.00001f && a < 0.00001f) { return -1.0f; }
+        float f = 1.0f / a;
+        glm::vec3 s = origin - point1;
+        float u = f * glm::dot(s, h);
+        if (u < 0.0f || u > 1.0f) { return -1.0f; }
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = f * glm::dot(direction, q);
+        if (v < 0.0f || u + v > 1.0f) { return -1.0f; }
+        float t = f * glm::dot(edge2, q);
+        return t > 0.00001f ? t : -1.0f;
+    };
+
+    size_t failures = 0;
+    for (size_t r = 0; r < rayCount; r++) {
+        glm::vec3 origin = 3.0f * point();
+        glm::vec3 target = r % 5 == 0 ? vertices[random() % vertices.size()] : 0.5f * point();
+        glm::vec3 direction = glm::normalize(target - origin);
+        size_t first = random() % triangleCount;
+        size_t lanes = 1 + random() % (triangleCount - first);
+
+        float referenceT = r % 3 == 0 ? 2.0f : 1e30f;
+        size_t referenceLane = triangleCount;
+        bool reference = false;
+        for (size_t i = first; i < first + lanes; i++) {
+            float t = distanceToIntersection(origin, direction, vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+            if (t >= 0.0f && t < referenceT) {
+                referenceT = t;
+                referenceLane = i;
+                reference = true;
+            }
+        }
+
+        for (RayKernel kernel : { RayKernel::Scalar, RayKernel::SSE, RayKernel::AVX2, RayKernel::AVX512 }) {
+            if (!TriangleBlocks::supported(kernel)) { continue; }
+            float t = r % 3 == 0 ? 2.0f : 1e30f;
+            size_t lane = triangleCount;
+            bool found = triangles.intersect(origin, direction, first, lanes, t, lane, kernel);
+            if (found != reference || lane != referenceLane || std::memcmp(&t, &referenceT, sizeof(float)) != 0) {
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+}
+
+int main() {
+    const size_t failures = verify(100000);
+    if (failures) {
+        std::cout << "ERROR::TRIANGLE_BLOCKS: " << failures << " queries differ from the scalar test" << std::endl;
+        return 1;
+    }
+    std::cout << "every kernel agrees with the scalar test (" << TriangleBlocks::kernelName(TriangleBlocks::bestKernel()) << ")" << std::endl;
+    return 0;
+}
\ No newline at end of file